@@ -113,8 +113,7 @@ void Annotation_messagePopup(Widget parent, char * msg);
  */
 void  Annotation_draw(Display *display, Window window, GC gc,
                   XRectangle wind_rect, AnnotationInfo *ai,
-                  struct timeval *pplotted_t0, struct timeval *pplotted_t1,
-                  StripCurveInfo *curves[])
+                  struct timeval *pplotted_t0, struct timeval *pplotted_t1)
 {
   Annotation       *annotation;
   Annotation       *next;
@@ -254,6 +253,83 @@ void  Annotation_draw(Display *display, Window window, GC gc,
 }
  
 
+/*
+ *  write annotations as SVG
+ */
+void Annotation_svg(FILE *f, AnnotationInfo *ai, char *fg, char *bg)
+{
+  Annotation       *annotation;
+  int               i;
+  int               fontHeight;
+  int               rasterTextX,rasterTextY;
+  char             *ptr;
+  char             *newptr;
+  intptr_t          len;
+  char              color[8];
+  char              line[256];
+
+  if (!ai) return; 
+  if (!ai->annotationList) return; 
+
+  fontHeight = ai->font_info->max_bounds.ascent + ai->font_info->max_bounds.descent;
+
+  for (annotation = (Annotation*)ellFirst(ai->annotationList); annotation;
+       annotation = (Annotation*)ellNext((ELLNODE*)annotation)) {
+
+    if (annotation->curve &&
+        annotation->curve->details->plotstat != STRIPCURVE_PLOTTED)
+      continue;
+
+    if (annotation->curve) {
+      sprintf(color, "#%02x%02x%02x",
+        annotation->curve->details->color->xcolor.red >> 8,
+        annotation->curve->details->color->xcolor.green >> 8,
+        annotation->curve->details->color->xcolor.blue >> 8);
+    } else {
+      strcpy(color, fg);
+    }
+
+    /* background, then a color border with a wide left side */
+    fprintf(f, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" fill=\"%s\"/>\n",
+      annotation->box.rasterX, annotation->box.rasterY,
+      annotation->box.width, annotation->box.height, bg);
+    fprintf(f, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" "
+      "fill=\"none\" stroke=\"%s\"/>\n",
+      annotation->box.rasterX+2, annotation->box.rasterY+2,
+      annotation->box.width - 3, 
+      annotation->box.height - 2*COLOR_NPIXELS_TOPBOT - 2, color);
+    fprintf(f, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" fill=\"%s\"/>\n",
+      annotation->box.rasterX+2, annotation->box.rasterY+2,
+      COLOR_NPIXELS_SIDE, 
+      annotation->box.height - 2*COLOR_NPIXELS_TOPBOT - 2, color);
+
+    /* the annotation text lines */
+    ptr = annotation->text;
+    rasterTextX = annotation->box.rasterX + COLOR_NPIXELS_SIDE + ai->boxOffset;
+    rasterTextY = annotation->box.rasterY + COLOR_NPIXELS_TOPBOT + ai->boxOffset 
+                + ai->font_info->max_bounds.ascent;
+    for (i=1 ;ptr && i<=annotation->numLines;i++) {
+
+      newptr=strchr(ptr,'\n');
+      if (!newptr) {
+        len = strlen(ptr);
+      } else {
+        len = (int)(newptr - ptr);
+        newptr++;
+      }
+      if (len > (intptr_t)sizeof(line) - 1) len = sizeof(line) - 1;
+      strncpy(line, ptr, len);
+      line[len] = 0;
+      fprintf(f, "<text x=\"%d\" y=\"%d\" fill=\"%s\" xml:space=\"preserve\">",
+        rasterTextX, rasterTextY, fg);
+      xml_fputs(line, f);
+      fprintf(f, "</text>\n");
+      rasterTextY += fontHeight;
+      ptr = newptr;
+    }
+  }
+}
+
 void Annotation_messagePopup(Widget parent,char *msg)
 {
     static Widget popup;
@@ -28,8 +28,15 @@ typedef void *  AnnotationInfo;
 
 void  Annotation_draw(Display *display, Window window, GC gc,
                   XRectangle wind_rect, AnnotationInfo *ai,
-                  struct timeval *pplotted_t0, struct timeval *pplotted_t1,
-                  StripCurveInfo *curves[]);
+                  struct timeval *pplotted_t0, struct timeval *pplotted_t1);
+
+/* Annotation_svg
+ *
+ *      Writes the annotations, where Annotation_draw() last put them,
+ *      as SVG elements in plot coordinates.  fg and bg are the graph's
+ *      colors, as "#rrggbb".
+ */
+void Annotation_svg(FILE *f, AnnotationInfo *ai, char *fg, char *bg);
 
 void Annotation_move(XButtonEvent *event, AnnotationInfo *ai);
 void Annotation_deleteSelected(AnnotationInfo *ai);
@@ -33,6 +33,7 @@
 #define SMALL_ZOOM_FACTOR 1.071773462536293 /* 2^(.1) */
 #define LARGE_PAN_FACTOR  0.5
 #define SMALL_PAN_FACTOR  0.05
+#define QUICK_PAN_TIME    2.0   /* seconds between pans to look further ahead */
 #define ROFF              1.0e-10
 
 #include "Strip.h"
@@ -218,6 +219,7 @@ typedef enum
 {
   DFSDLG_TGL_ASCII = 0,
   DFSDLG_TGL_CSV,
+  DFSDLG_TGL_SVG,
 #ifdef USE_SDDS
   DFSDLG_TGL_SDDS,
 #endif
@@ -229,6 +231,7 @@ char    *DfsDlgTglStr[DFSDLG_TGL_COUNT] =
 {
   "ASCII",
   "Comma Separated Values",
+  "SVG image",
 #ifdef USE_SDDS
   "SDDS binary"
 #endif
@@ -276,6 +279,10 @@ typedef struct _StripInfo
   struct timeval        next_event[LAST_STRIPEVENT];
 
   XtIntervalId          tid;
+
+  /* browse mode history prefetch */
+  int                   pan_dir;        /* of the last pan: -1, 1, or 0 */
+  struct timeval        pan_time;       /* of the last pan */
 }
 StripInfo;
 
@@ -311,6 +318,7 @@ static void     Strip_dispatch          (StripInfo *);
 static void     Strip_child_msg         (void *);
 #endif
 static void     Strip_config_callback   (StripConfigMask, void *);
+static void     Strip_history_callback  (void *);
 
 static void     Strip_forgetcurve       (StripInfo *, StripCurve);
 
@@ -321,6 +329,7 @@ static void     Strip_graphdrop_xfer    (Widget, XtPointer, Atom *, Atom *,
 static void     Strip_printer_init      (StripInfo *);
 
 static void     Strip_setbrowsemode     (StripInfo *, int);
+static void     Strip_prefetch          (StripInfo *, int);
 
 static void     callback                (Widget, XtPointer, XtPointer);
 static int      X_error_handler         (Display *, XErrorEvent *);
@@ -1119,7 +1128,11 @@ Strip   Strip_init      (int    *argc,
     /* si->history = StripHistory_init ((Strip)si); */
     si->data = StripDataSource_init (si->history);
     StripDataSource_setattr
-      (si->data, SDS_NUMSAMPLES, (size_t)si->config->Time.num_samples, 0);
+      (si->data,
+       SDS_NUMSAMPLES,          (size_t)si->config->Time.num_samples,
+       SDS_HISTORY_CB_FUNC,     Strip_history_callback,
+       SDS_HISTORY_CB_DATA,     si,
+       0);
 
     StripGraph_setattr (si->graph, STRIPGRAPH_DATA_SOURCE, si->data, 0);
 
@@ -1143,6 +1156,7 @@ Strip   Strip_init      (int    *argc,
       si->curves[i].details                     = NULL;
       si->curves[i].func_data                   = NULL;
       si->curves[i].get_value                   = NULL;
+      si->curves[i].get_events                  = NULL;
       si->curves[i].connect_request.tv_sec      = 0;
       si->curves[i].id                          = NULL;
       si->curves[i].status                      = 0;
@@ -1208,6 +1222,7 @@ Strip   Strip_init      (int    *argc,
     XUnmapWindow (si->display, XtWindow (si->shell));
 
     si->status = STRIPSTAT_OK;
+    si->pan_dir = 0;
     memset (si->fdinfo, 0, STRIP_MAX_FDS * sizeof (stripFdInfo));
 
     Strip_printer_init (si);
@@ -1803,6 +1818,9 @@ int     Strip_dumpdata  (Strip the_strip, char *fname)
 	case DFSDLG_TGL_CSV:
 	  ret_val = StripGraph_dumpdata_csv (si->graph, f);
 	  break;
+	case DFSDLG_TGL_SVG:
+	  ret_val = StripGraph_dumpsvg (si->graph, f);
+	  break;
 #ifdef USE_SDDS
 	case DFSDLG_TGL_SDDS:
 	  ret_val = StripGraph_dumpdata_sdds (si->graph, fname);
@@ -1890,6 +1908,7 @@ static void     Strip_forgetcurve       (StripInfo      *si,
   StripConfig_reset_details (si->config, sci->details);
   sci->details = 0;
   sci->get_value = 0;
+  sci->get_events = 0;
   sci->func_data = 0;
 }
 
@@ -1991,6 +2010,33 @@ static void     Strip_graphdrop_xfer    (Widget         BOGUS(w),
 }
 
 
+/*
+ * Strip_history_callback
+ *
+ *      Called by the data source when requested history data has
+ *      arrived, which it can only show on a complete refresh.
+ */
+static void     Strip_history_callback  (void *data)
+{
+  StripInfo             *si = (StripInfo *)data;
+
+  /* autoscale did without the history, so it has another go */
+  if ((auto_scaleTriger == 1) && changeMinMax (si))
+  {
+    StripGraph_setstat (si->graph, SGSTAT_GRAPH_REFRESH);
+    StripGraph_setstat (si->graph, SGSTAT_LEGEND_REFRESH);
+    StripGraph_draw
+      (si->graph,
+       SGCOMPMASK_DATA | SGCOMPMASK_LEGEND | SGCOMPMASK_YAXIS,
+       (Region *)0);
+    return;
+  }
+
+  StripGraph_setstat (si->graph, SGSTAT_GRAPH_REFRESH);
+  StripGraph_draw (si->graph, SGCOMPMASK_DATA, (Region *)0);
+}
+
+
 /*
  * Strip_config_callback
  */
@@ -2274,6 +2320,12 @@ static void     Strip_config_callback   (StripConfigMask mask, void *data)
         (si->graph, SGSTAT_GRAPH_REFRESH | SGSTAT_LEGEND_REFRESH);
     }
       
+    if (StripConfigMask_stat (&mask, SCFGMASK_CURVE_MONITOR))
+    {
+      comp_mask |= SGCOMPMASK_DATA;
+      StripGraph_setstat (si->graph, SGSTAT_GRAPH_REFRESH);
+    }
+      
     if (StripConfigMask_stat (&mask, SCFGMASK_CURVE_PLOTSTAT))
     {
       /* re-arrange the plot order */
@@ -2390,6 +2442,9 @@ static void     Strip_eventmgr          (XtPointer arg, XtIntervalId *BOGUS(id))
 		StripGraph_draw
 		  (si->graph, SGCOMPMASK_XAXIS | SGCOMPMASK_DATA, (Region *)0);
 	  }
+	  
+	  /* values which changed on sampling are shown in one go */
+	  StripGraph_updatelegend (si->graph);
 	  break;
 	  
 	case STRIPEVENT_CHECK_CONNECT:
@@ -2576,6 +2631,7 @@ static void     Strip_setbrowsemode     (StripInfo *si, int browse)
   else
   {
     auto_scaleNoBrowse = 1;
+    Strip_prefetch (si, 0);
     si->status &= ~STRIPSTAT_BROWSE_MODE;
     XtVaSetValues (si->browse_lbl, XmNlabelString, xstr_notpanning, NULL);
     XtVaSetValues	(si->btn[STRIPBTN_AUTOSCROLL],
@@ -2586,6 +2642,63 @@ static void     Strip_setbrowsemode     (StripInfo *si, int browse)
 }
 
 
+/*
+ * Strip_prefetch
+ *
+ *      Called after each pan in browse mode, with its direction, to have
+ *      the history for the next window fetched in the background, or the
+ *      next two if the user keeps panning the same way in quick
+ *      succession.  Panning back replaces the prefetch with one the other
+ *      way.  With a direction of 0, as for a zoom or when leaving browse
+ *      mode, the outstanding prefetch is just canceled.
+ */
+static void     Strip_prefetch          (StripInfo *si, int dir)
+{
+  struct timeval        now, t0, t1, tb, te, t;
+  double                span;
+
+  get_current_time (&now);
+  
+  if (!dir)
+  {
+    StripDataSource_prefetch (si->data, NULL, NULL);
+    si->pan_dir = 0;
+    return;
+  }
+
+  span = si->config->Time.timespan;
+  if ((dir == si->pan_dir) &&
+      (subtract_times (&t, &si->pan_time, &now) < QUICK_PAN_TIME))
+    span *= 2;
+  si->pan_dir = dir;
+  si->pan_time = now;
+
+  StripGraph_getattr
+    (si->graph,
+     STRIPGRAPH_BEGIN_TIME,     &t0,
+     STRIPGRAPH_END_TIME,       &t1,
+     0);
+  dbl2time (&t, span);
+  if (dir > 0)
+  {
+    /* nothing to fetch beyond the present */
+    tb = t1;
+    add_times (&te, &t, &t1);
+    if (compare_times (&te, &now) > 0)
+      te = now;
+  }
+  else
+  {
+    subtract_times (&tb, &t, &t0);
+    te = t0;
+  }
+
+  if (compare_times (&tb, &te) < 0)
+    StripDataSource_prefetch (si->data, &tb, &te);
+  else StripDataSource_prefetch (si->data, NULL, NULL);
+}
+
+
 /*
  * callback
  */
@@ -2685,7 +2798,9 @@ static void     callback        (Widget w, XtPointer client, XtPointer call)
 	  else  StripGraph_draw
 		    (si->graph,SGCOMPMASK_DATA|SGCOMPMASK_XAXIS,(Region *)0);
 	}
-	
+
+	/* only now, so that the fetch for what is shown goes first */
+	Strip_prefetch (si, (w == si->btn[STRIPBTN_LEFT])? -1 : 1);
     }
     
     else if (w == si->btn[STRIPBTN_UP] ||
@@ -2775,6 +2890,7 @@ static void     callback        (Widget w, XtPointer client, XtPointer call)
 	}
 	
 	StripGraph_setattr (si->graph, STRIPGRAPH_END_TIME, &t1, 0);
+	Strip_prefetch (si, 0);
 #if 0
 	/* KE: There is no reason to go in browse mode */
 	Strip_setbrowsemode (si, True);
@@ -2935,7 +3051,7 @@ static void     callback        (Widget w, XtPointer client, XtPointer call)
 	    XtAddCallback(tmp,XmNvalueChangedCallback,radio_toggled,
 		(XtPointer) i );
 	  }
-#ifndef USE_AAPI/*only under AAPI possible choose reduction algorithms right now */ 
+#if !defined(USE_AAPI) && !defined(USE_CAR) /* only AAPI and CAR offer reduction algorithms */
 	  XtSetSensitive(radio_box,False);
 #endif
 	  XtManageChild(radio_box);
@@ -17,43 +17,227 @@
    most of the search requests are at the beginning of the sequence */
 #define RETRY_TIMEOUT 1.0
 
+/* Number of value updates kept per channel until they are collected.
+   Updates arriving while the ring is full are dropped. */
+#define STRIPCA_RING_SIZE 1024
+
 #include "StripDAQ.h"
 
 #include <cadef.h>
 #include <db_access.h>
+#include <epicsTime.h>
 
-typedef struct _StripDAQInfo
+/* With a CA thread, the context belongs to a thread of its own, which
+   does all the connecting, disconnecting and description lookups, so
+   callbacks are always preemptive. */
+#if defined(STRIP_CA_THREAD) && !defined(STRIP_CA_PREEMPTIVE)
+#define STRIP_CA_PREEMPTIVE
+#endif
+
+/* With preemptive callbacks, CA delivers value updates on its own
+   threads straight into the channel's ring, which the data source
+   drains on the Xt thread without locking.  The other callbacks act on
+   the strip and its widgets, so they are queued and run on the Xt
+   thread by timeout_callback(), or wakeup_callback() with a CA thread. */
+#ifdef STRIP_CA_PREEMPTIVE
+#include <epicsAtomic.h>
+#include <epicsMutex.h>
+#define SHARED_GET(p)           epicsAtomicGetIntT (p)
+#define SHARED_SET(p,v)         epicsAtomicSetIntT (p, v)
+#else
+#define SHARED_GET(p)           (*(p))
+#define SHARED_SET(p,v)         (*(p) = (v))
+#endif
+
+#ifdef STRIP_CA_THREAD
+#ifdef PEND_DESCRIPTION
+#error "PEND_DESCRIPTION waits on CA, which can't be done with a CA thread"
+#endif
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/* channel slot states: only the CA thread frees a closing slot, once
+   nothing more can arrive for its channel */
+#define CHANNEL_FREE            0
+#define CHANNEL_OPEN            1
+#define CHANNEL_CLOSING         2
+#endif
+
+typedef struct _UpdateRecord
 {
-  Strip         strip;
-  struct        _ChannelData
-  {
-    chid                        chan_id;
-    evid                        event_id;
+  struct timeval        time;
+  double                value;
+} UpdateRecord;
+
+#ifdef STRIP_CA_PREEMPTIVE
+struct _ChannelData;
+typedef void ChannelFunc (struct _ChannelData *);
+
+typedef struct _DeferredCall
+{
+  struct _DeferredCall                  *next;
+  struct _ChannelData                   *cd;
+  caCh                                  *conn_func;
+  caEventCallBackFunc                   *event_func;
+  ChannelFunc                           *chan_func;
+  struct connection_handler_args        conn_args;
+  struct event_handler_args             event_args;
+  double                                dbr[1];  /* event_args.dbr copy */
+} DeferredCall;
+
+typedef struct _CallQueue
+{
+  DeferredCall                          *first, *last;
+} CallQueue;
+#endif
+
+/* Channels are allocated one by one and never move, as CA and the
+   curves hold on to them.  A channel is reused once it is free. */
+struct _ChannelData
+{
+  chid                          chan_id;
+  evid                          event_id;
 #ifndef PEND_DESC
-    chid                        desc_chan_id;
+  chid                          desc_chan_id;
 #endif    
-    double                      value;
-    struct _StripDAQInfo        *this;
-  } chan_data[STRIP_MAX_CURVES];
+  StripCurve                    curve;
+  double                        value;  /* latest value collected */
+
+  /* value updates, pushed by data_callback() and collected by the
+     data source: only the former moves ring_head, the latter ring_tail */
+  UpdateRecord                  ring[STRIPCA_RING_SIZE];
+  int                           ring_head, ring_tail;
+  int                           waiting;        /* for the next update? */
+
+#ifdef STRIP_CA_THREAD
+  /* the CA thread alone uses the ids above, and the name below */
+  int                           state;
+  char                          name[STRIP_MAX_NAME_CHAR+1];
+#endif
+  
+  struct _StripDAQInfo          *this;
+};
+
+typedef struct _StripDAQInfo
+{
+  Strip                         strip;
+  struct _ChannelData           **chan_data;
+  int                           n_chan;         /* channels allocated */
+  int                           max_chan;       /* size of chan_data */
+#ifdef STRIP_CA_PREEMPTIVE
+  epicsMutexId                  lock;           /* for the queues below */
+  CallQueue                     deferred;       /* for the Xt thread */
+#endif
+#ifdef STRIP_CA_THREAD
+  CallQueue                     requests;       /* for the CA thread */
+  epicsThreadId                 thread;
+  epicsEventId                  wakeup, ready;
+  int                           pipe_fd[2];
+  int                           status;         /* of context creation */
+  int                           shutdown;
+#endif
 } StripDAQInfo;
 
 
 /* ====== Prototypes ====== */
+#ifndef STRIP_CA_PREEMPTIVE
 static void addfd_callback (void *, int, int);
-static void timeout_callback (XtPointer, XtIntervalId *);
 static void work_callback (XtPointer, int *, XtInputId *);
+#endif
+#ifndef STRIP_CA_THREAD
+static void timeout_callback (XtPointer, XtIntervalId *);
+#endif
+static struct _ChannelData *free_channel (StripDAQInfo *);
+static int close_channel (struct _ChannelData *);
+static int retry_search (const char *);
 static void connect_callback (struct connection_handler_args);
 static void info_callback (struct event_handler_args);
 static void data_callback (struct event_handler_args);
+static void data_arrived (struct event_handler_args);
+static void data_failed (struct event_handler_args);
 static double get_value (void *);
+static int get_events (void *, struct timeval *, double *, int);
 #ifdef PEND_DESCRIPTION
 static void getDescriptionRecord (char *name,char *description);
 #else
-static void requestDescRecord (StripCurve curve);
+static void requestDescRecord (struct _ChannelData *, char *);
 static void desc_connect_callback (struct connection_handler_args);
 static void desc_info_callback (struct event_handler_args args);
 #endif
 
+#ifdef STRIP_CA_PREEMPTIVE
+static void defer_connection (CallQueue *, caCh *,
+                              struct connection_handler_args);
+static void defer_event (CallQueue *, caEventCallBackFunc *,
+                         struct event_handler_args);
+static void defer_channel (CallQueue *, ChannelFunc *, struct _ChannelData *);
+static DeferredCall *next_call (StripDAQInfo *, CallQueue *);
+static void run_call (DeferredCall *);
+static void run_deferred (StripDAQInfo *);
+static void purge_deferred (StripDAQInfo *, CallQueue *,
+                            struct _ChannelData *);
+
+#define CHANNEL(chid)           ((struct _ChannelData *)ca_puser (chid))
+#define XT_QUEUE(chid)          (&CHANNEL (chid)->this->deferred)
+#endif
+
+#ifdef STRIP_CA_THREAD
+static int start_thread (StripDAQInfo *);
+static void ca_thread (void *);
+static void wakeup_callback (XtPointer, int *, XtInputId *);
+static void connect_request (struct _ChannelData *);
+static void disconnect_request (struct _ChannelData *);
+static void retry_request (struct _ChannelData *);
+static void release_curve (struct _ChannelData *);
+static void connect_ca (struct connection_handler_args);
+static void info_ca (struct event_handler_args);
+#ifndef PEND_DESCRIPTION
+static void clear_desc_request (struct _ChannelData *);
+#endif
+
+/* callbacks go to the CA thread first, which passes them on to the Xt
+   thread after doing whatever needs CA, see connect_ca() */
+#define CA_QUEUE(chid)          (&CHANNEL (chid)->this->requests)
+
+static void connect_deferred (struct connection_handler_args args)
+{ defer_connection (CA_QUEUE (args.chid), connect_ca, args); }
+static void info_deferred (struct event_handler_args args)
+{ defer_event (CA_QUEUE (args.chid), info_ca, args); }
+#ifndef PEND_DESCRIPTION
+static void desc_connect_deferred (struct connection_handler_args args)
+{ defer_connection (CA_QUEUE (args.chid), desc_connect_callback, args); }
+static void desc_info_deferred (struct event_handler_args args)
+{ defer_event (XT_QUEUE (args.chid), desc_info_callback, args); }
+#endif
+#elif defined(STRIP_CA_PREEMPTIVE)
+static void connect_deferred (struct connection_handler_args args)
+{ defer_connection (XT_QUEUE (args.chid), connect_callback, args); }
+static void info_deferred (struct event_handler_args args)
+{ defer_event (XT_QUEUE (args.chid), info_callback, args); }
+#ifndef PEND_DESCRIPTION
+static void desc_connect_deferred (struct connection_handler_args args)
+{ defer_connection (XT_QUEUE (args.chid), desc_connect_callback, args); }
+static void desc_info_deferred (struct event_handler_args args)
+{ defer_event (XT_QUEUE (args.chid), desc_info_callback, args); }
+#endif
+#endif
+
+#ifdef STRIP_CA_PREEMPTIVE
+#define CONNECT_CALLBACK        connect_deferred
+#define INFO_CALLBACK           info_deferred
+#define DESC_CONNECT_CALLBACK   desc_connect_deferred
+#define DESC_INFO_CALLBACK      desc_info_deferred
+#define DEFER_EVENT(f,args)     defer_event (XT_QUEUE (args.chid), f, args)
+#else
+#define CONNECT_CALLBACK        connect_callback
+#define INFO_CALLBACK           info_callback
+#define DESC_CONNECT_CALLBACK   desc_connect_callback
+#define DESC_INFO_CALLBACK      desc_info_callback
+#define DEFER_EVENT(f,args)     f (args)
+#endif
+
 /*
  * StripDAQ_initialize
  */
@@ -61,27 +245,40 @@ StripDAQ StripDAQ_initialize (Strip strip)
 {
   StripDAQInfo  *sca = NULL;
   int           status;
-  int           i;
 
   
   if ((sca = (StripDAQInfo *)calloc (sizeof (StripDAQInfo), 1)) != NULL)
   {
     sca->strip = strip;
+#if defined(STRIP_CA_THREAD)
+    status = start_thread (sca);
+#elif defined(STRIP_CA_PREEMPTIVE)
+    status = ca_context_create (ca_enable_preemptive_callback);
+#else
     status = ca_task_initialize ();
+#endif
     if (status != ECA_NORMAL)
     {
       SEVCHK (status, "StripDAQ: Channel Access initialization error");
       free (sca);
       sca = NULL;
     }
+#if defined(STRIP_CA_PREEMPTIVE) && !defined(STRIP_CA_THREAD)
+    else if (!(sca->lock = epicsMutexCreate ()))
+    {
+      fprintf (stderr, "StripDAQ: unable to create mutex\n");
+      ca_context_destroy ();
+      free (sca);
+      sca = NULL;
+    }
+#endif
     else {
-      Strip_addtimeout (strip, 0.1, timeout_callback, strip);
+#ifndef STRIP_CA_THREAD
+      Strip_addtimeout (strip, 0.1, timeout_callback, sca);
+#endif
+#ifndef STRIP_CA_PREEMPTIVE
       ca_add_fd_registration (addfd_callback, sca);
-      for (i = 0; i < STRIP_MAX_CURVES; i++)
-      {
-        sca->chan_data[i].this = sca;
-        sca->chan_data[i].chan_id = NULL;
-      }
+#endif
     }
   }
 
@@ -94,7 +291,41 @@ StripDAQ StripDAQ_initialize (Strip strip)
  */
 void StripDAQ_terminate (StripDAQ the_sca)
 {
+  StripDAQInfo  *sca = (StripDAQInfo *)the_sca;
+#ifdef STRIP_CA_PREEMPTIVE
+  DeferredCall  *call;
+#endif
+  int           i;
+  
+#ifdef STRIP_CA_THREAD
+  /* the thread runs what it has been asked to, then exits the context */
+  epicsMutexMustLock (sca->lock);
+  sca->shutdown = 1;
+  epicsMutexUnlock (sca->lock);
+  epicsEventSignal (sca->wakeup);
+  epicsEventMustWait (sca->ready);
+  
+  Strip_clearfd (sca->strip, sca->pipe_fd[0]);
+  close (sca->pipe_fd[0]);
+  close (sca->pipe_fd[1]);
+  epicsEventDestroy (sca->wakeup);
+  epicsEventDestroy (sca->ready);
+#else
   ca_task_exit ();
+#endif
+  
+#ifdef STRIP_CA_PREEMPTIVE
+  /* no more callbacks now, so whatever is still queued is dropped */
+  while ((call = next_call (sca, &sca->deferred)) != NULL)
+    free (call);
+  epicsMutexDestroy (sca->lock);
+#endif
+
+  for (i = 0; i < sca->n_chan; i++)
+    free (sca->chan_data[i]);
+  free (sca->chan_data);
+  sca->chan_data = NULL;
+  sca->n_chan = sca->max_chan = 0;
 }
 
 
@@ -106,31 +337,43 @@ void StripDAQ_terminate (StripDAQ the_sca)
  */
 int StripDAQ_request_connect (StripCurve curve, void *the_sca)
 {
-  StripDAQInfo  *sca = (StripDAQInfo *)the_sca;
-  int           i;
-  int           ret_val;
+  StripDAQInfo          *sca = (StripDAQInfo *)the_sca;
+  struct _ChannelData   *cd;
+  int                   ret_val;
 #ifdef PEND_DESCRIPTION
   char *description=NULL; /* Albert */
 #endif
   
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
-    if (sca->chan_data[i].chan_id == NULL)
-      break;
-  
-  if ((ret_val = (i < STRIP_MAX_CURVES)))
+  if ((ret_val = ((cd = free_channel (sca)) != NULL)))
   {
-    StripCurve_setattr (curve, STRIPCURVE_FUNCDATA, &sca->chan_data[i], 0);
+    StripCurve_setattr (curve, STRIPCURVE_FUNCDATA, cd, 0);
+    cd->curve = curve;
+    cd->ring_head = cd->ring_tail = 0;
+    cd->waiting = 1;
+#ifdef STRIP_CA_THREAD
+    /* anything still queued belongs to the slot's previous channel */
+    purge_deferred (sca, &sca->deferred, cd);
+    strncpy
+      (cd->name,
+       (char *)StripCurve_getattr_val (curve, STRIPCURVE_NAME),
+       STRIP_MAX_NAME_CHAR);
+    cd->name[STRIP_MAX_NAME_CHAR] = 0;
+    SHARED_SET (&cd->state, CHANNEL_OPEN);
+    defer_channel (&sca->requests, connect_request, cd);
+    return 1;
+#else
 #ifndef PEND_DESCRIPTION
     /* first search for the description field so it is likely to
        connect first */
-    requestDescRecord(curve);
+    requestDescRecord
+      (cd, (char *)StripCurve_getattr_val (curve, STRIPCURVE_NAME));
 #endif
     /* search for the process variable */
     ret_val = ca_search_and_connect
       ((char *)StripCurve_getattr_val (curve, STRIPCURVE_NAME),
-	  &sca->chan_data[i].chan_id,
-	  connect_callback,
-	  curve);
+	  &cd->chan_id,
+	  CONNECT_CALLBACK,
+	  cd);
     if (ret_val != ECA_NORMAL)
     {
       SEVCHK (ret_val, "StripDAQ: Channel Access unable to connect\n");
@@ -140,6 +383,7 @@ int StripDAQ_request_connect (StripCurve curve, void *the_sca)
       ret_val = 0;
     }
     else ret_val = 1;
+#endif
   }
 
 #ifdef PEND_DESCRIPTION
@@ -153,7 +397,9 @@ int StripDAQ_request_connect (StripCurve curve, void *the_sca)
   free(description);
 #endif
 
+#ifndef STRIP_CA_THREAD
   ca_flush_io();
+#endif
   
   return ret_val;
 }
@@ -168,7 +414,7 @@ int StripDAQ_request_connect (StripCurve curve, void *the_sca)
 int StripDAQ_request_disconnect (StripCurve curve, void *the_sca)
 {
   struct _ChannelData   *cd;
-  int                   ret_val = 1;
+  int                   ret_val;
 
   cd = (struct _ChannelData *) StripCurve_getattr_val
     (curve, STRIPCURVE_FUNCDATA);
@@ -176,6 +422,75 @@ int StripDAQ_request_disconnect (StripCurve curve, void *the_sca)
   /* this will happen if a non-CA curve is submitted for disconnect */
   if (!cd) return 1;
 
+#ifdef STRIP_CA_THREAD
+  /* from now on, callbacks for the channel are ignored, see run_deferred() */
+  SHARED_SET (&cd->state, CHANNEL_CLOSING);
+  defer_channel (&cd->this->requests, disconnect_request, cd);
+  ret_val = 1;
+#else
+  ret_val = close_channel (cd);
+#ifdef STRIP_CA_PREEMPTIVE
+  /* callbacks for the channel which haven't been run yet never will */
+  purge_deferred (cd->this, &cd->this->deferred, cd);
+#endif
+#endif
+  return ret_val;
+}
+
+
+/*
+ * free_channel
+ *
+ *      Returns a channel which is free for a new curve, allocating one
+ *      if they are all in use, or NULL if that fails.
+ */
+static struct _ChannelData *free_channel (StripDAQInfo *sca)
+{
+  struct _ChannelData   **p;
+  struct _ChannelData   *cd;
+  int                   i;
+
+  for (i = 0; i < sca->n_chan; i++)
+#ifdef STRIP_CA_THREAD
+    if (SHARED_GET (&sca->chan_data[i]->state) == CHANNEL_FREE)
+#else
+    if (sca->chan_data[i]->chan_id == NULL)
+#endif
+      return sca->chan_data[i];
+
+  if (sca->n_chan == sca->max_chan)
+  {
+    p = (struct _ChannelData **)grow_table
+      (sca->chan_data, &sca->max_chan, sizeof (struct _ChannelData *));
+    if (!p)
+    {
+      fprintf (stderr, "StripDAQ: out of memory\n");
+      return NULL;
+    }
+    sca->chan_data = p;
+  }
+
+  if (!(cd = (struct _ChannelData *)calloc (1, sizeof (struct _ChannelData))))
+  {
+    fprintf (stderr, "StripDAQ: out of memory\n");
+    return NULL;
+  }
+  cd->this = sca;
+  sca->chan_data[sca->n_chan++] = cd;
+  return cd;
+}
+
+
+/*
+ * close_channel
+ *
+ *      Clears the channels and the subscription of a curve.
+ *      Returns 0 if anything fails, otherwise 1
+ */
+static int close_channel (struct _ChannelData *cd)
+{
+  int                   ret_val = 1;
+
 #if DEBUG_DISCONNECT
   fprintf(stderr,"StripDAQ_request_disconnect: %s\n",
     ca_name(cd->chan_id));
@@ -257,30 +572,61 @@ int StripDAQ_request_disconnect (StripCurve curve, void *the_sca)
 int StripDAQ_retry_connections (StripDAQ the_sca, Display *display)
 {
   StripDAQInfo *sca = (StripDAQInfo *)the_sca;
-  int ret_val = 0;
   int found = 0;
   int i;
+#ifndef STRIP_CA_THREAD
   const char *pvname = NULL;
-  chid retryChid;
-  int status;
+#endif
   
   /* Check if all channels are connected */
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
+  for (i = 0; i < sca->n_chan; i++)
   {
-    if (sca->chan_data[i].chan_id &&
-	ca_state(sca->chan_data[i].chan_id) != cs_conn)
+#ifdef STRIP_CA_THREAD
+    /* the Xt thread can't ask CA, but a curve waits until it connects */
+    if (SHARED_GET (&sca->chan_data[i]->state) == CHANNEL_OPEN &&
+	StripCurve_getstat (sca->chan_data[i]->curve, STRIPCURVE_WAITING))
+    {
+	found=1;
+	break;
+    }
+#else
+    if (sca->chan_data[i]->chan_id &&
+	ca_state(sca->chan_data[i]->chan_id) != cs_conn)
     {
-	pvname=ca_name(sca->chan_data[i].chan_id);
+	pvname=ca_name(sca->chan_data[i]->chan_id);
 	if(!pvname) continue;
 	found=1;
 	break;
     }
+#endif
   }
   if(!found)
   {
     XBell (display,50);
     return -1;
   }
+
+#ifdef STRIP_CA_THREAD
+  /* the interface doesn't wait for this one */
+  defer_channel (&sca->requests, retry_request, sca->chan_data[i]);
+  return 0;
+#else
+  return retry_search (pvname);
+#endif
+}
+
+
+/*
+ * retry_search
+ *
+ *      Searches for the given PV for a while, which also restarts the
+ *      searches for the other unconnected ones.
+ */
+static int retry_search (const char *pvname)
+{
+  int ret_val = 0;
+  chid retryChid;
+  int status;
   
   /* Search */
     status=ca_search_and_connect(pvname,&retryChid,NULL,NULL);
@@ -326,6 +672,7 @@ int StripDAQ_retry_connections (StripDAQ the_sca, Display *display)
  *      Add new file descriptors to select upon.
  *      Remove old file descriptors from selection.
  */
+#ifndef STRIP_CA_PREEMPTIVE
 static void addfd_callback (void *data, int fd, int active)
 {
   StripDAQInfo  *strip_ca = (StripDAQInfo *)data;
@@ -355,13 +702,18 @@ static void work_callback (XtPointer      BOGUS(1),
   ca_poll();
 #endif  
 }
+#endif /* #ifndef STRIP_CA_PREEMPTIVE */
 
+#ifndef STRIP_CA_THREAD
 /*
  * timeout_callback
  */
 static void timeout_callback (XtPointer ptr, XtIntervalId *pId)
 {
-  Strip strip = (Strip) ptr;
+  StripDAQInfo  *sca = (StripDAQInfo *)ptr;
+#ifdef STRIP_CA_PREEMPTIVE
+  run_deferred (sca);
+#else
 #if 0
   /* KE: ca_pend_event will block the program unnecessarily for
      STRIP_CA_PEND_TIMEOUT, whether there is anything to do or
@@ -371,8 +723,10 @@ static void timeout_callback (XtPointer ptr, XtIntervalId *pId)
 #else
   ca_poll();
 #endif  
-  Strip_addtimeout ( strip, 0.1, timeout_callback, strip );
+#endif
+  Strip_addtimeout ( sca->strip, 0.1, timeout_callback, sca );
 }
+#endif /* #ifndef STRIP_CA_THREAD */
 
 /*
  * connect_callback
@@ -381,11 +735,12 @@ static void connect_callback (struct connection_handler_args args)
 {
   StripCurve            curve;
   struct _ChannelData   *cd;
+#ifndef STRIP_CA_THREAD
   int                   status;
+#endif
 
-  curve = (StripCurve)(ca_puser (args.chid));
-  cd = (struct _ChannelData *)StripCurve_getattr_val
-    (curve, STRIPCURVE_FUNCDATA);
+  cd = (struct _ChannelData *)ca_puser (args.chid);
+  curve = cd->curve;
 
   switch (ca_state (args.chid))
   {
@@ -393,8 +748,10 @@ static void connect_callback (struct connection_handler_args args)
     fprintf (stderr,
 	"%s StripDAQ connect_callback: IOC not found for %s\n",
 	timeStamp(),ca_name(args.chid)?ca_name(args.chid):"Name Unknown");
+#ifndef STRIP_CA_THREAD
     cd->chan_id = NULL;
     cd->event_id = NULL;
+#endif
     Strip_freecurve (cd->this->strip, curve);
     break;
     
@@ -408,15 +765,17 @@ static void connect_callback (struct connection_handler_args args)
 	  "  cd->chan_id=%x cd->event_id=%x\n",
 	  cd->chan_id, cd->event_id);
 #endif
+    SHARED_SET (&cd->waiting, 1);
     Strip_setwaiting (cd->this->strip, curve);
     break;
     
   case cs_conn:
+#ifndef STRIP_CA_THREAD
     /* now connected, so get the control info if this is first time */
     if (cd->event_id == 0)
     {
 	status = ca_get_callback
-	  (DBR_CTRL_DOUBLE, cd->chan_id, info_callback, curve);
+	  (DBR_CTRL_DOUBLE, cd->chan_id, INFO_CALLBACK, cd);
 	if (status != ECA_NORMAL)
 	{
 	  SEVCHK
@@ -428,6 +787,7 @@ static void connect_callback (struct connection_handler_args args)
 	  "%s StripDAQ connect_callback: IOC reconnected for %s\n",
 	  timeStamp(),ca_name(args.chid)?ca_name(args.chid):"Name Unknown");
     }
+#endif
     break;
     
   case cs_closed:
@@ -439,7 +799,9 @@ static void connect_callback (struct connection_handler_args args)
   
   fflush (stderr);
   
+#ifndef STRIP_CA_THREAD
   ca_flush_io();
+#endif
 }
 
 /*
@@ -450,12 +812,13 @@ static void info_callback (struct event_handler_args args)
   StripCurve                    curve;
   struct _ChannelData           *cd;
   struct dbr_ctrl_double        *ctrl;
+#ifndef STRIP_CA_THREAD
   int                           status;
+#endif
   double                        low, hi;
 
-  curve = (StripCurve)(ca_puser (args.chid));
-  cd = (struct _ChannelData *)StripCurve_getattr_val
-    (curve, STRIPCURVE_FUNCDATA);
+  cd = (struct _ChannelData *)ca_puser (args.chid);
+  curve = cd->curve;
 
   if (args.status != ECA_NORMAL)
   {
@@ -463,7 +826,7 @@ static void info_callback (struct event_handler_args args)
       (stderr,
 	  "StripDAQ info_callback:\n"
 	  "  [%s] get: %s\n",
-	  ca_name(cd->chan_id),
+	  ca_name(args.chid),
 #if 0
 	  ca_message_text[CA_EXTRACT_MSG_NO(args.status)]);
 #else    
@@ -505,70 +868,600 @@ static void info_callback (struct event_handler_args args)
     if (!StripCurve_getstat (curve, STRIPCURVE_MAX_SET))
       StripCurve_setattr (curve, STRIPCURVE_MAX, hi, 0);
 
+#ifndef STRIP_CA_THREAD
     status = ca_add_event
-      (DBR_STS_DOUBLE, cd->chan_id, data_callback, curve, &cd->event_id);
+      (DBR_TIME_DOUBLE, cd->chan_id, data_callback, cd, &cd->event_id);
     if (status != ECA_NORMAL)
     {
       SEVCHK
         (status, "StripDAQ info_callback: error in ca_get_callback");
       Strip_freecurve (cd->this->strip, curve);
     }
+#endif
   }
   
+#ifndef STRIP_CA_THREAD
   ca_flush_io();
+#endif
 }
 
 
 /*
  * data_callback
+ *
+ *      Pushes the update onto the channel's ring.  Anything to do with
+ *      the strip is left to data_arrived() or data_failed().
  */
 static void data_callback (struct event_handler_args args)
 {
-  StripCurve                    curve;
   struct _ChannelData           *cd;
-  struct dbr_sts_double         *sts;
+  struct dbr_time_double        *tms;
+  UpdateRecord                  *rec;
+  int                           next;
 
-  curve = (StripCurve)ca_puser (args.chid);
-  cd = (struct _ChannelData *)StripCurve_getattr_val
-    (curve, STRIPCURVE_FUNCDATA);
+  cd = (struct _ChannelData *)ca_puser (args.chid);
 
   if (args.status != ECA_NORMAL)
   {
-    fprintf
-      (stderr,
-       "StripDAQ data_callback:\n"
-       "  [%s] get: %s\n",
-       ca_name(cd->chan_id),
-       ca_message_text[CA_EXTRACT_MSG_NO(args.status)]);
-    Strip_setwaiting (cd->this->strip, curve);
+    DEFER_EVENT (data_failed, args);
+    return;
   }
-  else
+
+  /* if the ring is full, the update is lost */
+  next = (cd->ring_head + 1) % STRIPCA_RING_SIZE;
+  if (next != SHARED_GET (&cd->ring_tail))
   {
-    if (StripCurve_getstat (curve, STRIPCURVE_WAITING))
-    {
-      StripCurve_setattr
-        (curve, STRIPCURVE_SAMPLEFUNC, get_value, 0);
-      Strip_setconnected (cd->this->strip, curve);
-    }
-    sts = (struct dbr_sts_double *)args.dbr;
-    cd->value = sts->value;
+    tms = (struct dbr_time_double *)args.dbr;
+    rec = &cd->ring[cd->ring_head];
+    
+    /* IOCs without a time source send a null stamp */
+    if (tms->stamp.secPastEpoch == 0)
+      get_current_time (&rec->time);
+    else epicsTimeToTimeval (&rec->time, &tms->stamp);
+    rec->value = tms->value;
+    
+    SHARED_SET (&cd->ring_head, next);
+  }
+
+  if (SHARED_GET (&cd->waiting))
+  {
+    SHARED_SET (&cd->waiting, 0);
+    DEFER_EVENT (data_arrived, args);
+  }
+}
+
+
+/*
+ * data_arrived
+ *
+ *      First update since the curve was connected or went waiting.
+ */
+static void data_arrived (struct event_handler_args args)
+{
+  StripCurve                    curve;
+  struct _ChannelData           *cd;
+
+  cd = (struct _ChannelData *)ca_puser (args.chid);
+  curve = cd->curve;
+
+  if (StripCurve_getstat (curve, STRIPCURVE_WAITING))
+  {
+    StripCurve_setattr
+      (curve, STRIPCURVE_SAMPLEFUNC, get_value,
+       STRIPCURVE_EVENTFUNC, get_events, 0);
+    Strip_setconnected (cd->this->strip, curve);
   }
 }
 
 
+/*
+ * data_failed
+ */
+static void data_failed (struct event_handler_args args)
+{
+  StripCurve                    curve;
+  struct _ChannelData           *cd;
+
+  cd = (struct _ChannelData *)ca_puser (args.chid);
+  curve = cd->curve;
+
+  fprintf
+    (stderr,
+     "StripDAQ data_callback:\n"
+     "  [%s] get: %s\n",
+     ca_name(args.chid),
+     ca_message_text[CA_EXTRACT_MSG_NO(args.status)]);
+  SHARED_SET (&cd->waiting, 1);
+  Strip_setwaiting (cd->this->strip, curve);
+}
+
+
 /*
  * get_value
  *
- *      Returns the current value specified by the CurveData passed in.
+ *      Returns the latest value for the CurveData passed in.  The queued
+ *      updates are consumed, unless the curve is in monitor mode, where
+ *      they are left for get_events().
  */
 static double get_value (void *data)
 {
   struct _ChannelData   *cd = (struct _ChannelData *)data;
+  int                   head;
+
+  head = SHARED_GET (&cd->ring_head);
+  if (head != cd->ring_tail)
+  {
+    /* an update is not overwritten before it is consumed */
+    cd->value =
+      cd->ring[(head + STRIPCA_RING_SIZE - 1) % STRIPCA_RING_SIZE].value;
+    if (!*(int *)StripCurve_getattr_val (cd->curve, STRIPCURVE_MONITOR))
+      SHARED_SET (&cd->ring_tail, head);
+  }
 
   return cd->value;
 }
 
 
+/*
+ * get_events
+ *
+ *      Consumes up to n of the queued updates for the CurveData passed
+ *      in, copying them to the given arrays, oldest first.  Returns the
+ *      number consumed.
+ */
+static int get_events (void *data, struct timeval *t, double *v, int n)
+{
+  struct _ChannelData   *cd = (struct _ChannelData *)data;
+  int                   head, tail;
+  int                   i;
+
+  head = SHARED_GET (&cd->ring_head);
+  tail = cd->ring_tail;
+  for (i = 0; (i < n) && (tail != head); i++)
+  {
+    t[i] = cd->ring[tail].time;
+    v[i] = cd->value = cd->ring[tail].value;
+    tail = (tail + 1) % STRIPCA_RING_SIZE;
+  }
+  SHARED_SET (&cd->ring_tail, tail);
+  
+  return i;
+}
+
+
+#ifdef STRIP_CA_PREEMPTIVE
+/*
+ * defer_connection, defer_event, defer_channel
+ *
+ *      Queue a call, with a copy of its arguments, to be run on the Xt
+ *      thread, or the CA thread.
+ */
+static void defer_call (CallQueue *q, DeferredCall *call)
+{
+  StripDAQInfo  *sca = call->cd->this;
+#ifdef STRIP_CA_THREAD
+  int           was_empty;
+  char          c = 0;
+#endif
+  
+  epicsMutexMustLock (sca->lock);
+#ifdef STRIP_CA_THREAD
+  was_empty = (q->first == NULL);
+#endif
+  if (q->last)
+    q->last->next = call;
+  else q->first = call;
+  q->last = call;
+  epicsMutexUnlock (sca->lock);
+
+#ifdef STRIP_CA_THREAD
+  if (q == &sca->requests)
+    epicsEventSignal (sca->wakeup);
+  
+  /* otherwise the main loop has a wake-up pending anyway */
+  else if (was_empty)
+    write (sca->pipe_fd[1], &c, 1);
+#endif
+}
+
+static void defer_connection (CallQueue *q, caCh *func,
+                              struct connection_handler_args args)
+{
+  DeferredCall          *call;
+
+  if ((call = (DeferredCall *)calloc (1, sizeof (DeferredCall))) == NULL)
+  {
+    fprintf (stderr, "StripDAQ: out of memory, lost connection event\n");
+    return;
+  }
+  call->cd = CHANNEL (args.chid);
+  call->conn_func = func;
+  call->conn_args = args;
+  defer_call (q, call);
+}
+
+static void defer_event (CallQueue *q, caEventCallBackFunc *func,
+                         struct event_handler_args args)
+{
+  DeferredCall          *call;
+  size_t                size = 0;
+
+  /* the data only lasts as long as the callback */
+  if (args.dbr)
+    size = dbr_size_n (args.type, args.count);
+  
+  if ((call = (DeferredCall *)calloc (1, sizeof (DeferredCall) + size))
+      == NULL)
+  {
+    fprintf (stderr, "StripDAQ: out of memory, lost event\n");
+    return;
+  }
+  call->cd = CHANNEL (args.chid);
+  call->event_func = func;
+  call->event_args = args;
+  if (args.dbr)
+  {
+    memcpy (call->dbr, args.dbr, size);
+    call->event_args.dbr = call->dbr;
+  }
+  defer_call (q, call);
+}
+
+static void defer_channel (CallQueue *q, ChannelFunc *func,
+                           struct _ChannelData *cd)
+{
+  DeferredCall          *call;
+
+  if ((call = (DeferredCall *)calloc (1, sizeof (DeferredCall))) == NULL)
+  {
+    fprintf (stderr, "StripDAQ: out of memory, lost request\n");
+    return;
+  }
+  call->cd = cd;
+  call->chan_func = func;
+  defer_call (q, call);
+}
+
+
+/*
+ * next_call
+ *
+ *      Takes the first call off the queue, if any.
+ */
+static DeferredCall *next_call (StripDAQInfo *sca, CallQueue *q)
+{
+  DeferredCall  *call;
+
+  epicsMutexMustLock (sca->lock);
+  if ((call = q->first) != NULL)
+    if ((q->first = call->next) == NULL)
+      q->last = NULL;
+  epicsMutexUnlock (sca->lock);
+
+  return call;
+}
+
+
+/*
+ * run_call
+ */
+static void run_call (DeferredCall *call)
+{
+  if (call->conn_func)
+    call->conn_func (call->conn_args);
+  else if (call->event_func)
+    call->event_func (call->event_args);
+  else call->chan_func (call->cd);
+}
+
+
+/*
+ * run_deferred
+ *
+ *      Runs the calls queued for the Xt thread in order.  They are taken
+ *      off the queue one at a time, since they may purge some of the
+ *      others.
+ */
+static void run_deferred (StripDAQInfo *sca)
+{
+  DeferredCall  *call;
+
+  while ((call = next_call (sca, &sca->deferred)) != NULL)
+  {
+#ifdef STRIP_CA_THREAD
+    /* the curve has gone, even if its channel hasn't yet */
+    if (SHARED_GET (&call->cd->state) == CHANNEL_OPEN)
+#endif
+      run_call (call);
+    free (call);
+  }
+}
+
+
+/*
+ * purge_deferred
+ *
+ *      Drops the queued calls for the given channel slot.
+ */
+static void purge_deferred (StripDAQInfo *sca, CallQueue *q,
+                            struct _ChannelData *cd)
+{
+  DeferredCall  **p, *call, *last = NULL;
+
+  epicsMutexMustLock (sca->lock);
+  for (p = &q->first; (call = *p) != NULL; )
+  {
+    if (call->cd == cd)
+    {
+      *p = call->next;
+      free (call);
+    }
+    else
+    {
+      last = call;
+      p = &call->next;
+    }
+  }
+  q->last = last;
+  epicsMutexUnlock (sca->lock);
+}
+#endif /* STRIP_CA_PREEMPTIVE */
+
+
+#ifdef STRIP_CA_THREAD
+/*
+ * start_thread
+ *
+ *      Starts the CA thread, and registers the pipe through which it
+ *      wakes up the main loop.  Returns the status of the context
+ *      creation.
+ */
+static int start_thread (StripDAQInfo *sca)
+{
+  int   status = ECA_ALLOCMEM;
+  
+  if (pipe (sca->pipe_fd) != 0)
+  {
+    perror ("StripDAQ: can't create pipe");
+    return status;
+  }
+  fcntl (sca->pipe_fd[0], F_SETFL, O_NONBLOCK);
+  fcntl (sca->pipe_fd[1], F_SETFL, O_NONBLOCK);
+
+  sca->lock = epicsMutexCreate ();
+  sca->wakeup = epicsEventCreate (epicsEventEmpty);
+  sca->ready = epicsEventCreate (epicsEventEmpty);
+  if (!sca->lock || !sca->wakeup || !sca->ready)
+    fprintf (stderr, "StripDAQ: unable to create mutex or events\n");
+  else if (!Strip_addfd
+           (sca->strip, sca->pipe_fd[0], wakeup_callback, (XtPointer)sca))
+    fprintf (stderr, "StripDAQ: can't watch CA pipe\n");
+  else
+  {
+    sca->thread = epicsThreadCreate
+      ("StripCA", epicsThreadPriorityMedium,
+       epicsThreadGetStackSize (epicsThreadStackMedium), ca_thread, sca);
+    if (!sca->thread)
+      fprintf (stderr, "StripDAQ: can't start CA thread\n");
+    else
+    {
+      epicsEventMustWait (sca->ready);
+      if ((status = sca->status) == ECA_NORMAL)
+        return status;
+    }
+    Strip_clearfd (sca->strip, sca->pipe_fd[0]);
+  }
+
+  if (sca->ready) epicsEventDestroy (sca->ready);
+  if (sca->wakeup) epicsEventDestroy (sca->wakeup);
+  if (sca->lock) epicsMutexDestroy (sca->lock);
+  close (sca->pipe_fd[0]);
+  close (sca->pipe_fd[1]);
+  return status;
+}
+
+
+/*
+ * ca_thread
+ *
+ *      Owns the CA context.  Runs the requests from the Xt thread and
+ *      the callbacks passed on by CA, one at a time, until shut down.
+ */
+static void ca_thread (void *arg)
+{
+  StripDAQInfo  *sca = (StripDAQInfo *)arg;
+  DeferredCall  *call;
+  int           shutdown;
+
+  sca->status = ca_context_create (ca_enable_preemptive_callback);
+  epicsEventSignal (sca->ready);
+  if (sca->status != ECA_NORMAL) return;
+
+  do
+  {
+    epicsEventMustWait (sca->wakeup);
+    
+    epicsMutexMustLock (sca->lock);
+    shutdown = sca->shutdown;
+    epicsMutexUnlock (sca->lock);
+    
+    while ((call = next_call (sca, &sca->requests)) != NULL)
+    {
+      run_call (call);
+      free (call);
+    }
+    ca_flush_io ();
+  }
+  while (!shutdown);
+
+  ca_context_destroy ();
+  epicsEventSignal (sca->ready);
+}
+
+
+/*
+ * wakeup_callback
+ *
+ *      Called from the main loop when the CA thread has queued calls.
+ */
+static void wakeup_callback (XtPointer          client_data,
+                             int                *fd,
+                             XtInputId          *BOGUS(id))
+{
+  StripDAQInfo  *sca = (StripDAQInfo *)client_data;
+  char          buf[64];
+
+  while (read (*fd, buf, sizeof (buf)) > 0);
+  run_deferred (sca);
+}
+
+
+/*
+ * connect_request
+ */
+static void connect_request (struct _ChannelData *cd)
+{
+  int   status;
+  
+#ifndef PEND_DESCRIPTION
+  /* first search for the description field so it is likely to
+     connect first */
+  requestDescRecord (cd, cd->name);
+#endif
+  /* search for the process variable */
+  status = ca_search_and_connect
+    (cd->name, &cd->chan_id, CONNECT_CALLBACK, cd);
+  if (status != ECA_NORMAL)
+  {
+    SEVCHK (status, "StripDAQ: Channel Access unable to connect\n");
+    fprintf (stderr, "channel name: %s\n", cd->name);
+    defer_channel (&cd->this->deferred, release_curve, cd);
+  }
+}
+
+
+/*
+ * disconnect_request
+ *
+ *      Once the channels are cleared, CA has no more callbacks for them
+ *      under way, so whatever is queued for them can go, and the slot is
+ *      free.
+ */
+static void disconnect_request (struct _ChannelData *cd)
+{
+  close_channel (cd);
+  purge_deferred (cd->this, &cd->this->requests, cd);
+  SHARED_SET (&cd->state, CHANNEL_FREE);
+}
+
+
+/*
+ * retry_request
+ */
+static void retry_request (struct _ChannelData *cd)
+{
+  if (cd->chan_id && ca_state (cd->chan_id) != cs_conn)
+    retry_search (cd->name);
+}
+
+
+/*
+ * release_curve
+ *
+ *      Run on the Xt thread for a curve which won't ever connect.
+ */
+static void release_curve (struct _ChannelData *cd)
+{
+  Strip_freecurve (cd->this->strip, cd->curve);
+}
+
+
+/*
+ * connect_ca
+ *
+ *      First part of connect_callback(), run on the CA thread: gets the
+ *      control info on first connection.
+ */
+static void connect_ca (struct connection_handler_args args)
+{
+  struct _ChannelData   *cd = CHANNEL (args.chid);
+  int                   status;
+
+  defer_connection (&cd->this->deferred, connect_callback, args);
+  
+  if (ca_state (args.chid) != cs_conn) return;
+  
+  if (cd->event_id == 0)
+  {
+    status = ca_get_callback
+      (DBR_CTRL_DOUBLE, cd->chan_id, INFO_CALLBACK, cd);
+    if (status != ECA_NORMAL)
+    {
+      SEVCHK (status, "StripDAQ connect_callback: error in ca_get_callback");
+      defer_channel (&cd->this->deferred, release_curve, cd);
+    }
+  }
+  else
+  {
+    fprintf (stderr,
+      "%s StripDAQ connect_callback: IOC reconnected for %s\n",
+      timeStamp(),ca_name(args.chid)?ca_name(args.chid):"Name Unknown");
+  }
+}
+
+
+/*
+ * info_ca
+ *
+ *      First part of info_callback(), run on the CA thread: subscribes
+ *      to the value, once info_callback() has been queued so that the
+ *      curve is set up before its first update.
+ */
+static void info_ca (struct event_handler_args args)
+{
+  struct _ChannelData   *cd = CHANNEL (args.chid);
+  int                   status;
+
+  defer_event (&cd->this->deferred, info_callback, args);
+
+  if (args.status != ECA_NORMAL) return;
+  
+  status = ca_add_event
+    (DBR_TIME_DOUBLE, cd->chan_id, data_callback, cd, &cd->event_id);
+  if (status != ECA_NORMAL)
+  {
+    SEVCHK (status, "StripDAQ info_callback: error in ca_get_callback");
+    defer_channel (&cd->this->deferred, release_curve, cd);
+  }
+}
+
+
+#ifndef PEND_DESCRIPTION
+/*
+ * clear_desc_request
+ *
+ *      Clears the description channel, once desc_info_callback() is
+ *      through with it.
+ */
+static void clear_desc_request (struct _ChannelData *cd)
+{
+  int                   status;
+
+  if (cd->desc_chan_id == NULL) return;
+  
+  if ((status = ca_clear_channel (cd->desc_chan_id)) != ECA_NORMAL)
+  {
+    SEVCHK (status, "desc_info_callback: error in ca_clear_channel");
+  }
+  else
+  {
+    cd->desc_chan_id = NULL;
+  }
+}
+#endif
+#endif /* STRIP_CA_THREAD */
+
+
 #ifdef PEND_DESCRIPTION
 /*
  * getDescriptionRecord
@@ -650,13 +1543,10 @@ static void getDescriptionRecord (char *name, char *description)
  *
  *      Searches for the description with callback
  */
-static void requestDescRecord (StripCurve curve)
+static void requestDescRecord (struct _ChannelData *cd, char *name)
 {
   int status;
   static char desc_name[64];
-  char *name = (char *)StripCurve_getattr_val (curve, STRIPCURVE_NAME);
-  struct _ChannelData *cd = (struct _ChannelData *)StripCurve_getattr_val
-    (curve, STRIPCURVE_FUNCDATA);
   char *ptr;
 
   /* construct the name */
@@ -673,7 +1563,7 @@ static void requestDescRecord (StripCurve curve)
 	desc_name?desc_name:"NULL");
 #endif
   status = ca_search_and_connect (desc_name, &cd->desc_chan_id,
-    desc_connect_callback, curve);
+    DESC_CONNECT_CALLBACK, cd);
   if (status != ECA_NORMAL) {
 #ifdef PRINT_DESC_ERRORS      
     SEVCHK(status,"     Search for description field failed\n");
@@ -687,13 +1577,10 @@ static void requestDescRecord (StripCurve curve)
  */
 static void desc_connect_callback (struct connection_handler_args args)
 {
-  StripCurve            curve;
   struct _ChannelData   *cd;
   int                   status;
   
-  curve = (StripCurve)(ca_puser (args.chid));
-  cd = (struct _ChannelData *)StripCurve_getattr_val
-    (curve, STRIPCURVE_FUNCDATA);
+  cd = (struct _ChannelData *)ca_puser (args.chid);
   
   switch (ca_state (args.chid))
   {
@@ -719,7 +1606,7 @@ static void desc_connect_callback (struct connection_handler_args args)
 	ca_name(cd->desc_chan_id)?ca_name(cd->desc_chan_id):"NULL");
 #endif
     status = ca_get_callback (DBR_STRING, cd->desc_chan_id,
-	desc_info_callback, curve);
+	DESC_INFO_CALLBACK, cd);
     if (status != ECA_NORMAL)
     {
 	SEVCHK (status,
@@ -747,11 +1634,12 @@ static void desc_info_callback (struct event_handler_args args)
   StripCurve                    curve;
   struct _ChannelData           *cd;
   char                          *desc;
+#ifndef STRIP_CA_THREAD
   int                           status;
+#endif
 
-  curve = (StripCurve)(ca_puser (args.chid));
-  cd = (struct _ChannelData *)StripCurve_getattr_val
-    (curve, STRIPCURVE_FUNCDATA);
+  cd = (struct _ChannelData *)ca_puser (args.chid);
+  curve = cd->curve;
 
   if (args.status != ECA_NORMAL)
   {
@@ -776,6 +1664,9 @@ static void desc_info_callback (struct event_handler_args args)
     Strip_setdescconnected (cd->this->strip, curve);
 
     /* clear the description channel, we are through */
+#ifdef STRIP_CA_THREAD
+    defer_channel (&cd->this->requests, clear_desc_request, cd);
+#else
 #if DEBUG_ASSERT
     printf("desc_info_callback: ca_clear_channel: %s\n",
 	ca_name(cd->desc_chan_id)?ca_name(cd->desc_chan_id):"NULL");
@@ -790,6 +1681,7 @@ static void desc_info_callback (struct event_handler_args args)
     }
 #if DEBUG_ASSERT
     printf("  Done\n");
+#endif
 #endif
 
   }
@@ -61,10 +61,14 @@ typedef struct _DeviceData
 DeviceData;
   
 
+/* devices are allocated one by one and never move, as the curves and
+ * callbacks hold on to them */
 typedef struct _StripDAQInfo
 {
   Strip         strip;
-  DeviceData    dev_data[STRIP_MAX_CURVES];
+  DeviceData    **dev_data;
+  int           n_dev;          /* devices allocated */
+  int           max_dev;        /* size of dev_data */
 } StripDAQInfo;
       
 
@@ -77,6 +81,7 @@ static void     data_callback   (int,
                                  cdevRequestObject &,
                                  cdevData &);
 static double   get_value       (void *);
+static DeviceData       *free_device    (StripDAQInfo *);
 
 /*
  * StripDAQ_initialize
@@ -92,12 +97,6 @@ extern "C" StripDAQ        StripDAQ_initialize     (Strip strip)
   if ((scd = (StripDAQInfo *)calloc (sizeof (StripDAQInfo), 1)) != NULL)
   {
     scd->strip = strip;
-    for (i = 0; i < STRIP_MAX_CURVES; i++)
-    {
-      scd->dev_data[i].cb = 0;
-      scd->dev_data[i].tag = -1;
-      scd->dev_data[i].this_ = scd;
-    }
 
     system.setThreshold (CDEV_SEVERITY_ERROR);
 
@@ -132,11 +131,13 @@ extern "C" void    StripDAQ_terminate      (StripDAQ the_scd)
   StripDAQInfo  *scd = (StripDAQInfo *)the_scd;
   int           i;
   
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
+  for (i = 0; i < scd->n_dev; i++)
   {
-    if (scd->dev_data[i].cb)
-      delete scd->dev_data[i].cb;
+    if (scd->dev_data[i]->cb)
+      delete scd->dev_data[i]->cb;
+    free (scd->dev_data[i]);
   }
+  free (scd->dev_data);
   free (scd);
 }
 
@@ -157,13 +158,8 @@ extern "C" int     StripDAQ_request_connect        (StripCurve curve, void *the_
   char                  msg_buf[MAX_BUF_LEN];
   int                   tag;
 
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
-    if (scd->dev_data[i].cb == 0)
-      break;
-
-  if (ret_val = (i < STRIP_MAX_CURVES))
+  if (ret_val = ((dd = free_device (scd)) != 0))
   {
-    dd = &scd->dev_data[i];
     StripCurve_setattr (curve, STRIPCURVE_FUNCDATA, dd, 0);
       
     /* parse string designating the requested value for device/attribute */
@@ -429,3 +425,36 @@ static double   get_value       (void *data)
 
   return dd->value;
 }
+
+
+/*
+ * free_device
+ *
+ *      Returns a device which is free for a new curve, allocating one
+ *      if they are all in use, or 0 if that fails.
+ */
+static DeviceData       *free_device    (StripDAQInfo *scd)
+{
+  DeviceData    **p;
+  DeviceData    *dd;
+  int           i;
+
+  for (i = 0; i < scd->n_dev; i++)
+    if (scd->dev_data[i]->cb == 0)
+      return scd->dev_data[i];
+
+  if (scd->n_dev == scd->max_dev)
+  {
+    p = (DeviceData **)grow_table
+      (scd->dev_data, &scd->max_dev, sizeof (DeviceData *));
+    if (!p) return 0;
+    scd->dev_data = p;
+  }
+
+  if (!(dd = (DeviceData *)calloc (1, sizeof (DeviceData)))) return 0;
+  dd->cb = 0;
+  dd->tag = -1;
+  dd->this_ = scd;
+  scd->dev_data[scd->n_dev++] = dd;
+  return dd;
+}
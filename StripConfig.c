@@ -33,6 +33,10 @@ extern char *strdup(const char *);
 #define NUMERIC_COLUMNWIDTH             10
 #define BUFSIZE                         256
 
+/* the curve colors, from first to last, share the case of the first */
+#define COLOR_CASE(x,first,last) \
+(((x) >= (first)) && ((x) <= (last))? (first) : (x))
+
 char    *untitled_ = "Untitled";
 
 typedef enum
@@ -43,19 +47,12 @@ typedef enum
   NUM_SAMPLES,
   SAMPLE_INTERVAL,
   REFRESH_INTERVAL,
+  LEGEND_INTERVAL,
   BACKGROUND,
   FOREGROUND,
   GRID,
   COLOR1,
-  COLOR2,
-  COLOR3,
-  COLOR4,
-  COLOR5,
-  COLOR6,
-  COLOR7,
-  COLOR8,
-  COLOR9,
-  COLOR10,
+  COLORN = COLOR1 + STRIP_MAX_CURVES - 1,      /* one per curve */
   GRID_XON,
   GRID_YON,
   AXIS_YCOLORSTAT,
@@ -68,6 +65,7 @@ typedef enum
   MAX,
   SCALE,
   PLOTSTAT,
+  MONITOR,
   STRIP,
   TIME,
   COLOR,
@@ -78,7 +76,13 @@ typedef enum
 }
 SCFToken;
 
-char    *SCFTokenStr[LAST_TOKEN] =
+/* the token strings, filled in by StripConfig_preinit() from these,
+ * with "Color1" ... "ColorN" for the curve colors */
+char    *SCFTokenStr[LAST_TOKEN];
+
+static char     SCFColorTokenStr[STRIP_MAX_CURVES][16];
+
+static char     *SCFOtherTokenStr[LAST_TOKEN - STRIP_MAX_CURVES] =
 {
   "Title",
   "Filename",
@@ -86,19 +90,10 @@ char    *SCFTokenStr[LAST_TOKEN] =
   "NumSamples",
   "SampleInterval",
   "RefreshInterval",
+  "LegendInterval",
   "Background",
   "Foreground",
   "Grid",
-  "Color1",
-  "Color2",
-  "Color3",
-  "Color4",
-  "Color5",
-  "Color6",
-  "Color7",
-  "Color8",
-  "Color9",
-  "Color10",
   "GridXon",
   "GridYon",
   "AxisYcolorStat",
@@ -111,6 +106,7 @@ char    *SCFTokenStr[LAST_TOKEN] =
   "Max",
   "Scale",
   "PlotStatus",
+  "Monitor",
   "Strip",
   "Time",
   "Color",
@@ -138,6 +134,14 @@ typedef enum
 }
 StripCfgColorIdx;
 
+/* default color of the ith color of the configuration (curves after
+ * the tenth take those of the first ten again) */
+#define STRIPCFG_COLORSTR(i) \
+StripCfgColorStr \
+[((i) < STRIPCFG_COLOR1)? (i) : \
+ STRIPCFG_COLOR1 + \
+ ((i) - STRIPCFG_COLOR1) % (STRIPCFG_LASTIDX - STRIPCFG_COLOR1)]
+
 static char     *StripCfgColorStr[STRIPCFG_LASTIDX] =
 {
   STRIPDEF_COLOR_BACKGROUND_STR,
@@ -165,18 +169,30 @@ StripConfigMask SCFGMASK_ALL;
 void    StripConfig_preinit     (void)
 {
   StripConfigMaskElement        elem;
+  int                           i;
+
+  /* TOKENS */
+  for (i = 0; i < LAST_TOKEN; i++)
+    if (i < COLOR1)
+      SCFTokenStr[i] = SCFOtherTokenStr[i];
+    else if (i <= COLORN)
+    {
+      sprintf (SCFColorTokenStr[i - COLOR1], "Color%d", i - COLOR1 + 1);
+      SCFTokenStr[i] = SCFColorTokenStr[i - COLOR1];
+    }
+    else SCFTokenStr[i] = SCFOtherTokenStr[i - STRIP_MAX_CURVES];
 
   /* TIME */
   StripConfigMask_clear (&SCFGMASK_TIME);
   for (elem = SCFGMASK_TIME_TIMESPAN;
-       elem <= SCFGMASK_TIME_REFRESH_INTERVAL;
+       elem <= SCFGMASK_TIME_LEGEND_INTERVAL;
        elem++)
     StripConfigMask_set (&SCFGMASK_TIME, elem);
 
   /* COLOR */
   StripConfigMask_clear (&SCFGMASK_COLOR);
   for (elem = SCFGMASK_COLOR_BACKGROUND;
-       elem <= SCFGMASK_COLOR_COLOR10;
+       elem <= SCFGMASK_COLOR_COLORN;
        elem++)
     StripConfigMask_set (&SCFGMASK_COLOR, elem);
 
@@ -190,7 +206,7 @@ void    StripConfig_preinit     (void)
   /* CURVE */
   StripConfigMask_clear (&SCFGMASK_CURVE);
   for (elem = SCFGMASK_CURVE_NAME;
-       elem <= SCFGMASK_CURVE_PLOTSTAT;
+       elem <= SCFGMASK_CURVE_MONITOR;
        elem++)
     StripConfigMask_set (&SCFGMASK_CURVE, elem);
 
@@ -305,7 +321,8 @@ StripConfig     *StripConfig_init       (cColorManager  scm,
     return 0;
 
   scfg->scm                     = scm;
-  scfg->xvi                     = *xvi;
+  if (xvi) scfg->xvi            = *xvi;
+  else memset (&scfg->xvi, 0, sizeof (XVisualInfo));
   scfg->title                   = STRIPDEF_TITLE;
   scfg->filename                = 0;
   
@@ -313,23 +330,29 @@ StripConfig     *StripConfig_init       (cColorManager  scm,
   scfg->Time.num_samples        = STRIPDEF_TIME_NUM_SAMPLES;
   scfg->Time.sample_interval    = STRIPDEF_TIME_SAMPLE_INTERVAL;
   scfg->Time.refresh_interval   = STRIPDEF_TIME_REFRESH_INTERVAL;
-
-  /* get the default colors */
-  cColorManager_build_palette (scfg->scm, 0, CCM_MAX_PALETTE_SIZE);
-  for (i = 0; i < STRIPCONFIG_NUMCOLORS; i++)
+  scfg->Time.legend_interval    = STRIPDEF_TIME_LEGEND_INTERVAL;
+
+  /* get the default colors.  Without a color manager (no display)
+   * none are allocated, and only colors read from a file will have
+   * their rgb values filled in */
+  memset (colors, 0, sizeof (colors));
+  if (scfg->scm)
+    cColorManager_build_palette (scfg->scm, 0, CCM_MAX_PALETTE_SIZE);
+  for (i = 0; scfg->scm && (i < STRIPCONFIG_NUMCOLORS); i++)
   {
     /* first try to make a writable color.  If that fails, settle
      * for read-only */
     stat = cColorManager_make_color
-      (scfg->scm, &colors[i], StripCfgColorStr[i], CCM_RW_TRY | CCM_MATCH_STR);
+      (scfg->scm, &colors[i], STRIPCFG_COLORSTR(i),
+       CCM_RW_TRY | CCM_MATCH_STR);
     if (!stat)
       stat = cColorManager_make_color
-        (scfg->scm, &colors[i], StripCfgColorStr[i], CCM_RO | CCM_MATCH_STR);
+        (scfg->scm, &colors[i], STRIPCFG_COLORSTR(i), CCM_RO | CCM_MATCH_STR);
     if (!stat)
       fprintf (stderr, "StripConfig_init: unable to make color\n");
     else cColorManager_keep_color (scfg->scm, &colors[i]);
   }
-  cColorManager_free_palette (scfg->scm);
+  if (scfg->scm) cColorManager_free_palette (scfg->scm);
 
   i = 0;
   scfg->Color.background        = colors[i++];
@@ -444,7 +467,8 @@ int     StripConfig_setattr (StripConfig *scfg, ...)
   {
     if ((ret_val = ((attrib >= STRIPCONFIG_FIRST_ATTRIBUTE) &&
 	(attrib <= STRIPCONFIG_LAST_ATTRIBUTE))))
-      switch (attrib)
+      switch (COLOR_CASE (attrib, STRIPCONFIG_COLOR_COLOR1,
+                          STRIPCONFIG_COLOR_COLORN))
       {
 	case STRIPCONFIG_TITLE:
 	  tmp.str = va_arg (ap, char *);
@@ -521,6 +545,19 @@ int     StripConfig_setattr (StripConfig *scfg, ...)
 	  }
 	  break;
             
+	case STRIPCONFIG_TIME_LEGEND_INTERVAL:
+	  tmp.d = va_arg (ap, double);
+	  if (tmp.d != scfg->Time.legend_interval)
+	  {
+	    tmp.d = max (tmp.d, STRIPMIN_TIME_LEGEND_INTERVAL);
+	    tmp.d = min (tmp.d, STRIPMAX_TIME_LEGEND_INTERVAL);
+	    scfg->Time.legend_interval = tmp.d;
+	    StripConfigMask_set
+		(&scfg->UpdateInfo.update_mask,
+		  SCFGMASK_TIME_LEGEND_INTERVAL);
+	  }
+	  break;
+            
 	case STRIPCONFIG_COLOR_BACKGROUND:
 	  scfg->Color.background = *(va_arg (ap, cColor *));
 	  StripConfigMask_set
@@ -539,65 +576,11 @@ int     StripConfig_setattr (StripConfig *scfg, ...)
 	    (&scfg->UpdateInfo.update_mask,
 		SCFGMASK_COLOR_GRID);
 	  break;
-	case STRIPCONFIG_COLOR_COLOR1:
-	  scfg->Color.color[0] = *(va_arg (ap, cColor *));
-	  StripConfigMask_set
-	    (&scfg->UpdateInfo.update_mask,
-		SCFGMASK_COLOR_COLOR1);
-	  break;
-	case STRIPCONFIG_COLOR_COLOR2:
-	  scfg->Color.color[1] = *(va_arg (ap, cColor *));
-	  StripConfigMask_set
-	    (&scfg->UpdateInfo.update_mask,
-		SCFGMASK_COLOR_COLOR2);
-	  break;
-	case STRIPCONFIG_COLOR_COLOR3:
-	  scfg->Color.color[2] = *(va_arg (ap, cColor *));
+	case STRIPCONFIG_COLOR_COLOR1:          /* ... COLORN */
+	  scfg->Color.color[attrib - STRIPCONFIG_COLOR_COLOR1] =
+	    *(va_arg (ap, cColor *));
 	  StripConfigMask_set
-	    (&scfg->UpdateInfo.update_mask,
-		SCFGMASK_COLOR_COLOR3);
-	  break;
-	case STRIPCONFIG_COLOR_COLOR4:
-	  scfg->Color.color[3] = *(va_arg (ap, cColor *));
-	  StripConfigMask_set
-	    (&scfg->UpdateInfo.update_mask,
-		SCFGMASK_COLOR_COLOR4);
-	  break;
-	case STRIPCONFIG_COLOR_COLOR5:
-	  scfg->Color.color[4] = *(va_arg (ap, cColor *));
-	  StripConfigMask_set
-	    (&scfg->UpdateInfo.update_mask,
-		SCFGMASK_COLOR_COLOR5);
-	  break;
-	case STRIPCONFIG_COLOR_COLOR6:
-	  scfg->Color.color[5] = *(va_arg (ap, cColor *));
-	  StripConfigMask_set
-	    (&scfg->UpdateInfo.update_mask,
-		SCFGMASK_COLOR_COLOR6);
-	  break;
-	case STRIPCONFIG_COLOR_COLOR7:
-	  scfg->Color.color[6] = *(va_arg (ap, cColor *));
-	  StripConfigMask_set
-	    (&scfg->UpdateInfo.update_mask,
-		SCFGMASK_COLOR_COLOR7);
-	  break;
-	case STRIPCONFIG_COLOR_COLOR8:
-	  scfg->Color.color[7] = *(va_arg (ap, cColor *));
-	  StripConfigMask_set
-	    (&scfg->UpdateInfo.update_mask,
-		SCFGMASK_COLOR_COLOR8);
-	  break;
-	case STRIPCONFIG_COLOR_COLOR9:
-	  scfg->Color.color[8] = *(va_arg (ap, cColor *));
-	  StripConfigMask_set
-	    (&scfg->UpdateInfo.update_mask,
-		SCFGMASK_COLOR_COLOR9);
-	  break;
-	case STRIPCONFIG_COLOR_COLOR10:
-	  scfg->Color.color[9] = *(va_arg (ap, cColor *));
-	  StripConfigMask_set
-	    (&scfg->UpdateInfo.update_mask,
-		SCFGMASK_COLOR_COLOR10);
+	    (&scfg->UpdateInfo.update_mask, (StripConfigMaskElement)attrib);
 	  break;
             
 	case STRIPCONFIG_OPTION_GRID_XON:
@@ -681,7 +664,8 @@ int     StripConfig_getattr (StripConfig *scfg, ...)
   {
     if ((ret_val = ((attrib >= STRIPCONFIG_FIRST_ATTRIBUTE) &&
 	(attrib <= STRIPCONFIG_LAST_ATTRIBUTE))))
-      switch (attrib)
+      switch (COLOR_CASE (attrib, STRIPCONFIG_COLOR_COLOR1,
+                          STRIPCONFIG_COLOR_COLORN))
       {
 	case STRIPCONFIG_TITLE:
 	  *(va_arg (ap, char **)) = scfg->title;
@@ -701,6 +685,9 @@ int     StripConfig_getattr (StripConfig *scfg, ...)
 	case STRIPCONFIG_TIME_REFRESH_INTERVAL:
 	  *(va_arg (ap, double *)) = scfg->Time.refresh_interval;
 	  break;
+	case STRIPCONFIG_TIME_LEGEND_INTERVAL:
+	  *(va_arg (ap, double *)) = scfg->Time.legend_interval;
+	  break;
 	case STRIPCONFIG_COLOR_BACKGROUND:
 	  *(va_arg (ap, cColor **)) = &scfg->Color.background;
 	  break;
@@ -710,35 +697,9 @@ int     StripConfig_getattr (StripConfig *scfg, ...)
 	case STRIPCONFIG_COLOR_GRID:
 	  *(va_arg (ap, cColor **)) = &scfg->Color.grid;
 	  break;
-	case STRIPCONFIG_COLOR_COLOR1:
-	  *(va_arg (ap, cColor **)) = &scfg->Color.color[0];
-	  break;
-	case STRIPCONFIG_COLOR_COLOR2:
-	  *(va_arg (ap, cColor **)) = &scfg->Color.color[1];
-	  break;
-	case STRIPCONFIG_COLOR_COLOR3:
-	  *(va_arg (ap, cColor **)) = &scfg->Color.color[2];
-	  break;
-	case STRIPCONFIG_COLOR_COLOR4:
-	  *(va_arg (ap, cColor **)) = &scfg->Color.color[3];
-	  break;
-	case STRIPCONFIG_COLOR_COLOR5:
-	  *(va_arg (ap, cColor **)) = &scfg->Color.color[4];
-	  break;
-	case STRIPCONFIG_COLOR_COLOR6:
-	  *(va_arg (ap, cColor **)) = &scfg->Color.color[5];
-	  break;
-	case STRIPCONFIG_COLOR_COLOR7:
-	  *(va_arg (ap, cColor **)) = &scfg->Color.color[6];
-	  break;
-	case STRIPCONFIG_COLOR_COLOR8:
-	  *(va_arg (ap, cColor **)) = &scfg->Color.color[7];
-	  break;
-	case STRIPCONFIG_COLOR_COLOR9:
-	  *(va_arg (ap, cColor **)) = &scfg->Color.color[8];
-	  break;
-	case STRIPCONFIG_COLOR_COLOR10:
-	  *(va_arg (ap, cColor **)) = &scfg->Color.color[9];
+	case STRIPCONFIG_COLOR_COLOR1:          /* ... COLORN */
+	  *(va_arg (ap, cColor **)) =
+	    &scfg->Color.color[attrib - STRIPCONFIG_COLOR_COLOR1];
 	  break;
 	case STRIPCONFIG_OPTION_GRID_XON:
 	  *(va_arg (ap, int *)) = scfg->Option.grid_xon;
@@ -817,6 +778,9 @@ int     StripConfig_write       (StripConfig            *scfg,
 	  case SCFGMASK_TIME_REFRESH_INTERVAL:
 	    fprintf (f, "%s%f\n", fbuf, scfg->Time.refresh_interval);
 	    break;
+	  case SCFGMASK_TIME_LEGEND_INTERVAL:
+	    fprintf (f, "%s%f\n", fbuf, scfg->Time.legend_interval);
+	    break;
         }
       }
 
@@ -949,6 +913,13 @@ int     StripConfig_write       (StripConfig            *scfg,
 		    LEFT_COLUMNWIDTH, fbuf,
 		    scfg->Curves.Detail[j].plotstat);
 		break;
+	    case SCFGMASK_CURVE_MONITOR:
+		if (scfg->Curves.Detail[j].monitor)
+		  fprintf
+		    (f, "%-*s%d\n",
+			LEFT_COLUMNWIDTH, fbuf,
+			scfg->Curves.Detail[j].monitor);
+		break;
           }
         }
       }
@@ -1051,11 +1022,11 @@ int     StripConfig_load        (StripConfig            *scfg,
     {
     case TIME:
 	token_min = TIMESPAN;
-	token_max = REFRESH_INTERVAL;
+	token_max = LEGEND_INTERVAL;
 	break;
     case COLOR:
 	token_min = BACKGROUND;
-	token_max = COLOR10;
+	token_max = COLORN;
 	break;
     case OPTION:
 	token_min = GRID_XON;
@@ -1063,11 +1034,11 @@ int     StripConfig_load        (StripConfig            *scfg,
 	break;
     case CURVE:
 	token_min = NAME;
-	token_max = PLOTSTAT;
+	token_max = MONITOR;
 	/* must read the curve index */
 	if ((ret = ((p = strtok (NULL, SCFTokenStr[SEPARATOR])) != NULL)))
 	  if ((ret = sscanf (p, "%d", &curve_idx) == 1))
-	    ret = (curve_idx >= 0) && (curve_idx <= STRIP_MAX_CURVES);
+	    ret = (curve_idx >= 0) && (curve_idx < STRIP_MAX_CURVES);
 	if (!ret) {
 	  fprintf (stderr, "StripConfig_load: bad curve index, \"%s\"\n", p);
 	  fprintf (stderr, "==> %s\n", ebuf);
@@ -1099,7 +1070,7 @@ int     StripConfig_load        (StripConfig            *scfg,
     if (!StripConfigMask_stat (&mask, SCFGMASK_FIRST_ELEMENT + token))
       continue;
       
-    switch (token)
+    switch (COLOR_CASE (token, COLOR1, COLORN))
     {
     case TIMESPAN:
 	if ((ret = (sscanf (pval, "%ud", &tmp.u) == 1)))
@@ -1124,19 +1095,16 @@ int     StripConfig_load        (StripConfig            *scfg,
 	    (clone, STRIPCONFIG_TIME_REFRESH_INTERVAL, tmp.d, 0);
 	break;
           
+    case LEGEND_INTERVAL:
+	if ((ret = (sscanf (pval, "%lf", &tmp.d) == 1)))
+	  StripConfig_setattr
+	    (clone, STRIPCONFIG_TIME_LEGEND_INTERVAL, tmp.d, 0);
+	break;
+          
     case BACKGROUND:
     case FOREGROUND:
     case GRID:
-    case COLOR1:
-    case COLOR2:
-    case COLOR3:
-    case COLOR4:
-    case COLOR5:
-    case COLOR6:
-    case COLOR7:
-    case COLOR8:
-    case COLOR9:
-    case COLOR10:
+    case COLOR1:                        /* ... COLORN */
 	StripConfig_getattr
 	  (clone, (StripConfigAttribute)token+1, &pcolor, 0);
 	ret =
@@ -1231,6 +1199,12 @@ int     StripConfig_load        (StripConfig            *scfg,
 	  (sscanf (pval, "%d", &clone->Curves.Detail[curve_idx].plotstat)
 	    == 1);
 	break;
+
+    case MONITOR:
+	ret =
+	  (sscanf (pval, "%d", &clone->Curves.Detail[curve_idx].monitor)
+	    == 1);
+	break;
           
     default:
 	fprintf
@@ -1282,7 +1256,7 @@ int     StripConfig_load        (StripConfig            *scfg,
     }
 
     /* update colors if necessary */
-    if (!old &&
+    if (!old && scfg->scm &&
 	StripConfigMask_intersect (&SCFGMASK_COLOR, &mask) &&
 	StripConfigMask_intersect
 	(&SCFGMASK_COLOR, &clone->UpdateInfo.update_mask))
@@ -1290,7 +1264,7 @@ int     StripConfig_load        (StripConfig            *scfg,
       cColorManager_build_palette (scfg->scm, 0, CCM_MAX_PALETTE_SIZE);
 
       for (i = STRIPCONFIG_COLOR_BACKGROUND;
-           i <= STRIPCONFIG_COLOR_COLOR10;
+           i <= STRIPCONFIG_COLOR_COLORN;
            i++)
       {
         StripConfig_getattr (scfg, (StripConfigAttribute)i, &pcolor, 0);
@@ -1551,6 +1525,7 @@ void    StripConfig_reset_details       (StripConfig *scfg,
   detail->max           = STRIPDEF_CURVE_MAX;
   detail->scale         = STRIPDEF_CURVE_SCALE;
   detail->plotstat      = STRIPDEF_CURVE_PLOTSTAT;
+  detail->monitor       = STRIPDEF_CURVE_MONITOR;
   detail->id            = STRIPDEF_CURVE_ID;
   
   StripConfigMask_clear (&detail->update_mask);
@@ -63,9 +63,11 @@ StripGridVisibility;
 #define STRIPDEF_TIME_NUM_SAMPLES       7200
 #define STRIPDEF_TIME_SAMPLE_INTERVAL   1
 #define STRIPDEF_TIME_REFRESH_INTERVAL  1
+#define STRIPDEF_TIME_LEGEND_INTERVAL   0.5
 #define STRIPDEF_COLOR_BACKGROUND_STR   "White"
 #define STRIPDEF_COLOR_FOREGROUND_STR   "Black"
 #define STRIPDEF_COLOR_GRID_STR         "Grey75"
+/* the curve colors, repeated for curves after the tenth */
 #define STRIPDEF_COLOR_COLOR1_STR       "Blue"
 #define STRIPDEF_COLOR_COLOR2_STR       "OliveDrab"
 #define STRIPDEF_COLOR_COLOR3_STR       "Brown"
@@ -88,6 +90,7 @@ StripGridVisibility;
 #define STRIPDEF_CURVE_MAX              1e+7
 #define STRIPDEF_CURVE_SCALE            STRIPSCALE_LINEAR
 #define STRIPDEF_CURVE_PLOTSTAT         STRIPCURVE_PLOTTED
+#define STRIPDEF_CURVE_MONITOR          0
 #define STRIPDEF_CURVE_ID               NULL
 
 /* ====== Min/Max values for all attributes requiring range checking ====== */
@@ -99,6 +102,8 @@ StripGridVisibility;
 #define STRIPMAX_TIME_SAMPLE_INTERVAL   DBL_MAX
 #define STRIPMIN_TIME_REFRESH_INTERVAL  0.1
 #define STRIPMAX_TIME_REFRESH_INTERVAL  DBL_MAX
+#define STRIPMIN_TIME_LEGEND_INTERVAL   0
+#define STRIPMAX_TIME_LEGEND_INTERVAL   DBL_MAX
 #define STRIPMIN_OPTION_GRID_XON        STRIPGRID_NONE
 #define STRIPMAX_OPTION_GRID_XON        STRIPGRID_ALL
 #define STRIPMIN_OPTION_GRID_YON        STRIPGRID_NONE
@@ -124,19 +129,13 @@ typedef enum    _StripConfigAttributeEnum
   STRIPCONFIG_TIME_NUM_SAMPLES,         /* (int)                        rw */
   STRIPCONFIG_TIME_SAMPLE_INTERVAL,     /* (double)                     rw */
   STRIPCONFIG_TIME_REFRESH_INTERVAL,    /* (double)                     rw */
+  STRIPCONFIG_TIME_LEGEND_INTERVAL,     /* (double)                     rw */
   STRIPCONFIG_COLOR_BACKGROUND,         /* (cColor *)                   r  */
   STRIPCONFIG_COLOR_FOREGROUND,         /* (cColor *)                   r  */
   STRIPCONFIG_COLOR_GRID,               /* (cColor *)                   r  */
   STRIPCONFIG_COLOR_COLOR1,             /* (cColor *)                   r  */
-  STRIPCONFIG_COLOR_COLOR2,             /* (cColor *)                   r  */
-  STRIPCONFIG_COLOR_COLOR3,             /* (cColor *)                   r  */
-  STRIPCONFIG_COLOR_COLOR4,             /* (cColor *)                   r  */
-  STRIPCONFIG_COLOR_COLOR5,             /* (cColor *)                   r  */
-  STRIPCONFIG_COLOR_COLOR6,             /* (cColor *)                   r  */
-  STRIPCONFIG_COLOR_COLOR7,             /* (cColor *)                   r  */
-  STRIPCONFIG_COLOR_COLOR8,             /* (cColor *)                   r  */
-  STRIPCONFIG_COLOR_COLOR9,             /* (cColor *)                   r  */
-  STRIPCONFIG_COLOR_COLOR10,            /* (cColor *)                   r  */
+  STRIPCONFIG_COLOR_COLORN =            /* (cColor *), one per curve    r  */
+  STRIPCONFIG_COLOR_COLOR1 + STRIP_MAX_CURVES - 1,
   STRIPCONFIG_OPTION_GRID_XON,          /* (int)                        rw */
   STRIPCONFIG_OPTION_GRID_YON,          /* (int)                        rw */
   STRIPCONFIG_OPTION_AXIS_YCOLORSTAT,   /* (int)                        rw */
@@ -170,21 +169,14 @@ typedef enum    _StripConfigMaskElementEnum
   SCFGMASK_TIME_NUM_SAMPLES             = STRIPCONFIG_TIME_NUM_SAMPLES,
   SCFGMASK_TIME_SAMPLE_INTERVAL         = STRIPCONFIG_TIME_SAMPLE_INTERVAL,
   SCFGMASK_TIME_REFRESH_INTERVAL        = STRIPCONFIG_TIME_REFRESH_INTERVAL,
+  SCFGMASK_TIME_LEGEND_INTERVAL         = STRIPCONFIG_TIME_LEGEND_INTERVAL,
 
   /* color */
   SCFGMASK_COLOR_BACKGROUND             = STRIPCONFIG_COLOR_BACKGROUND,
   SCFGMASK_COLOR_FOREGROUND             = STRIPCONFIG_COLOR_FOREGROUND,
   SCFGMASK_COLOR_GRID                   = STRIPCONFIG_COLOR_GRID,
   SCFGMASK_COLOR_COLOR1                 = STRIPCONFIG_COLOR_COLOR1,
-  SCFGMASK_COLOR_COLOR2                 = STRIPCONFIG_COLOR_COLOR2,
-  SCFGMASK_COLOR_COLOR3                 = STRIPCONFIG_COLOR_COLOR3,
-  SCFGMASK_COLOR_COLOR4                 = STRIPCONFIG_COLOR_COLOR4,
-  SCFGMASK_COLOR_COLOR5                 = STRIPCONFIG_COLOR_COLOR5,
-  SCFGMASK_COLOR_COLOR6                 = STRIPCONFIG_COLOR_COLOR6,
-  SCFGMASK_COLOR_COLOR7                 = STRIPCONFIG_COLOR_COLOR7,
-  SCFGMASK_COLOR_COLOR8                 = STRIPCONFIG_COLOR_COLOR8,
-  SCFGMASK_COLOR_COLOR9                 = STRIPCONFIG_COLOR_COLOR9,
-  SCFGMASK_COLOR_COLOR10                = STRIPCONFIG_COLOR_COLOR10,
+  SCFGMASK_COLOR_COLORN                 = STRIPCONFIG_COLOR_COLORN,
 
   /* options */
   SCFGMASK_OPTION_GRID_XON              = STRIPCONFIG_OPTION_GRID_XON,
@@ -201,6 +193,7 @@ typedef enum    _StripConfigMaskElementEnum
   SCFGMASK_CURVE_MAX,
   SCFGMASK_CURVE_SCALE,
   SCFGMASK_CURVE_PLOTSTAT,
+  SCFGMASK_CURVE_MONITOR,
 
   SCFGMASK_TERMINATOR
 }
@@ -321,6 +314,7 @@ typedef struct _StripCurveDetail
   double                min, max;
   int                   scale;
   int                   plotstat;
+  int                   monitor;        /* record every value update? */
   short                 valid;
   cColor                *color;
   void                  *id;
@@ -345,6 +339,8 @@ typedef struct _StripConfig
     int                         num_samples;
     double                      sample_interval;
     double                      refresh_interval;
+    double                      legend_interval;        /* min between
+                                                           legend values */
   } Time;
 
   struct _Color {
@@ -395,6 +391,9 @@ void    StripConfig_preinit     (void);
  *      with default values.  Then reads config info from the specified
  *      stdio stream, if it's not null.  See StripConfig_load() below for
  *      specifics on how the file is read.
+ *
+ *      The color manager and visual may both be null when there is no
+ *      display (batch mode), in which case no colors are allocated.
  */
 #ifndef NO_X11_HERE /* Albert */ 
 StripConfig     *StripConfig_init       (cColorManager,
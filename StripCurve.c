@@ -25,6 +25,7 @@ StripCurve      StripCurve_init (StripConfig *scfg)
     sc->details                 = 0;
     sc->func_data               = 0;
     sc->get_value               = 0;
+    sc->get_events              = 0;
     sc->status                  = 0;
   }
 
@@ -136,6 +137,14 @@ int             StripCurve_setattr      (StripCurve the_sc, ...)
 	    (&sc->scfg->UpdateInfo.update_mask, SCFGMASK_CURVE_PLOTSTAT);
 	  break;
 	  
+	case STRIPCURVE_MONITOR:
+	  sc->details->monitor = va_arg (ap, int);
+	  StripConfigMask_set
+	    (&sc->details->update_mask, SCFGMASK_CURVE_MONITOR);
+	  StripConfigMask_set
+	    (&sc->scfg->UpdateInfo.update_mask, SCFGMASK_CURVE_MONITOR);
+	  break;
+	  
 	case STRIPCURVE_COLOR:
 	  sc->details->color = va_arg (ap, cColor *);
 	  break;
@@ -148,6 +157,10 @@ int             StripCurve_setattr      (StripCurve the_sc, ...)
 	  sc->get_value = va_arg (ap, StripCurveSampleFunc);
 	  break;
 	  
+	case STRIPCURVE_EVENTFUNC:
+	  sc->get_events = va_arg (ap, StripCurveEventFunc);
+	  break;
+	  
       }
     }
     else break;
@@ -201,6 +214,9 @@ int             StripCurve_getattr      (StripCurve the_sc, ...)
 	case STRIPCURVE_PLOTSTAT:
 	  *(va_arg (ap, int *)) = sc->details->plotstat;
 	  break;
+	case STRIPCURVE_MONITOR:
+	  *(va_arg (ap, int *)) = sc->details->monitor;
+	  break;
 	case STRIPCURVE_COLOR:
 	  *(va_arg (ap, cColor **)) = sc->details->color;
 	  break;
@@ -210,6 +226,9 @@ int             StripCurve_getattr      (StripCurve the_sc, ...)
 	case STRIPCURVE_SAMPLEFUNC:
 	  *(va_arg (ap, StripCurveSampleFunc *)) = sc->get_value;
 	  break;
+	case STRIPCURVE_EVENTFUNC:
+	  *(va_arg (ap, StripCurveEventFunc *)) = sc->get_events;
+	  break;
       }
     else break;
   }
@@ -251,12 +270,16 @@ void    *StripCurve_getattr_val (StripCurve the_sc, StripCurveAttribute attrib)
     return (void *)&sc->details->scale;
   case STRIPCURVE_PLOTSTAT:
     return (void *)&sc->details->plotstat;
+  case STRIPCURVE_MONITOR:
+    return (void *)&sc->details->monitor;
   case STRIPCURVE_COLOR:
     return (void *)sc->details->color;
   case STRIPCURVE_FUNCDATA:
     return (void *)sc->func_data;
   case STRIPCURVE_SAMPLEFUNC:
     return (void *)sc->get_value;
+  case STRIPCURVE_EVENTFUNC:
+    return (void *)sc->get_events;
   default:
     return NULL;
   }
@@ -42,6 +42,17 @@ typedef void *          StripCurve;
 
 typedef double          (*StripCurveSampleFunc)         (void *);
 
+/* StripCurveEventFunc
+ *
+ *      Copies up to n of the value updates received since the last call,
+ *      oldest first, with their time stamps, and returns how many were
+ *      copied.  Only used for curves in monitor mode.
+ */
+typedef int             (*StripCurveEventFunc)          (void *,
+                                                         struct timeval *,
+                                                         double *,
+                                                         int);
+
 /* ======= Attributes ======= */
 typedef enum
 {
@@ -58,6 +69,8 @@ typedef enum
   STRIPCURVE_COLOR,             /* (cColor *)                           r  */
   STRIPCURVE_FUNCDATA,          /* (void *)                             rw */
   STRIPCURVE_SAMPLEFUNC,        /* (StripCurveSampleFunc)               rw */
+  STRIPCURVE_MONITOR,           /* (int)   record every update?         rw */
+  STRIPCURVE_EVENTFUNC,         /* (StripCurveEventFunc)                rw */
   STRIPCURVE_LAST_ATTRIBUTE
 }
 StripCurveAttribute;
@@ -144,6 +157,7 @@ typedef struct
   struct timeval        connect_request;
   void                  *func_data;
   StripCurveSampleFunc  get_value;      /* must pass func_data when calling */
+  StripCurveEventFunc   get_events;     /* ditto, NULL if not supported */
   unsigned              status;
 }
 StripCurveInfo;
@@ -17,8 +17,9 @@
  *          buffer.
  *      (2) passes off requests for older data to the archive
  *          service.
- *      (3) on a per-curve basis, renders data into XSegments,
- *          given the appropriate transformation parameters.
+ *      (3) on a per-curve basis, renders data into line segments
+ *          (sdsSegment, which needs no X), given the appropriate
+ *          transformation parameters.
  *
  *      So, how does it work?  Basically, the user must first
  *      call init_range() in order to specify what data will
@@ -36,7 +37,7 @@
  *      is outstanding.
  *
  *      Once the range has been initialized, render() may be
- *      called to generate XSegment structures describing the
+ *      called to generate sdsSegment structures describing the
  *      rasterized data on the time range.  If only new data
  *      is requested, then all data greater than the global
  *      start time and less than the already-rendered start
@@ -59,7 +60,25 @@
  *      of a backward direction, or "after" in the case of a forward
  *      direction).  The caller may also specify connecting endpoints
  *      to which the generated line segments must be attached.
- */     
+ *
+ *      For long ring buffers, each curve also keeps a pyramid of
+ *      min/max summaries over fixed blocks of samples, updated as
+ *      each sample is stored.  When a complete refresh covers many
+ *      more samples than there are bins, render() walks the largest
+ *      blocks which fall within a single bin, feeding segmentify()
+ *      only the extreme points of each block, plus the first and last
+ *      point of each bin.  This draws the same pixels as the raw data,
+ *      but the cost of a refresh depends on the plot width rather than
+ *      on the number of samples in the buffer.
+ *
+ *      Built with STRIP_SAMPLE_STORE, samples are not lost when the ring
+ *      buffer overwrites them, but go into a compressed store per curve
+ *      (see SampleBlock), which is decoded for the part of the range
+ *      before the ring buffer, a block at a time, keeping the blocks
+ *      already decoded for the range before.  Autoscaling and dumps read
+ *      it too.  The ring buffer stays as it is, so it is still where new
+ *      samples are appended and most of the plot comes from.
+ */
 
 #define DEBUG1 0
 #define DEBUG_SDS_TIMES 0
@@ -74,11 +93,23 @@
 #include "StripMisc.h"
 #include "StripGraph.h" /* Albert */
 
+#ifndef NO_X11_HERE
 #include <X11/cursorfont.h>
 extern Widget history_topShell;
+static Cursor cursor = 0; 
+#endif
 extern int auto_scaleTriger;
 extern long radioChange;
-static Cursor cursor = 0; 
+#ifdef USE_CAR
+extern long radioBoxAlgorithm;
+#endif
+
+#ifdef STRIP_ASYNC_HISTORY
+#include <pthread.h>
+#ifndef STRIP_HISTORY_THREADS
+#define STRIP_HISTORY_THREADS   4
+#endif
+#endif
 
 
 #ifndef SIZE_MAX
@@ -93,11 +124,95 @@ static Cursor cursor = 0;
 #define SDS_DUMP_FIELDWIDTH     33 /* Albert -- was 30 */
 #define SDS_DUMP_NUMWIDTH       23 /* Albert -- was 20 */
 #define SDS_DUMP_BADVALUESTR    "BadVal"
+#define SDS_DUMP_NOVALUESTR     "N/A"
+#define SDS_DUMP_BUFSIZE        8192
+
+/* history holding more points per bin than this is reduced */
+#define SDS_REDUCE_RATIO        8
+
+/* history is dumped this many seconds at a time */
+#ifndef SDS_DUMP_CHUNK
+#  define SDS_DUMP_CHUNK        3600
+#endif
+
+/* rows an SDDS dump table is lengthened by when full */
+#define SDS_DUMP_SDDS_ROWS      4096
 
 #define SDS_BUFFERED_DATA       (1 << 0)
 #define SDS_HISTORY_DATA        (1 << 1)
 #define SDS_BOTH_DATA           (SDS_BUFFERED_DATA | SDS_HISTORY_DATA)
 
+/* initial size of the curve table, which doubles as needed */
+#define SDS_CURVES_INCREMENT    16
+
+/* number of points segmentify() transforms at a time */
+#define SDS_SEGMENTIFY_CHUNK    256
+
+/* min/max summary pyramid: block size of the finest level, and the
+ * minimum number of blocks per bin the coarsest level used for
+ * rendering must provide */
+#define SDS_MM_BASE             8
+#define SDS_MM_BLOCKS_PER_BIN   2
+#define SDS_MM_BLOCK(k)         ((size_t)SDS_MM_BASE << (k))
+#define SDS_MM_NBLOCKS(n,k)     (((n) + SDS_MM_BLOCK(k) - 1) / SDS_MM_BLOCK(k))
+
+/* monitor time lines: initial ring size, which doubles as needed, and
+ * the number of updates collected from the curve at a time */
+#define SDS_MONITOR_INCREMENT   64
+#define SDS_MONITOR_CHUNK       64
+#define SDS_MONITORED(cd)       ((cd)->m_count > 0)
+#define SDS_MONITOR_OLDEST(cd) \
+((cd)->m_cur + (cd)->m_size + 1 - (cd)->m_count) % (cd)->m_size
+
+#ifdef STRIP_SAMPLE_STORE
+/* compressed sample store: memory per curve, bytes of encoded samples
+ * per block, and the most bits one sample can take (see store_append) */
+#ifndef STRIP_SAMPLE_STORE_KBYTES
+#  define STRIP_SAMPLE_STORE_KBYTES     4096
+#endif
+#define SDS_STORE_BLOCK_BYTES   4096
+#define SDS_STORE_MAX_SAMPLE_BITS       168
+#define SDS_STORE_MAX_BLOCKS \
+((STRIP_SAMPLE_STORE_KBYTES * (size_t)1024) / sizeof (SampleBlock))
+
+#if defined(_MSC_VER) && (_MSC_VER < 1300)
+typedef unsigned __int64        StoreWord;
+#else
+typedef unsigned long long      StoreWord;
+#endif
+
+/* SampleBlock
+ *
+ *      The first sample of a block is kept as is, and every following
+ *      one as bits in the manner of Facebook's Gorilla: the time as the
+ *      change in the interval from the one before (in microseconds, to
+ *      which sample times are precise), the value as its XOR with the
+ *      one before, and the status only when it changes.  The encoder's
+ *      state after the last sample is kept so that samples can be added,
+ *      and so is the decoder's after the last sample decoded, so that
+ *      the samples added since can be decoded on their own.
+ */
+typedef struct          _SampleBlock
+{
+  struct _SampleBlock   *next;          /* next newer block */
+  sdsTime               t0, t1;         /* first and last sample */
+  double                v0;
+  StatusType            s0;
+  size_t                n;              /* samples */
+  size_t                n_bits;         /* used in bits */
+  sdsTime               last_us, last_delta;
+  StoreWord             last_v;
+  int                   lead, trail;    /* significant bits of last XOR */
+  StatusType            last_s;
+  size_t                dec_n, dec_pos; /* decoded samples, bits */
+  sdsTime               dec_us, dec_delta;
+  StoreWord             dec_w;
+  int                   dec_lead, dec_trail;
+  StatusType            dec_s;
+  unsigned char         bits[SDS_STORE_BLOCK_BYTES];
+} SampleBlock;
+#endif
+
 
 #define DUMP_SDDS_TIME_COL           "Time"
 #define DUMP_SDDS_TIME_COL_UNITS     "seconds"
@@ -106,11 +221,57 @@ static Cursor cursor = 0;
 
 static RenderBuffer     render_buffer = {0, 0, 0};
 
+char *sdsReductionString[SDS_REDUCE_LAST] =
+{
+  "Min/Max per pixel",
+  "Average",
+  "Sharp (last value)",
+  "Raw data",
+  "Largest triangle (LTTB)"
+};
+
+/* reduced copies of the data handed to segmentify() */
+typedef struct          _PointBuffer
+{
+  sdsTime               *times;
+  double                *val;
+  StatusType            *stat;
+  size_t                max_points;
+} PointBuffer;
+
+/* decimated ring buffer points, built from the min/max summaries */
+static PointBuffer      decimate_buffer = {0, 0, 0, 0};
+
+/* first, min, max and last points per bin, for SDS_REFRESH_M4 */
+static PointBuffer      m4_buffer = {0, 0, 0, 0};
+
+/* monitor time line points on the current range, unwrapped */
+static PointBuffer      monitor_buffer = {0, 0, 0, 0};
+
+/* a curve's history within a dump_table() chunk, and the next point of it
+ * to write out */
+typedef struct          _DumpSource
+{
+  sdsTime               *times;
+  double                *val;
+  size_t                n, pos;
+} DumpSource;
+
+/* the SDDS table dump_table() fills in, rather than writing text */
+typedef struct          _DumpSDDS DumpSDDS;
+#ifdef USE_SDDS
+struct                  _DumpSDDS
+{
+  SDDS_TABLE            table;
+  long                  row, n_rows;    /* next row, rows allocated */
+};
+#endif
+
 /* These are used as parameter types for segmentify() */
 typedef struct          _TimeBuffer
 {
-  struct timeval        *base;
-  struct timeval        *ptr;
+  sdsTime               *base;
+  sdsTime               *ptr;
   size_t                count;
 } TimeBuffer;
 
@@ -141,7 +302,7 @@ static size_t   segmentify      (StripDataSourceInfo *,
   ValueBuffer *,
   StatusBuffer *,
   int,
-  struct timeval *,
+  sdsTime,
   DataPoint *,
   DataPoint *,
   DataPoint *,
@@ -156,8 +317,8 @@ static int      resize          (StripDataSourceInfo    *sds,
 
 
 
-static long     find_date_idx   (struct timeval         *t,
-  struct timeval         *times,
+static long     find_date_idx   (sdsTime                t,
+  sdsTime                *times,
   size_t                 n_times,
   size_t                 max_times,
   size_t                 idx_latest,
@@ -169,8 +330,76 @@ static int      pack_array      (void **, size_t,
 
 static int      verify_render_buffer    (RenderBuffer   *, int);
 
-static int printData(struct timeval *t,CurveData *c,char *v); /*Albert */
-static int findNextTime(struct timeval *tv,struct timeval *res,StripDataSourceInfo *s) ; /*Albert */
+static FetchStatus      fetch_history   (StripDataSourceInfo *, CurveData *,
+                                         struct timeval *, struct timeval *,
+                                         StripHistoryCallback);
+static FetchStatus      convert_history (CurveData *);
+static void             history_arrived (StripHistoryResult *, void *);
+static void             history_joined  (StripHistoryResult *, void *);
+static void             prefetch_arrived(StripHistoryResult *, void *);
+
+static int      mm_build        (StripDataSourceInfo *, CurveData *);
+static void     mm_free         (CurveData *);
+static void     mm_update       (StripDataSourceInfo *, CurveData *, size_t);
+static int      mm_level        (CurveData *, int, int);
+static void     mm_extrema      (StripDataSourceInfo *, CurveData *,
+                                 size_t, size_t, size_t *, size_t *);
+static int      verify_point_buffer     (PointBuffer *, size_t);
+static void     use_point_buffer        (PointBuffer *, size_t,
+                                         TimeBuffer *,
+                                         ValueBuffer *,
+                                         StatusBuffer *);
+static size_t   m4_reduce       (StripDataSourceInfo *,
+                                 TimeBuffer *,
+                                 ValueBuffer *,
+                                 StatusBuffer *,
+                                 int,
+                                 sdsTime);
+static size_t   mm_decimate     (StripDataSourceInfo *, CurveData *, int, int);
+
+static void     monitor_sample  (StripDataSourceInfo *, CurveData *,
+                                 sdsTime, double);
+static void     monitor_event   (StripDataSourceInfo *, CurveData *,
+                                 sdsTime, double);
+static int      monitor_push    (StripDataSourceInfo *, CurveData *,
+                                 sdsTime, double, StatusType);
+static int      monitor_find    (CurveData *, sdsTime, sdsTime,
+                                 long *, long *);
+static size_t   monitor_range   (StripDataSourceInfo *, CurveData *);
+static void     monitor_free    (CurveData *);
+
+static void     reduce_curves   (StripDataSourceInfo *, double, int);
+static int      reduce_history  (CurveData *, sdsTime, int);
+static void     reduce_free     (CurveData *);
+#ifdef STRIP_ASYNC_HISTORY
+static void     *reduce_thread  (void *);
+#endif
+
+#ifdef STRIP_SAMPLE_STORE
+static void     store_spill     (StripDataSourceInfo *, size_t);
+static void     store_append    (CurveData *, sdsTime, double, StatusType);
+static void     store_put       (SampleBlock *, StoreWord, int);
+static StoreWord store_get      (SampleBlock *, size_t *, int);
+static int      store_grow      (CurveData *, size_t);
+static size_t   store_decode    (CurveData *, SampleBlock *, size_t, int);
+static int      store_history   (CurveData *);
+static int      store_range     (CurveData *, sdsTime, sdsTime,
+                                 long *, long *);
+static void     store_free      (CurveData *);
+#endif
+
+static void     busy_cursor     (int);
+
+static int      dump_table      (StripDataSourceInfo *, FILE *,
+                                 struct timeval *, struct timeval *, int,
+                                 DumpSDDS *);
+#ifdef USE_SDDS
+static void     dump_sdds_layout        (StripDataSourceInfo *, SDDS_TABLE *,
+                                         char *);
+static void     dump_sdds_time          (DumpSDDS *, sdsTime);
+static void     dump_sdds_value         (DumpSDDS *, CurveData *, double);
+#endif
+static char     *dump_time      (char *, sdsTime, time_t *, char *, size_t *);
 
 /*
  * StripDataSource_init
@@ -195,9 +424,13 @@ StripDataSource_init    (StripHistory history)
     sds->idx_t1         = 0;
     sds->bin_size       = 0;
     sds->n_bins         = 0;
+    sds->history_func   = 0;
+    sds->history_data   = 0;
 
-    /* clear the buffers */
-    memset (sds->buffers, 0, STRIP_MAX_CURVES * sizeof(CurveData));
+    /* no curves yet */
+    sds->curves         = 0;
+    sds->n_curves       = 0;
+    sds->max_curves     = 0;
   }
 
   return sds;
@@ -214,14 +447,31 @@ StripDataSource_delete  (StripDataSource the_sds)
   StripDataSourceInfo   *sds = (StripDataSourceInfo *)the_sds;
   int                   i;
 
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
+  for (i = 0; i < sds->n_curves; i++)
   {
-    if (sds->buffers[i].val)
-      free (sds->buffers[i].val);
-    if (sds->buffers[i].stat)
-      free (sds->buffers[i].stat);
+    /* nothing must be delivered here any more */
+    StripHistory_cancel (sds->history, &sds->curves[i]->history);
+    StripHistory_cancel (sds->history, &sds->curves[i]->prefetch);
+    if (sds->curves[i]->val)
+      free (sds->curves[i]->val);
+    if (sds->curves[i]->stat)
+      free (sds->curves[i]->stat);
+    if (sds->curves[i]->htimes)
+      free (sds->curves[i]->htimes);
+    reduce_free (sds->curves[i]);
+#ifdef STRIP_SAMPLE_STORE
+    store_free (sds->curves[i]);
+#endif
+    mm_free (sds->curves[i]);
+    monitor_free (sds->curves[i]);
+    free (sds->curves[i]);
   }
 
+  if (sds->curves)
+    free (sds->curves);
+  if (sds->times)
+    free (sds->times);
+
   free (sds);
 }
 
@@ -260,6 +510,14 @@ StripDataSource_setattr (StripDataSource the_sds, ...)
 	    sds->buf_size);
 #endif
 	  break;
+
+	case SDS_HISTORY_CB_FUNC:
+	  sds->history_func = va_arg (ap, sdsCallback);
+	  break;
+
+	case SDS_HISTORY_CB_DATA:
+	  sds->history_data = va_arg (ap, void *);
+	  break;
       }
   }
 
@@ -297,7 +555,15 @@ StripDataSource_getattr (StripDataSource the_sds, ...)
 	case SDS_BEGIN_TIME:
 	  if (sds->count == sds->buf_size) index = (sds->cur_idx + 1) % sds->buf_size; 
 	  else index = 1;
-	  *(va_arg (ap, struct timeval *)) = sds->times[index];
+	  sds2time (va_arg (ap, struct timeval *), sds->times[index]);
+	  break;
+
+	case SDS_HISTORY_CB_FUNC:
+	  *(va_arg (ap, sdsCallback *)) = sds->history_func;
+	  break;
+
+	case SDS_HISTORY_CB_DATA:
+	  *(va_arg (ap, void **)) = sds->history_data;
 	  break;
 
       }
@@ -317,38 +583,48 @@ StripDataSource_addcurve        (StripDataSource        the_sds,
   StripCurve             the_curve)
 {
   StripDataSourceInfo   *sds = (StripDataSourceInfo *)the_sds;
-  int                   i;
-  int                   ret = 0;
+  CurveData             *cd, **p;
+  int                   n;
   
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
-    if (!sds->buffers[i].curve)         /* it's available */
-      break;
+  /* make room in the table, doubling its size as needed */
+  if (sds->n_curves >= sds->max_curves)
+  {
+    n = sds->max_curves? 2 * sds->max_curves : SDS_CURVES_INCREMENT;
+    p = (CurveData **)realloc (sds->curves, n * sizeof (CurveData *));
+    if (!p) return 0;
+    sds->curves = p;
+    sds->max_curves = n;
+  }
 
-  if (i < STRIP_MAX_CURVES)
+  if (!(cd = (CurveData *)calloc (1, sizeof (CurveData))))
+    return 0;
+  
+  cd->first = SIZE_MAX;
+  cd->val = (double *)malloc (sds->buf_size * sizeof (double));
+  cd->stat = (StatusType *)calloc (sds->buf_size, sizeof (StatusType));
+  if (!cd->val || !cd->stat)
   {
-    sds->buffers[i].first = SIZE_MAX;
-    sds->buffers[i].val = (double *)malloc (sds->buf_size * sizeof (double));
-    sds->buffers[i].stat = (StatusType *)calloc
-      (sds->buf_size, sizeof (StatusType));
-    if (sds->buffers[i].val && sds->buffers[i].stat)
-    {
-      sds->buffers[i].curve = (StripCurveInfo *)the_curve;
-      memset (sds->buffers[i].endpoints, 0, 2*sizeof(DataPoint));
-      
-      /* use the id field of the strip curve to reference the buffer */
-      ((StripCurveInfo *)the_curve)->id = &sds->buffers[i];
-	
-      sds->buffers[i].history.fetch_stat = FETCH_IDLE;
-      ret = 1;
-    }
-    else
-    {
-      if (sds->buffers[i].val) free (sds->buffers[i].val);
-      if (sds->buffers[i].stat) free (sds->buffers[i].stat);
-    }
+    if (cd->val) free (cd->val);
+    if (cd->stat) free (cd->stat);
+    free (cd);
+    return 0;
   }
   
-  return ret;
+  cd->curve = (StripCurveInfo *)the_curve;
+      
+  /* use the id field of the strip curve to reference the buffer */
+  ((StripCurveInfo *)the_curve)->id = cd;
+
+  /* without the summaries, render() just falls back to raw data */
+  mm_build (sds, cd);
+	
+  cd->history.fetch_stat = FETCH_IDLE;
+  cd->prefetch.fetch_stat = FETCH_IDLE;
+  cd->hmm_idx[0] = -1;
+  cd->midx_t0 = cd->midx_t1 = -1;
+
+  sds->curves[sds->n_curves++] = cd;
+  return 1;
 }
 #if 0
 if(sds->cur_idx > 1) {
@@ -400,8 +676,43 @@ void  StripDataSource_refresh (StripDataSource        the_sds)
   int i;
 
 /* Albert */
-  for(i=0;i<STRIP_MAX_CURVES;i++)
-    sds->buffers[i].history.fetch_stat = FETCH_IDLE;
+  for(i=0;i<sds->n_curves;i++)
+    sds->curves[i]->history.fetch_stat = FETCH_IDLE;
+}
+
+
+/*
+ * StripDataSource_prefetch
+ */
+int
+StripDataSource_prefetch        (StripDataSource        the_sds,
+                                 struct timeval         *begin,
+                                 struct timeval         *end)
+{
+  StripDataSourceInfo   *sds = (StripDataSourceInfo *)the_sds;
+  CurveData             *cd;
+  int                   i, n = 0;
+
+  for (i = 0; i < sds->n_curves; i++)
+  {
+    cd = sds->curves[i];
+    
+    /* the result never holds on to any data, see below */
+    StripHistory_cancel (sds->history, &cd->prefetch);
+    cd->prefetch.fetch_stat = FETCH_IDLE;
+    
+#ifdef STRIP_ASYNC_HISTORY
+    if (!begin || !cd->curve->details) continue;
+    if (StripHistory_fetch
+        (sds->history, cd->curve->details->name, begin, end,
+         &cd->prefetch, prefetch_arrived, (void *)sds) == FETCH_PENDING)
+      n++;
+    /* already cached, so there is nothing to hold on to */
+    else StripHistoryResult_release (sds->history, &cd->prefetch);
+#endif
+  }
+
+  return n;
 }
 
 
@@ -422,100 +733,178 @@ StripDataSource_min_max (StripDataSourceInfo *sds, struct timeval h0,
   double max=0.0;
   
   int first,last;
+  size_t imin, imax;
+  long mfirst, mlast;
+  size_t j;
   
   double width;
   double alpha;
   
   int local_precision;
+
+  sdsTime t0 = time2sds (&h0);
+  sdsTime t1 = time2sds (&h_end);
+#ifdef STRIP_HISTORY
+  sdsTime h_need;
+  int n_fetch=0;
+#endif
+#ifdef STRIP_SAMPLE_STORE
+  long zfirst, zlast;
+#endif
+
+#ifdef STRIP_HISTORY
+  /* History is only needed if the ring buffer starts after t0, and
+   * only up to where it starts.  Don't go back to the archiver if
+   * the current history result already covers that much, or will
+   * once it arrives, or has found that there is nothing there.  The
+   * requests for all curves are sent off together, so that they may
+   * be serviced at the same time.  Nothing waits for them: the
+   * extrema come from the data already here, and once the history is
+   * in, the client is called back (see history_arrived) and may scale
+   * again. */
+  for (m = 0; m < sds->n_curves; m++)
+  {
+    cd = sds->curves[m];
+    
+    if ((cd->first != SIZE_MAX) && (sds->times[cd->first] <= t0))
+      continue;
+    
+    h_need = t1;
+    if ((cd->first != SIZE_MAX) && (sds->times[cd->first] < t1))
+      h_need = sds->times[cd->first];
+#ifdef STRIP_SAMPLE_STORE
+    /* nor from where the store takes over */
+    if (cd->zs_first && !SDS_MONITORED (cd) && (cd->zs_first->t0 < h_need))
+      h_need = cd->zs_first->t0;
+    if (h_need <= t0)
+      continue;
+#endif
+
+    if ((cd->history.fetch_stat == FETCH_IDLE) ||
+	(time2sds (&cd->history.t0) > t0) ||
+	(time2sds (&cd->history.t1) < h_need))
+    {
+      /* only a synchronous fetch keeps the user waiting */
+      if (n_fetch++ == 0)
+      {
+	busy_cursor (1);
+      }
+      fetch_history (sds, cd, &h0, &h_end, history_arrived);
+    }
+  }
+  if (n_fetch > 0)
+    busy_cursor (0);
+#endif
   
-  for (m = 0; m < STRIP_MAX_CURVES; m++)
+  for (m = 0; m < sds->n_curves; m++)
   {
-    if ((c = sds->buffers[m].curve) != NULL)
+    if ((c = sds->curves[m]->curve) != NULL)
     {
-      cd = &sds->buffers[m];
+      cd = sds->curves[m];
       some_data = 0;
 	
       first=find_date_idx
-	  (&h0, sds->times, sds->count, sds->buf_size, sds->cur_idx, SDS_GTE);
+	  (t0, sds->times, sds->count, sds->buf_size, sds->cur_idx, SDS_GTE);
       last=find_date_idx
-	  (&h_end, sds->times, sds->count, sds->buf_size, sds->cur_idx, SDS_LTE);
+	  (t1, sds->times, sds->count, sds->buf_size, sds->cur_idx, SDS_LTE);
 	
-      if ((first > -1) && (last > -1) )
+      if ((first > -1) && (last > -1) &&
+	  (sds->times[first] <= sds->times[last]))
 	{
-	  some_data=1;
-	  min=cd->val[first]; 
-	  max=cd->val[first];
+	  /* the summaries give the extrema without scanning the range */
+	  imin = imax = SIZE_MAX;
 	  if (first <= last)
+	    mm_extrema (sds, cd, first, last, &imin, &imax);
+	  else
 	  {
-	    for(i=first; i <= last; i++) 
-	    {
-		if(cd->val[i] < min) min=cd->val[i]; 
-		if(cd->val[i] > max) max=cd->val[i]; 
-	    }
+	    /* First part is first to end, second part is 0 to last */
+	    mm_extrema (sds, cd, first, sds->buf_size - 1, &imin, &imax);
+	    mm_extrema (sds, cd, 0, last, &imin, &imax);
 	  }
-	  else
+	  if (imin != SIZE_MAX)
 	  {
-#if 0
-	    /* perror Albert problem */
-	    for(i=first; i <= last; i--)
-	    {
-		printf("\n\n!!!!%f;\n",cd->val[i]); 
-		if(cd->val[i]<min) min=cd->val[i]; 
-		if(cd->val[i]>max) max=cd->val[i]; 
-	    }
-#else
-	    /* First part is first to end */
-	    for(i=first; i < (int)sds->buf_size; i++)
+	    some_data=1;
+	    min=cd->val[imin]; 
+	    max=cd->val[imax];
+	  }
+	}
+
+      /* in monitor mode, the samples may have missed some updates */
+      if (monitor_find (cd, t0, t1, &mfirst, &mlast))
+	for (j = (size_t)mfirst; ; j = (j + 1) % cd->m_size)
+	{
+	  if (cd->mstat[j] & DATASTAT_PLOTABLE)
+	  {
+	    if (!some_data)
 	    {
-		if(cd->val[i] < min) min=cd->val[i]; 
-		if(cd->val[i] > max) max=cd->val[i]; 
+	      min = max = cd->mval[j];
+	      some_data = 1;
 	    }
-	    /* Second part is 0 to last */
-	    for(i=0; i <= last; i++)
+	    if (cd->mval[j] < min) min = cd->mval[j];
+	    if (cd->mval[j] > max) max = cd->mval[j];
+	  }
+	  if (j == (size_t)mlast) break;
+	}
+#ifdef STRIP_SAMPLE_STORE
+      /* samples gone from the ring buffer, and the history before them */
+      if ((cd->first != SIZE_MAX) && !SDS_MONITORED (cd) &&
+	  (sds->times[cd->first] > t0) &&
+	  store_range
+	  (cd, t0, min (t1, sds->times[cd->first] - 1), &zfirst, &zlast))
+	for (j = (size_t)zfirst; j <= (size_t)zlast; j++)
+	{
+	  if (cd->zs_stat[j] & DATASTAT_PLOTABLE)
+	  {
+	    if (!some_data)
 	    {
-		if(cd->val[i] < min) min=cd->val[i]; 
-		if(cd->val[i] > max) max=cd->val[i]; 
+	      min = max = cd->zs_val[j];
+	      some_data = 1;
 	    }
-#endif	  
+	    if (cd->zs_val[j] < min) min = cd->zs_val[j];
+	    if (cd->zs_val[j] > max) max = cd->zs_val[j];
 	  }
 	}
+#endif
 #ifdef STRIP_HISTORY
-	if(!cursor) cursor = XCreateFontCursor(XtDisplay(history_topShell),XC_watch);
-	XDefineCursor(XtDisplay(history_topShell),
-	  XtWindow(history_topShell), cursor);
-	XFlush(XtDisplay(history_topShell));
-
-      StripHistory_fetch
-	  (sds->history, cd->curve->details->name, &h0, &h_end,
-	    &cd->history, 0, 0);
-
-	XUndefineCursor(XtDisplay(history_topShell),
-	  XtWindow(history_topShell));
-
+      if ((cd->first == SIZE_MAX) || (sds->times[cd->first] > t0))
+      {
 	if((cd->history.n_points>0)&&(cd->history.fetch_stat==FETCH_DONE))
 	{
 	  first = find_date_idx
-	    (&h0, cd->history.times, cd->history.n_points,
+	    (t0, cd->htimes, cd->history.n_points,
 		cd->history.n_points, cd->history.n_points - 1, SDS_GTE);
 	  last = find_date_idx
-	    (&h_end, cd->history.times, cd->history.n_points,
+	    (t1, cd->htimes, cd->history.n_points,
 		cd->history.n_points, cd->history.n_points - 1, SDS_LTE);
 	  
 	  if ((first > -1) && (last > -1) && (first<=last ) )
 	  {
-	    if (some_data == 0) 
+	    /* same range as last time?  Then use the cached extrema */
+	    if ((cd->hmm_idx[0] != first) || (cd->hmm_idx[1] != last))
 	    {
-		min=cd->history.data[first];
-		max=cd->history.data[first];
-		some_data =1;
+	      cd->hmm_val[0] = cd->hmm_val[1] = cd->history.data[first];
+	      for(i=first;i<= last; i++)  
+	      {
+		if (cd->history.data[i] < cd->hmm_val[0])
+		  cd->hmm_val[0] = cd->history.data[i]; 
+		if (cd->history.data[i] > cd->hmm_val[1])
+		  cd->hmm_val[1] = cd->history.data[i]; 
+	      }
+	      cd->hmm_idx[0] = first;
+	      cd->hmm_idx[1] = last;
 	    }
-	    for(i=first;i<= last; i++)  
+	    
+	    if (some_data == 0) 
 	    {
-		if (cd->history.data[i]< min) min=cd->history.data[i]; 
-		if (cd->history.data[i]> max) max=cd->history.data[i]; 
+		min=cd->hmm_val[0];
+		max=cd->hmm_val[1];
+		some_data =1;
 	    }
+	    if (cd->hmm_val[0] < min) min=cd->hmm_val[0]; 
+	    if (cd->hmm_val[1] > max) max=cd->hmm_val[1]; 
 	  }
 	}
+      }
 
 #endif /* STRIP_HISTORY */
 
@@ -584,17 +973,35 @@ StripDataSource_removecurve     (StripDataSource the_sds, StripCurve the_curve)
 {
   StripDataSourceInfo   *sds = (StripDataSourceInfo *)the_sds;
   CurveData             *cd;
+  int                   i;
   int                   ret_val = 1;
 
   if ((cd = CURVE_DATA(the_curve)) != NULL)
   {
     StripHistoryResult_release (sds->history, &cd->history);
-    cd->curve = NULL;
+    StripHistory_cancel (sds->history, &cd->prefetch);
+    if (cd->htimes) free (cd->htimes);
+    reduce_free (cd);
+#ifdef STRIP_SAMPLE_STORE
+    store_free (cd);
+#endif
     free (cd->val);
     free (cd->stat);
-    cd->val = NULL;
-    cd->stat = NULL;
+    mm_free (cd);
+    monitor_free (cd);
     ((StripCurveInfo *)the_curve)->id = NULL;
+
+    /* close up the table, keeping the curves in order */
+    for (i = 0; i < sds->n_curves; i++)
+      if (sds->curves[i] == cd)
+      {
+        sds->n_curves--;
+        memmove
+          (&sds->curves[i], &sds->curves[i+1],
+           (sds->n_curves - i) * sizeof (CurveData *));
+        break;
+      }
+    free (cd);
   }
 
   return ret_val;
@@ -631,7 +1038,7 @@ StripDataSource_removecurveAll(StripDataSource the_sds)
   sds->n_bins         = 0;
   
   /* clear the buffers */
-  memset (sds->buffers, 0, STRIP_MAX_CURVES * sizeof(CurveData));
+  sds->n_curves       = 0;
   
   return ret_val;
 }
@@ -646,59 +1053,71 @@ StripDataSource_sample  (StripDataSource the_sds, char *sgP)
   StripGraph sg = (StripGraph) sgP;
   StripDataSourceInfo           *sds = (StripDataSourceInfo *)the_sds;
   StripCurveInfo                *c;
+  CurveData                     *cd;
   int                           i;
   int                           need_time = 1;
+  struct timeval                now;
   double a; /*Albert*/
+
+#ifdef STRIP_SAMPLE_STORE
+  /* the oldest samples are about to be overwritten */
+  if ((sds->n_curves > 0) && (sds->count == sds->buf_size))
+    store_spill (sds, (sds->cur_idx + 1) % sds->buf_size);
+#endif
   
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
+  /* only the live curves are in the table */
+  for (i = 0; i < sds->n_curves; i++)
   {
+    cd = sds->curves[i];
+    c = cd->curve;
     
-    if ((c = sds->buffers[i].curve) != NULL)
+    a=c->get_value (c->func_data);
+    if (need_time)
     {
-	a=c->get_value (c->func_data);
-      if (need_time)
+      if (a != cd->val[sds->cur_idx])
       {
-	  if (a != sds->buffers[i].val[sds->cur_idx])
-	  {
-	    /*printf("name=%s;old=%f,new=%f\n",
-		c->details->name,a,
-		sds->buffers[i].val[sds->cur_idx]);*/
-	    CurveLegendRefresh(c,sg,a); 
-	  }
-	  
-	  
+        /*printf("name=%s;old=%f,new=%f\n",
+          c->details->name,a,
+          cd->val[sds->cur_idx]);*/
+        CurveLegendRefresh(c,sg,a); 
+      }
 	  
-        sds->cur_idx = (sds->cur_idx + 1) % sds->buf_size;
-        get_current_time (&sds->times[sds->cur_idx]);
-        sds->count = min ((sds->count+1), sds->buf_size);
-        need_time = 0;
-      }       
-      else {
-	  if (a != sds->buffers[i].val[sds->cur_idx -1 ])
-	  {
-	    CurveLegendRefresh(c,sg,a);
-	  }
+      sds->cur_idx = (sds->cur_idx + 1) % sds->buf_size;
+      get_current_time (&now);
+      sds->times[sds->cur_idx] = time2sds (&now);
+      sds->count = min ((sds->count+1), sds->buf_size);
+      need_time = 0;
+    }       
+    else {
+      if (a != cd->val[sds->cur_idx -1 ])
+      {
+        CurveLegendRefresh(c,sg,a);
       }
+    }
 	
-      if ((c->status & STRIPCURVE_CONNECTED) &&
-	  !(c->status & STRIPCURVE_WAITING))
-      {
-	  sds->buffers[i].val[sds->cur_idx] = a;
-	  /*c->get_value (c->func_data); */
-        sds->buffers[i].stat[sds->cur_idx] = DATASTAT_PLOTABLE;
+    if ((c->status & STRIPCURVE_CONNECTED) &&
+        !(c->status & STRIPCURVE_WAITING))
+    {
+      cd->val[sds->cur_idx] = a;
+      /*c->get_value (c->func_data); */
+      cd->stat[sds->cur_idx] = DATASTAT_PLOTABLE;
 	  
-        /* first sample for this curve? */
-        if (sds->buffers[i].first == SIZE_MAX)
-          sds->buffers[i].first = sds->cur_idx;
+      /* first sample for this curve? */
+      if (cd->first == SIZE_MAX)
+        cd->first = sds->cur_idx;
 	  
-        /* otherwise, have we just overwritten what was previously
-         * the first data point? If so, then increment the first data
-         * point index */
-        else if (sds->cur_idx == sds->buffers[i].first)
-          sds->buffers[i].first = (sds->buffers[i].first + 1) % sds->buf_size;
-      }
-      else sds->buffers[i].stat[sds->cur_idx] &= ~DATASTAT_PLOTABLE;
+      /* otherwise, have we just overwritten what was previously
+       * the first data point? If so, then increment the first data
+       * point index */
+      else if (sds->cur_idx == cd->first)
+        cd->first = (cd->first + 1) % sds->buf_size;
     }
+    else cd->stat[sds->cur_idx] &= ~DATASTAT_PLOTABLE;
+
+    if (cd->mm_min)
+      mm_update (sds, cd, sds->cur_idx);
+
+    monitor_sample (sds, cd, sds->times[sds->cur_idx], a);
   }
 }
 /*
@@ -721,27 +1140,33 @@ StripDataSource_init_range      (StripDataSource        the_sds,
 {
   StripDataSourceInfo   *sds = (StripDataSourceInfo *)the_sds;
   CurveData             *cd;
-  struct timeval        t1, t_tmp;
-  struct timeval        h0, h1, *h_end;
+  struct timeval        tv0, tv1;
+  sdsTime               t0n, t1;
+  sdsTime               h0, h1, h_end;
+  sdsTime               live_t0 = 0;
   long                  r0, r1 = 0;
   int                   have_data = 0;
+  int                   have_live;
   int                   i;
+#ifdef STRIP_SAMPLE_STORE
+  long                  i0, i1;
+#endif
 
   long deltaHistoryTime;
 
   /* make t1 */
-  dbl2time (&t_tmp, n_bins * bin_size);
-  add_times (&t1, t0, &t_tmp);
+  t0n = time2sds (t0);
+  t1 = t0n + dbl2sds (n_bins * bin_size);
 
   /* initial history request range */
-  h0 = *t0;
+  h0 = t0n;
   h1 = t1;
   
   /* find earliest timestamp in ring buffer which is greater than
    * or equal to the desired begin time */
   r0 = ((sds->count > 0)?
     find_date_idx
-    (t0, sds->times, sds->count, sds->buf_size, sds->cur_idx, SDS_GTE)
+    (t0n, sds->times, sds->count, sds->buf_size, sds->cur_idx, SDS_GTE)
     : -1);
 
   /* look for last date only if the first one was ok,
@@ -749,8 +1174,8 @@ StripDataSource_init_range      (StripDataSource        the_sds,
   if (r0 >= 0)
   {
     r1 = find_date_idx
-      (&t1, sds->times, sds->count, sds->buf_size, sds->cur_idx, SDS_LTE);
-    if (compare_times (&sds->times[r0], &t1) <= 0)
+      (t1, sds->times, sds->count, sds->buf_size, sds->cur_idx, SDS_LTE);
+    if (sds->times[r0] <= t1)
       h1 = sds->times[r0];
   }
   
@@ -767,13 +1192,15 @@ StripDataSource_init_range      (StripDataSource        the_sds,
     have_data = 1;
   }
   else sds->idx_t0 = sds->idx_t1;
+
+  /* no point asking the archiver for more than the plot can show */
+  StripHistory_resolution (sds->history, bin_size);
   
   /* check each curve for fast-update plausibility, and send off
    * any requisite history fetches */
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
-    if (sds->buffers[i].curve)
+  for (i = 0; i < sds->n_curves; i++)
     {
-      cd = &sds->buffers[i];
+      cd = sds->curves[i];
 
       /* verify endpoints
        *
@@ -788,11 +1215,37 @@ StripDataSource_init_range      (StripDataSource        the_sds,
        *  already-rendered data spans (described by extents).
        */
       cd->connectable = False;
-      if (compare_times (&cd->endpoints[0].t, &cd->endpoints[1].t) < 0)
-        if ((compare_times (t0, &cd->endpoints[0].t) < 0) ||
-	    (compare_times (&t1, &cd->endpoints[1].t) > 0))
+      if (cd->endpoints[0].t < cd->endpoints[1].t)
+        if ((t0n < cd->endpoints[0].t) || (t1 > cd->endpoints[1].t))
           cd->connectable = (method == SDS_JOIN_NEW);
 
+      /* where does live data start?
+       *
+       *  Curves in monitor mode keep their own time line, which is
+       *  searched separately.  They are always refreshed completely,
+       *  since the update holding at t0 is drawn from t0 onwards.
+       */
+      if ((have_live = (cd->first != SIZE_MAX)))
+        live_t0 = sds->times[cd->first];
+      if (SDS_MONITORED (cd))
+      {
+        cd->connectable = False;
+        live_t0 = cd->mtimes[SDS_MONITOR_OLDEST (cd)];
+        have_live = 1;
+        have_data |= monitor_find
+          (cd, t0n, t1, &cd->midx_t0, &cd->midx_t1);
+      }
+
+#ifdef STRIP_SAMPLE_STORE
+      /* the store carries on where the ring buffer leaves off, so
+       * history is only wanted from before it */
+      cd->zs_end = 0;
+      if (have_live && cd->zs_first && !SDS_MONITORED (cd))
+      {
+        cd->zs_end = live_t0;
+        live_t0 = cd->zs_first->t0;
+      }
+#endif
       
       /* history request range
        *
@@ -818,39 +1271,40 @@ StripDataSource_init_range      (StripDataSource        the_sds,
        */
 
       /* case 1 */
-      if (cd->first == SIZE_MAX)
-        h_end = &h1;
+      if (!have_live)
+        h_end = h1;
 
       /* case 2 */
-      else if (compare_times (&sds->times[cd->first], t0) <= 0)
-        h_end = &h0;
+      else if (live_t0 <= t0n)
+        h_end = h0;
 
       /* case 3 */
-      else if (compare_times (&sds->times[cd->first], &t1) >= 0)
-        h_end = &h1;
+      else if (live_t0 >= t1)
+        h_end = h1;
 
       /* case 4-a */
       else if (!cd->connectable)
-        h_end = &sds->times[cd->first];
+        h_end = live_t0;
 
       /* case 4-b-1 */
-      else if ((compare_times (&sds->times[cd->first], &cd->extents[0]) < 0) ||
-	  (compare_times (&sds->times[cd->first], &cd->extents[1]) > 0))
-        h_end = &sds->times[cd->first];
+      else if ((live_t0 < cd->extents[0]) ||
+	  (live_t0 > cd->extents[1]))
+        h_end = live_t0;
 
       /* case 4-b-2 */
-      else h_end = &cd->extents[0];
+      else h_end = cd->extents[0];
       
 
-      deltaHistoryTime = h_end->tv_sec - h0.tv_sec;
+      deltaHistoryTime =
+        (long)(h_end / SDS_NSEC_PER_SEC) - (long)(h0 / SDS_NSEC_PER_SEC);
 
       /*      printf("deltaHistoryTime=%ld n_bins=%d bin_size=%g \n",deltaHistoryTime,n_bins,bin_size); */
 
       /* get the history data? */
-      if ( (compare_times (&h0, h_end) < 0) &&
+      if ( (h0 < h_end) &&
 	  ((cd->history.fetch_stat == FETCH_IDLE) ||
-	    (compare_times (&cd->history.t0, &h0) > 0) ||
-	    (compare_times (&cd->history.t1, h_end) < 0)) && 
+	    (time2sds (&cd->history.t0) > h0) ||
+	    (time2sds (&cd->history.t1) < h_end)) && 
 	  ((auto_scaleTriger!=1)||((auto_scaleTriger==1)&&(radioChange))) 
 	  && (n_bins*bin_size > 0) && (deltaHistoryTime > 1) &&
 	  (deltaHistoryTime > ((5.0*n_bins*bin_size)/100.0) )
@@ -861,38 +1315,67 @@ StripDataSource_init_range      (StripDataSource        the_sds,
           StripHistory_cancel (sds->history, &cd->history);
 
         /* send off new request */
-	  if(!cursor) cursor=XCreateFontCursor(XtDisplay(history_topShell),XC_watch);
-	  XDefineCursor(XtDisplay(history_topShell),
-	    XtWindow(history_topShell), cursor);
-	  XFlush(XtDisplay(history_topShell));
-
-        StripHistory_fetch
-          (sds->history, cd->curve->details->name, &h0, h_end,
-		&cd->history, 0, 0);
-	  XUndefineCursor(XtDisplay(history_topShell),
-	    XtWindow(history_topShell));
+	  busy_cursor (1);
+
+        sds2time (&tv0, h0);
+        sds2time (&tv1, h_end);
+        fetch_history (sds, cd, &tv0, &tv1, history_arrived);
+	  busy_cursor (0);
       }
 
-      /* if we have history data, we now need to find the
-       * begin and end locations for the current history range */
-      if ((compare_times (&h0, h_end) < 0) &&
-	  (cd->history.fetch_stat == FETCH_DONE))
+      cd->hr_end = h_end;
+    }
+
+  /* reduce the history results which need it, all curves together */
+  reduce_curves (sds, bin_size, n_bins);
+  
+  /* if we have history data, we now need to find the begin and end
+   * locations for the current history range */
+  for (i = 0; i < sds->n_curves; i++)
+  {
+    cd = sds->curves[i];
+#ifdef STRIP_SAMPLE_STORE
+    /* stored samples on the range?  Then they come with the history */
+    if (cd->zs_end &&
+        store_range (cd, h0, min (t1, cd->zs_end - 1), &i0, &i1))
+    {
+      cd->hidx_t0 = (size_t)i0;
+      cd->hidx_t1 = (size_t)i1;
+      have_data = 1;
+      continue;
+    }
+    cd->zs_active = False;
+#endif
+    if ((h0 < cd->hr_end) && (cd->history.fetch_stat == FETCH_DONE))
+    {
+      if (cd->hr_active)
       {
         cd->hidx_t0 = find_date_idx
-          (&h0, cd->history.times, cd->history.n_points,
-		cd->history.n_points, cd->history.n_points - 1, SDS_GTE);
+          (h0, cd->hr_times, cd->hr_n, cd->hr_n, cd->hr_n - 1, SDS_GTE);
         cd->hidx_t1 = find_date_idx
-          (h_end, cd->history.times, cd->history.n_points,
-		cd->history.n_points, cd->history.n_points - 1, SDS_LTE);
-
-        have_data |= ((cd->hidx_t0 >= 0) && (cd->hidx_t1 >= cd->hidx_t0));
+          (cd->hr_end, cd->hr_times, cd->hr_n, cd->hr_n, cd->hr_n - 1,
+           SDS_LTE);
       }
+      else
+      {
+        cd->hidx_t0 = find_date_idx
+          (h0, cd->htimes, cd->history.n_points,
+           cd->history.n_points, cd->history.n_points - 1, SDS_GTE);
+        cd->hidx_t1 = find_date_idx
+          (cd->hr_end, cd->htimes, cd->history.n_points,
+           cd->history.n_points, cd->history.n_points - 1, SDS_LTE);
+      }
+
+      have_data |= ((cd->hidx_t0 >= 0) && (cd->hidx_t1 >= cd->hidx_t0));
     }
+  }
+  
   if (radioChange)  radioChange=0;
-  sds->req_t0 = *t0;
+  sds->req_t0 = t0n;
   sds->req_t1 = t1;
   sds->bin_size = bin_size;
   sds->n_bins = n_bins;
+  sds->technique = method;
 
   return have_data;
 }
@@ -908,7 +1391,7 @@ StripDataSource_render  (StripDataSource        the_sds,
   void                   *x_data,
   sdsTransform           y_transform,
   void                   *y_data,
-  XSegment               **segs)
+  sdsSegment             **segs)
 {
   StripDataSourceInfo   *sds = (StripDataSourceInfo *)the_sds;
   CurveData             *cd = CURVE_DATA(curve);
@@ -918,17 +1401,39 @@ StripDataSource_render  (StripDataSource        the_sds,
   ValueBuffer           ring_values, hist_values;
   StatusBuffer          ring_status, hist_status;
   int                   data_state = 0;
+  int                   level;
+  size_t                n_decimated, n_reduced;
+  int                   n_points;
+  sdsTime               stop_t;
+  size_t                ring_t0 = 0, ring_t1 = 0;
 
   render_buffer.n_segs = 0;
 
-  /* ring buffer pointers & initializations */
-  if (sds->idx_t0 != sds->idx_t1)
+  /* ring buffer pointers & initializations
+   *
+   *  In monitor mode, the curve's own time line stands in for the ring
+   *  buffer, copied out on the current range.
+   */
+  if (SDS_MONITORED (cd))
+  {
+    if ((max_points = (int)monitor_range (sds, cd)) > 0)
+    {
+      data_state |= SDS_BUFFERED_DATA;
+      use_point_buffer
+        (&monitor_buffer, max_points,
+         &ring_times, &ring_values, &ring_status);
+      ring_t1 = max_points - 1;
+    }
+  }
+  else if (sds->idx_t0 != sds->idx_t1)
   {
     data_state |= SDS_BUFFERED_DATA;
 
-    if (sds->idx_t0 > sds->idx_t1)
-      max_points = sds->buf_size - sds->idx_t0 + sds->idx_t1 + 1;
-    else max_points = sds->idx_t1 - sds->idx_t0 + 1;
+    ring_t0 = sds->idx_t0;
+    ring_t1 = sds->idx_t1;
+    if (ring_t0 > ring_t1)
+      max_points = sds->buf_size - ring_t0 + ring_t1 + 1;
+    else max_points = ring_t1 - ring_t0 + 1;
       
     ring_times.base = sds->times; 
     ring_times.count = sds->buf_size;
@@ -939,11 +1444,33 @@ StripDataSource_render  (StripDataSource        the_sds,
   }
 
   /* history buffer pointers & initializations */
-  if (cd->history.fetch_stat == FETCH_DONE)
+  if (cd->zs_active)
+  {
+    data_state |= SDS_HISTORY_DATA;
+    
+    hist_times.base = cd->zs_times;
+    hist_times.count = cd->zs_n;
+    hist_values.base = cd->zs_val;
+    hist_values.count = cd->zs_n;
+    hist_status.base = cd->zs_stat;
+    hist_status.count = cd->zs_n;
+  }
+  else if ((cd->history.fetch_stat == FETCH_DONE) && cd->hr_active)
+  {
+    data_state |= SDS_HISTORY_DATA;
+    
+    hist_times.base = cd->hr_times;
+    hist_times.count = cd->hr_n;
+    hist_values.base = cd->hr_val;
+    hist_values.count = cd->hr_n;
+    hist_status.base = cd->hr_stat;
+    hist_status.count = cd->hr_n;
+  }
+  else if (cd->history.fetch_stat == FETCH_DONE)
   {
     data_state |= SDS_HISTORY_DATA;
     
-    hist_times.base = cd->history.times;
+    hist_times.base = cd->htimes;
     hist_times.count = cd->history.n_points;
     hist_values.base = cd->history.data;
     hist_values.count = cd->history.n_points;
@@ -953,8 +1480,8 @@ StripDataSource_render  (StripDataSource        the_sds,
 
   if (!(data_state & SDS_BOTH_DATA))    /* no data at all? */
   {
-    cd->endpoints[0].t.tv_sec = 1;
-    cd->endpoints[1].t.tv_sec = 0;
+    cd->endpoints[0].t = SDS_NSEC_PER_SEC;
+    cd->endpoints[1].t = 0;
     return 0;
   }
       
@@ -964,17 +1491,16 @@ StripDataSource_render  (StripDataSource        the_sds,
     /* any data in the ring buffer ahead of currently rendered? */
     if (data_state & SDS_BUFFERED_DATA)
     {
-      if (compare_times
-	  (&ring_times.base[sds->idx_t0], &cd->endpoints[0].t) < 0)
+      if (ring_times.base[ring_t0] < cd->endpoints[0].t)
       {
-        ring_times.ptr = ring_times.base + sds->idx_t0;
-        ring_values.ptr = ring_values.base + sds->idx_t0;
-        ring_status.ptr = ring_status.base + sds->idx_t0;
+        ring_times.ptr = ring_times.base + ring_t0;
+        ring_values.ptr = ring_values.base + ring_t0;
+        ring_status.ptr = ring_status.base + ring_t0;
         
         segmentify
           (sds, &render_buffer, SDS_INCREASING,
 		&ring_times, &ring_values, &ring_status,
-		max_points, &cd->endpoints[0].t,
+		max_points, cd->endpoints[0].t,
 		0, &cd->endpoints[0],
 		&ring_first, 0, x_transform, x_data, y_transform, y_data);
         
@@ -983,17 +1509,16 @@ StripDataSource_render  (StripDataSource        the_sds,
       }
       else
       {
-        ring_first.t = ring_times.base[sds->idx_t0];
-        ring_first.v = ring_values.base[sds->idx_t0];
-        ring_first.s = ring_status.base[sds->idx_t0];
+        ring_first.t = ring_times.base[ring_t0];
+        ring_first.v = ring_values.base[ring_t0];
+        ring_first.s = ring_status.base[ring_t0];
       }
     }
 
     /* any history data before currently rendered? */
     if (data_state & SDS_HISTORY_DATA)
     {
-      if (compare_times
-	  (&hist_times.base[cd->hidx_t0], &cd->endpoints[0].t) < 0)
+      if (hist_times.base[cd->hidx_t0] < cd->endpoints[0].t)
       {
         hist_times.ptr = hist_times.base + cd->hidx_t0;
         hist_values.ptr = hist_values.base + cd->hidx_t0;
@@ -1002,7 +1527,7 @@ StripDataSource_render  (StripDataSource        the_sds,
         segmentify
           (sds, &render_buffer, SDS_INCREASING,
 		&hist_times, &hist_values, &hist_status,
-		cd->hidx_t1 - cd->hidx_t0 + 1, &cd->endpoints[0].t,
+		cd->hidx_t1 - cd->hidx_t0 + 1, cd->endpoints[0].t,
 		0, &cd->endpoints[0],
 		&hist_first, 0, x_transform, x_data, y_transform, y_data);
         
@@ -1020,8 +1545,7 @@ StripDataSource_render  (StripDataSource        the_sds,
     /* any history data following currently rendered? */
     if (data_state & SDS_HISTORY_DATA)
     {
-      if (compare_times
-	  (&hist_times.base[cd->hidx_t1], &cd->endpoints[1].t) > 0)
+      if (hist_times.base[cd->hidx_t1] > cd->endpoints[1].t)
       {
         hist_times.ptr = hist_times.base + cd->hidx_t1;
         hist_values.ptr = hist_values.base + cd->hidx_t1;
@@ -1030,7 +1554,7 @@ StripDataSource_render  (StripDataSource        the_sds,
         segmentify
           (sds, &render_buffer, SDS_DECREASING,
 		&hist_times, &hist_values, &hist_status,
-		cd->hidx_t1 - cd->hidx_t0 + 1, &cd->endpoints[1].t,
+		cd->hidx_t1 - cd->hidx_t0 + 1, cd->endpoints[1].t,
 		0, &cd->endpoints[1],
 		&hist_last, 0, x_transform, x_data, y_transform, y_data);
         
@@ -1048,17 +1572,16 @@ StripDataSource_render  (StripDataSource        the_sds,
     /* any data in the ring buffer following currently rendered? */
     if (data_state & SDS_BUFFERED_DATA)
     {
-      if (compare_times
-	  (&ring_times.base[sds->idx_t1], &cd->endpoints[1].t) > 0)
+      if (ring_times.base[ring_t1] > cd->endpoints[1].t)
       {
-        ring_times.ptr = ring_times.base + sds->idx_t1;
-        ring_values.ptr = ring_values.base + sds->idx_t1;
-        ring_status.ptr = ring_status.base + sds->idx_t1;
+        ring_times.ptr = ring_times.base + ring_t1;
+        ring_values.ptr = ring_values.base + ring_t1;
+        ring_status.ptr = ring_status.base + ring_t1;
 
         segmentify
           (sds, &render_buffer, SDS_DECREASING,
 		&ring_times, &ring_values, &ring_status,
-		max_points, &cd->endpoints[1].t,
+		max_points, cd->endpoints[1].t,
 		0, &cd->endpoints[1],
 		&ring_last, 0, x_transform, x_data, y_transform, y_data);
         
@@ -1067,32 +1590,32 @@ StripDataSource_render  (StripDataSource        the_sds,
       }
       else
       {
-        ring_last.t = ring_times.base[sds->idx_t1];
-        ring_last.v = ring_values.base[sds->idx_t1];
-        ring_last.s = ring_status.base[sds->idx_t1];
+        ring_last.t = ring_times.base[ring_t1];
+        ring_last.v = ring_values.base[ring_t1];
+        ring_last.s = ring_status.base[ring_t1];
       }
     }
 
     /* verify that the endpoints are within the current range.
      * If not, choose the closest history or buffer point. */
-    if ((compare_times (&cd->endpoints[0].t, &sds->req_t0) < 0))
+    if (cd->endpoints[0].t < sds->req_t0)
     {
       if (data_state == SDS_BUFFERED_DATA)
         cd->endpoints[0] = ring_first;
       else if (data_state == SDS_HISTORY_DATA)
         cd->endpoints[0] = hist_first;
-      else if (compare_times (&ring_first.t, &hist_first.t) <= 0)
+      else if (ring_first.t <= hist_first.t)
         cd->endpoints[0] = ring_first;
       else cd->endpoints[0] = hist_first;
     }
     
-    if ((compare_times (&cd->endpoints[1].t, &sds->req_t1) > 0))
+    if (cd->endpoints[1].t > sds->req_t1)
     {
       if (data_state == SDS_BUFFERED_DATA)
         cd->endpoints[1] = ring_last;
       else if (data_state == SDS_HISTORY_DATA)
         cd->endpoints[1] = hist_last;
-      else if (compare_times (&ring_last.t, &hist_last.t) >= 0)
+      else if (ring_last.t >= hist_last.t)
         cd->endpoints[1] = ring_last;
       else cd->endpoints[1] = hist_last;
     }
@@ -1105,14 +1628,14 @@ StripDataSource_render  (StripDataSource        the_sds,
      *  (a) expand the extents if the corresponding endpoints have expanded
      *  (b) clip the extents to the current range if they overextend
      */
-    if (compare_times (&cd->endpoints[0].t, &cd->extents[0]) < 0)
+    if (cd->endpoints[0].t < cd->extents[0])
       cd->extents[0] = cd->endpoints[0].t;
-    if (compare_times (&cd->endpoints[1].t, &cd->extents[1]) > 0)
+    if (cd->endpoints[1].t > cd->extents[1])
       cd->extents[1] = cd->endpoints[1].t;
     
-    if (compare_times (&cd->extents[0], &sds->req_t0) < 0)
+    if (cd->extents[0] < sds->req_t0)
       cd->extents[0] = sds->req_t0;
-    if (compare_times (&cd->extents[1], &sds->req_t1) > 0)
+    if (cd->extents[1] > sds->req_t1)
       cd->extents[1] = sds->req_t1;
   }
 
@@ -1122,17 +1645,50 @@ StripDataSource_render  (StripDataSource        the_sds,
     /* ====== ring buffer ====== */
     if (data_state & SDS_BUFFERED_DATA) /* any buffered data on range? */
     {
-      ring_times.ptr = ring_times.base + sds->idx_t0;
-      ring_values.ptr = ring_values.base + sds->idx_t0;
-      ring_status.ptr = ring_status.base + sds->idx_t0;
-      
+      /* many samples per bin?  Then use the min/max summaries */
+      n_decimated = 0;
+      if (!SDS_MONITORED (cd) &&
+          ((level = mm_level (cd, max_points, sds->n_bins)) >= 0))
+        n_decimated = mm_decimate (sds, cd, level, max_points);
+
+      if (n_decimated > 0)
+      {
+        use_point_buffer
+          (&decimate_buffer, n_decimated,
+		&ring_times, &ring_values, &ring_status);
+        n_points = (int)n_decimated;
+        stop_t = ring_times.base[n_decimated-1];
+      }
+      else
+      {
+        ring_times.ptr = ring_times.base + ring_t0;
+        ring_values.ptr = ring_values.base + ring_t0;
+        ring_status.ptr = ring_status.base + ring_t0;
+        n_points = max_points;
+        stop_t = ring_times.base[ring_t1];
+      }
+
+      /* at most four points per bin? */
+      if (sds->technique == SDS_REFRESH_M4)
+      {
+        n_reduced = m4_reduce
+          (sds, &ring_times, &ring_values, &ring_status, n_points, stop_t);
+        if (n_reduced > 0)
+        {
+          use_point_buffer
+            (&m4_buffer, n_reduced,
+		  &ring_times, &ring_values, &ring_status);
+          n_points = (int)n_reduced;
+        }
+      }
+
       segmentify
         (sds, &render_buffer, SDS_INCREASING,
-	    &ring_times, &ring_values, &ring_status,
-	    max_points, &ring_times.base[sds->idx_t1],
-	    0, 0,
-	    &cd->endpoints[0], &cd->endpoints[1],  /* new endpoints */
-	    x_transform, x_data, y_transform, y_data);
+	      &ring_times, &ring_values, &ring_status,
+	      n_points, stop_t,
+	      0, 0,
+	      &cd->endpoints[0], &cd->endpoints[1],  /* new endpoints */
+	      x_transform, x_data, y_transform, y_data);
     }
       
     /* ====== history data ====== */
@@ -1141,17 +1697,34 @@ StripDataSource_render  (StripDataSource        the_sds,
       hist_times.ptr = hist_times.base + cd->hidx_t0;
       hist_values.ptr = hist_values.base + cd->hidx_t0;
       hist_status.ptr = hist_status.base + cd->hidx_t0;
+      n_points = cd->hidx_t1 - cd->hidx_t0 + 1;
+
+      /* at most four points per bin? */
+      if (sds->technique == SDS_REFRESH_M4)
+      {
+        if (data_state & SDS_BUFFERED_DATA)
+          stop_t = cd->endpoints[0].t;
+        else stop_t = hist_times.base[cd->hidx_t1];
+        n_reduced = m4_reduce
+          (sds, &hist_times, &hist_values, &hist_status, n_points, stop_t);
+        if (n_reduced > 0)
+        {
+          use_point_buffer
+            (&m4_buffer, n_reduced,
+		  &hist_times, &hist_values, &hist_status);
+          n_points = (int)n_reduced;
+        }
+      }
 
       if (data_state & SDS_BUFFERED_DATA)
       {
         /* any history data ahead of currently rendered buffer data? */
-        if (compare_times
-	    (&hist_times.base[cd->hidx_t0], &cd->endpoints[0].t) < 0)
+        if (hist_times.ptr[0] < cd->endpoints[0].t)
         {
           segmentify
             (sds, &render_buffer, SDS_INCREASING,
 		  &hist_times, &hist_values, &hist_status,
-		  cd->hidx_t1 - cd->hidx_t0 + 1, &cd->endpoints[0].t,
+		  n_points, cd->endpoints[0].t,
 		  0, &cd->endpoints[0],
 		  &hist_first, 0, x_transform, x_data, y_transform, y_data);
           
@@ -1164,7 +1737,7 @@ StripDataSource_render  (StripDataSource        the_sds,
         segmentify
           (sds, &render_buffer, SDS_INCREASING,
 		&hist_times, &hist_values, &hist_status,
-		cd->hidx_t1 - cd->hidx_t0 + 1, &hist_times.base[cd->hidx_t1],
+		n_points, hist_times.ptr[n_points-1],
 		0, 0,
 		&cd->endpoints[0], &cd->endpoints[1],        /* new endpoints */
 		x_transform, x_data, y_transform, y_data);
@@ -1183,6 +1756,10 @@ StripDataSource_render  (StripDataSource        the_sds,
 
 
 /* segmentify
+ *
+ *      The points are gathered in chunks of SDS_SEGMENTIFY_CHUNK, and each
+ *      chunk is handed to the x and y transforms in a single call before
+ *      being collapsed into line segments.
  */
 static size_t
 segmentify      (StripDataSourceInfo    *sds,
@@ -1192,7 +1769,7 @@ segmentify      (StripDataSourceInfo    *sds,
   ValueBuffer            *values,
   StatusBuffer           *status,
   int                    max_points,
-  struct timeval         *stop_t,
+  sdsTime                stop_t,
   DataPoint              *connect_first,
   DataPoint              *connect_last,
   DataPoint              *first,
@@ -1202,26 +1779,30 @@ segmentify      (StripDataSourceInfo    *sds,
   sdsTransform           y_transform,
   void                   *y_data)
 {
-  XPoint                p1, p2;         /* previous point, current point */
-  XSegment              *s;             /* current line segment */
+  sdsPoint              p1, p2;         /* previous point, current point */
+  sdsSegment            *s;             /* current line segment */
   Boolean               empty_seg;
   Boolean               done;
   int                   d1x, d1y;       /* dx, dy for current line (s) */
   int                   d2x, d2y;       /* dx, dy for new line (p1, p2) */
-  struct timeval        *t = NULL;
+  sdsTime               *t = NULL;
   double                *v = NULL;
-  double                z;
   StatusType            *stat = NULL;
   int                   offset;
   int                   n_processed;
   Boolean               zero_points;
+  double                chunk_x[SDS_SEGMENTIFY_CHUNK];
+  double                chunk_y[SDS_SEGMENTIFY_CHUNK];
+  StatusType            chunk_s[SDS_SEGMENTIFY_CHUNK];
+  DataPoint             last_point;
+  int                   i, n;
 
   p1.x=0;
   p1.y=0;
 
   /* NB: For this algorithm, we'll adopt the convention that
    * the first point in a segment will always hold the min
-   * point with respect to x.  So for XSegment s, s.x1 <= s.x2
+   * point with respect to x.  So for segment s, s.x1 <= s.x2
    * 
    * first make sure we have enough memory to hold a reasonable
    * number of sements: 2 * number of horizontal bins
@@ -1236,251 +1817,260 @@ segmentify      (StripDataSourceInfo    *sds,
   done = False;
   zero_points = True;
   
-  while (!done || connect_last)
+  for (;;)
   {
-    if (connect_first)
-    {
-      /* connect first point */
-      t = &connect_first->t;
-      v = &connect_first->v;
-      stat = &connect_first->s;
-      connect_first = 0;
-    }
-    
-    else if ((n_processed < max_points) && !done)
+    /* gather the next chunk of points */
+    n = 0;
+    while (n < SDS_SEGMENTIFY_CHUNK)
     {
-      if ((direction == SDS_INCREASING) &&
-	  (compare_times (times->ptr, stop_t) <= 0))
+      if (connect_first)
       {
-        t = times->ptr++;
-        v = values->ptr++;
-        stat = status->ptr++;
-        n_processed++;
-
-        /* check buffers for wrap around */
-        if (times->ptr >= times->base + times->count)
-          times->ptr -= times->count;
-        if (values->ptr >= values->base + values->count)
-          values->ptr -= values->count;
-        if (status->ptr >= status->base + status->count)
-          status->ptr -= status->count;
+        /* connect first point */
+        t = &connect_first->t;
+        v = &connect_first->v;
+        stat = &connect_first->s;
+        connect_first = 0;
       }
-      else if ((direction == SDS_DECREASING) &&
-	  (compare_times (times->ptr, stop_t) >= 0))
+    
+      else if ((n_processed < max_points) && !done)
       {
-        t = times->ptr--;
-        v = values->ptr--;
-        stat = status->ptr--;
-        n_processed++;
-
-        /* check buffers for wrap around */
-        if (times->ptr < times->base)
-          times->ptr += times->count;
-        if (values->ptr < values->base)
-          values->ptr += values->count;
-        if (status->ptr < status->base)
-          status->ptr += status->count;
+        if ((direction == SDS_INCREASING) && (*times->ptr <= stop_t))
+        {
+          t = times->ptr++;
+          v = values->ptr++;
+          stat = status->ptr++;
+          n_processed++;
+
+          /* check buffers for wrap around */
+          if (times->ptr >= times->base + times->count)
+            times->ptr -= times->count;
+          if (values->ptr >= values->base + values->count)
+            values->ptr -= values->count;
+          if (status->ptr >= status->base + status->count)
+            status->ptr -= status->count;
+        }
+        else if ((direction == SDS_DECREASING) && (*times->ptr >= stop_t))
+        {
+          t = times->ptr--;
+          v = values->ptr--;
+          stat = status->ptr--;
+          n_processed++;
+
+          /* check buffers for wrap around */
+          if (times->ptr < times->base)
+            times->ptr += times->count;
+          if (values->ptr < values->base)
+            values->ptr += values->count;
+          if (status->ptr < status->base)
+            status->ptr += status->count;
+        }
+        else
+        {
+          done = True;
+          continue;
+        }
       }
-      else
+    
+      else if (connect_last)
       {
-        done = True;
-        continue;
+        /* connect last point */
+        t = &connect_last->t;
+        v = &connect_last->v;
+        stat = &connect_last->s;
+        connect_last = 0;
       }
-    }
     
-    else if (connect_last)
-    {
-      /* connect last point */
-      t = &connect_last->t;
-      v = &connect_last->v;
-      stat = &connect_last->s;
-      connect_last = 0;
-    }
-    
-    else break;
+      else break;
 
-    /* remeber first point */
-    if (zero_points)
-    {
-      if (first)
+      /* remeber first point */
+      if (zero_points)
       {
-        first->t = *t;
-        first->v = *v;
-        first->s = *stat;
+        if (first)
+        {
+          first->t = *t;
+          first->v = *v;
+          first->s = *stat;
+        }
+        zero_points = False;
       }
-      zero_points = False;
-    }
 
-    /* if this point is not plotable, then we have a hole
-     * in the data.  Must finish current segment if not
-     * already finished, and flag that we need to start
-     * afresh. */
-    if (!(*stat & DATASTAT_PLOTABLE))
-    {
-      /* If the previous point was valid, then we need to 
-       * stop goofing with its line segment, and start working
-       * on a new one. */
-      if (!empty_seg) s++;
-
-      /* make sure we have enough memory.  This isn't very efficient,
-       * but hopefully will only happen in rare situations */
-      offset = s - rbuf->segs;
-      if (!verify_render_buffer (rbuf, rbuf->n_segs + 128))
-      {
-        fprintf
-          (stderr,
-		"StripDataSource_segmentify():\n"
-		"  memory exhausted, unable to render all data\n");
-        return rbuf->n_segs;
-      }
-      s = rbuf->segs + offset;
-      
-      empty_seg = True;
-      continue;
+      last_point.t = *t;
+      last_point.v = *v;
+      last_point.s = *stat;
+
+      chunk_x[n] = sds2dbl (*t);
+      chunk_y[n] = *v;
+      chunk_s[n] = *stat;
+      n++;
     }
 
-    /* transform the data point to a raster location.
-     *
-     *  For the time being, we just transform one point at a time.
-     *  Once I've got this debugged, we can do bigger chunks in
-     *  order to eliminate some of the function call overhead.
-     */
-    z = time2dbl (t);
-    x_transform (x_data, &z, &z, 1);
-    p2.x = (short)z;
-    y_transform (y_data, v, &z, 1);
-    p2.y = (short)z;
+    if (n == 0) break;
+
+    /* transform the whole chunk to raster locations */
+    x_transform (x_data, chunk_x, chunk_x, n);
+    y_transform (y_data, chunk_y, chunk_y, n);
 
-    if (empty_seg)      /* initialize empty segment? */
+    for (i = 0; i < n; i++)
     {
-      s->x1 = s->x2 = p1.x = p2.x;
-      s->y1 = s->y2 = p1.y = p2.y;
-      empty_seg = False;
-      rbuf->n_segs++;
-    }
-    else
-    {
-      /* the slope of the current line */
-      d1x = s->x2 - s->x1;
-      d1y = s->y2 - s->y1;
-
-      /* the slope of the new line */
-      d2x = p2.x - p1.x;
-      d2y = p2.y - p1.y;
-
-      /* now we have the slope of the original line in d1x, and,
-       * in d2x, the slope of the line generated by connecting
-       * the previous point, p1, with the new point, p2.
-       * 
-       * there are four possibilities for each slope (note that
-       * x is assumed to be monotonically increasing or decreasing,
-       * because it is a function of reverse or forward time).
-       * 
-       * (a) dx == 0, dy == 0   : no change
-       * (b) dx == 0, dy != 0   : vertical +/-.
-       * (c) dx != 0,  dy == 0  : horizontal +
-       * (d) dx != 0,  dy != 0  : horizontal +, vertical +/-
-       * 
-       * Note that if either slope falls into category (a), then
-       * the lines may be collapsed.
-       * 
-       * If both slopes fall into category (b) or both fall into
-       * category (c), then the lines can be collapsed.
-       * 
-       * If both slopes fall into category (d), then the lines
-       * can be collapsed iff d1y/d1x = d2y/d2x
-       */
-      
-      /* category a     --one or both lines are actually just points */
-      if (!d1x && !d1y)
+      /* if this point is not plotable, then we have a hole
+       * in the data.  Must finish current segment if not
+       * already finished, and flag that we need to start
+       * afresh. */
+      if (!(chunk_s[i] & DATASTAT_PLOTABLE))
       {
-        s->x2 = p2.x;
-        s->y2 = p2.y;
+        /* If the previous point was valid, then we need to 
+         * stop goofing with its line segment, and start working
+         * on a new one. */
+        if (!empty_seg) s++;
+
+        /* make sure we have enough memory.  This isn't very efficient,
+         * but hopefully will only happen in rare situations */
+        offset = s - rbuf->segs;
+        if (!verify_render_buffer (rbuf, rbuf->n_segs + 128))
+        {
+          fprintf
+            (stderr,
+		  "StripDataSource_segmentify():\n"
+		  "  memory exhausted, unable to render all data\n");
+          return rbuf->n_segs;
+        }
+        s = rbuf->segs + offset;
+      
+        empty_seg = True;
+        continue;
       }
-      else if (!d2x && !d2y)
+
+      /* raster location, already transformed */
+      p2.x = (short)chunk_x[i];
+      p2.y = (short)chunk_y[i];
+
+      if (empty_seg)      /* initialize empty segment? */
       {
-        /* new point overlaps old --do nothing */
+        s->x1 = s->x2 = p1.x = p2.x;
+        s->y1 = s->y2 = p1.y = p2.y;
+        empty_seg = False;
+        rbuf->n_segs++;
       }
-
-      
-      /* category b     --changing vertical component */
-      else if (!d1x && !d2x)
+      else
       {
-        if (s->y1 >= s->y2)
+        /* the slope of the current line */
+        d1x = s->x2 - s->x1;
+        d1y = s->y2 - s->y1;
+
+        /* the slope of the new line */
+        d2x = p2.x - p1.x;
+        d2y = p2.y - p1.y;
+
+        /* now we have the slope of the original line in d1x, and,
+         * in d2x, the slope of the line generated by connecting
+         * the previous point, p1, with the new point, p2.
+         * 
+         * there are four possibilities for each slope (note that
+         * x is assumed to be monotonically increasing or decreasing,
+         * because it is a function of reverse or forward time).
+         * 
+         * (a) dx == 0, dy == 0   : no change
+         * (b) dx == 0, dy != 0   : vertical +/-.
+         * (c) dx != 0,  dy == 0  : horizontal +
+         * (d) dx != 0,  dy != 0  : horizontal +, vertical +/-
+         * 
+         * Note that if either slope falls into category (a), then
+         * the lines may be collapsed.
+         * 
+         * If both slopes fall into category (b) or both fall into
+         * category (c), then the lines can be collapsed.
+         * 
+         * If both slopes fall into category (d), then the lines
+         * can be collapsed iff d1y/d1x = d2y/d2x
+         */
+      
+        /* category a     --one or both lines are actually just points */
+        if (!d1x && !d1y)
         {
-          if (p2.y > s->y1)
-            s->y1 = p2.y;
-          else if (p2.y < s->y2)
-            s->y2 = p2.y;
+          s->x2 = p2.x;
+          s->y2 = p2.y;
         }
-        else    /* s->y1 < s->y2 */
+        else if (!d2x && !d2y)
         {
-          if (p2.y > s->y2)
-            s->y2 = p2.y;
-          else if (p2.y < s->y1)
-            s->y1 = p2.y;
+          /* new point overlaps old --do nothing */
         }
-      }
 
       
-      /* category c     --changing horizontal component */
-      else if (!d1y && !d2y)
-      {
-        if (p2.x != s->x2) s->x2 = p2.x;
-      }
+        /* category b     --changing vertical component */
+        else if (!d1x && !d2x)
+        {
+          if (s->y1 >= s->y2)
+          {
+            if (p2.y > s->y1)
+              s->y1 = p2.y;
+            else if (p2.y < s->y2)
+              s->y2 = p2.y;
+          }
+          else    /* s->y1 < s->y2 */
+          {
+            if (p2.y > s->y2)
+              s->y2 = p2.y;
+            else if (p2.y < s->y1)
+              s->y1 = p2.y;
+          }
+        }
 
       
-      /* category d     --changing horizontal, changing vertical */
-      else
-      {
-        /* if d1x/d1y = d2x/d2y then new point is on the same line */
-        if (d1x*d2y == d2x*d1y)
+        /* category c     --changing horizontal component */
+        else if (!d1y && !d2y)
         {
-          s->x2 = p2.x;
-          s->y2 = p2.y;
+          if (p2.x != s->x2) s->x2 = p2.x;
         }
 
-        /* oh well, can't win 'em all.  Have to make a new line */
+      
+        /* category d     --changing horizontal, changing vertical */
         else
         {
-          if (s->x2 != p1.x)
+          /* if d1x/d1y = d2x/d2y then new point is on the same line */
+          if (d1x*d2y == d2x*d1y)
           {
-            p2.x--;
-            p2.x++;
+            s->x2 = p2.x;
+            s->y2 = p2.y;
           }
-            
-          rbuf->n_segs++;
-          s++;
 
-          /* make sure we have enough memory */
-          offset = s - rbuf->segs;
-          if (!verify_render_buffer (rbuf, rbuf->n_segs + 8))
+          /* oh well, can't win 'em all.  Have to make a new line */
+          else
           {
-            fprintf
-              (stderr,
-		    "StripDataSource_segmentify(): memory exhausted, unable to\n"
-		    "  render all data\n");
-            return rbuf->n_segs;
-          }
-          s = rbuf->segs + offset;
+            if (s->x2 != p1.x)
+            {
+              p2.x--;
+              p2.x++;
+            }
+            
+            rbuf->n_segs++;
+            s++;
+
+            /* make sure we have enough memory */
+            offset = s - rbuf->segs;
+            if (!verify_render_buffer (rbuf, rbuf->n_segs + 8))
+            {
+              fprintf
+                (stderr,
+		      "StripDataSource_segmentify(): memory exhausted, unable to\n"
+		      "  render all data\n");
+              return rbuf->n_segs;
+            }
+            s = rbuf->segs + offset;
           
-          s->x1 = p1.x;
-          s->y1 = p1.y;
-          s->x2 = p2.x;
-          s->y2 = p2.y;
+            s->x1 = p1.x;
+            s->y1 = p1.y;
+            s->x2 = p2.x;
+            s->y2 = p2.y;
+          }
         }
       }
-    }
 
-    p1 = p2;
+      p1 = p2;
+    }
   }
 
   if (last && !zero_points)
-  {
-    last->t = *t;
-    last->v = *v;
-    last->s = *stat;
-  }
+    *last = last_point;
   
   return (size_t)n_processed;
 }
@@ -1495,7 +2085,6 @@ StripDataSource_dump_sdds    (StripDataSource        the_sds,
   char                    *fName)
 {
   StripDataSourceInfo   *sds = (StripDataSourceInfo *)the_sds;
-  char                  buf[SDS_DUMP_FIELDWIDTH+1];
   time_t                tt;
   double                time;
   int                   msec;
@@ -1512,38 +2101,9 @@ StripDataSource_dump_sdds    (StripDataSource        the_sds,
   if (sds->idx_t0 == sds->idx_t1) return 0;
 
   /* if no curves, return failure */
-  for (i = 0; i < STRIP_MAX_CURVES; i++) if (sds->buffers[i].curve) break;
-  if (i >= STRIP_MAX_CURVES) return 0;
-
-  /* Initializes a SDDS_TABLE structure for use writing data to a SDDS file */
-  if (!SDDS_InitializeOutput(&Table,SDDS_BINARY,1L,DUMP_SDDS_DESCRIPTION,
-	  DUMP_SDDS_CONTENTS,fName))
-    SDDS_PrintErrors(stderr,SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
-
-  /* Processes definition of the time column */
-  if (SDDS_DefineColumn(&Table,DUMP_SDDS_TIME_COL,NULL,DUMP_SDDS_TIME_COL_UNITS,
-    NULL,NULL,SDDS_DOUBLE,0) == -1)
-    SDDS_PrintErrors(stderr,SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
-
-  /* Processes definitions of the data columns */
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
-    if (sds->buffers[i].curve)
-    {
-      if(SDS_DUMP_NUMWIDTH>sds->buffers[i].curve->details->precision)
-        sprintf(buf,"%%%d.%dg",SDS_DUMP_NUMWIDTH,
-	    sds->buffers[i].curve->details->precision);
-      else
-        sprintf(buf,"%%%dg",SDS_DUMP_NUMWIDTH);
-      if (SDDS_DefineColumn(&Table, sds->buffers[i].curve->details->name,NULL,
-		sds->buffers[i].curve->details->egu,
-		sds->buffers[i].curve->details->comment,
-		buf, SDDS_DOUBLE, 0) == -1)
-        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
-    }
+  if (sds->n_curves == 0) return 0;
 
-  /* Writes the SDDS header describing the layout of the data tables */
-  if (!SDDS_WriteLayout(&Table))
-    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
+  dump_sdds_layout (sds, &Table, fName);
 
   /* Initializes a SDDS_TABLE structure */
   numRows = sds->count;
@@ -1559,9 +2119,9 @@ StripDataSource_dump_sdds    (StripDataSource        the_sds,
 #if 0
   for(i=0; i < sds->buf_size; i++) {
     printf("%4d",i);
-    for(j=0; j < STRIP_MAX_CURVES; j++) {
-      if (sds->buffers[j].curve) {
-	  printf(" %2d %10.4f",j,sds->buffers[j].val[i]);
+    for(j=0; j < sds->n_curves; j++) {
+      {
+	  printf(" %2d %10.4f",j,sds->curves[j]->val[i]);
 	}
     }
     printf("\n");
@@ -1581,8 +2141,8 @@ StripDataSource_dump_sdds    (StripDataSource        the_sds,
     i=(i0 + row) % sds->buf_size;
     
     /* Format sample time column value */
-    tt = (time_t)sds->times[i].tv_sec;
-    msec = (int)(sds->times[i].tv_usec / ONE_THOUSAND);
+    tt = (time_t)(sds->times[i] / SDS_NSEC_PER_SEC);
+    msec = (int)((sds->times[i] % SDS_NSEC_PER_SEC) / 1000000);
     time = (double)tt + ((double)msec / (double)ONE_THOUSAND);
 
     /* Set time value */
@@ -1591,15 +2151,14 @@ StripDataSource_dump_sdds    (StripDataSource        the_sds,
 	SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
 
     /* Format and set data column values */
-    for (j = 0; j < STRIP_MAX_CURVES; j++)
-      if (sds->buffers[j].curve)
+    for (j = 0; j < sds->n_curves; j++)
       {
 
-        if (sds->buffers[j].stat[i] & DATASTAT_PLOTABLE)
+        if (sds->curves[j]->stat[i] & DATASTAT_PLOTABLE)
         {
           if (SDDS_SetRowValues(&Table, SDDS_SET_BY_NAME|SDDS_PASS_BY_VALUE,
-		    rowIndex, sds->buffers[j].curve->details->name,
-		    sds->buffers[j].val[i], NULL) != 1)
+		    rowIndex, sds->curves[j]->curve->details->name,
+		    sds->curves[j]->val[i], NULL) != 1)
             SDDS_PrintErrors(stderr,
 		  SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
         }
@@ -1607,7 +2166,7 @@ StripDataSource_dump_sdds    (StripDataSource        the_sds,
         else
         {
           if (SDDS_SetRowValues(&Table, SDDS_SET_BY_NAME|SDDS_PASS_BY_VALUE,
-            rowIndex, sds->buffers[j].curve->details->name, "NaN", NULL) != 1)
+            rowIndex, sds->curves[j]->curve->details->name, "NaN", NULL) != 1)
             SDDS_PrintErrors(stderr,
 		  SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
         }
@@ -1630,6 +2189,40 @@ StripDataSource_dump_sdds    (StripDataSource        the_sds,
 
   return 1;
 }
+
+
+/*
+ * StripDataSource_dump_sdds_range
+ */
+int
+StripDataSource_dump_sdds_range (StripDataSource        the_sds,
+  char                   *fName,
+  struct timeval         *begin,
+  struct timeval         *end)
+{
+  StripDataSourceInfo   *sds = (StripDataSourceInfo *)the_sds;
+  DumpSDDS              d;
+  int                   ret_val;
+
+  /* if no curves, return failure */
+  if (sds->n_curves == 0) return 0;
+
+  dump_sdds_layout (sds, &d.table, fName);
+  d.row = 0;
+  d.n_rows = SDS_DUMP_SDDS_ROWS;
+  if (!SDDS_StartTable (&d.table, d.n_rows))
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
+
+  ret_val = dump_table (sds, NULL, begin, end, 0, &d);
+
+  /* the table only holds the rows which were set */
+  if (!SDDS_WriteTable (&d.table))
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
+  if (!SDDS_Terminate (&d.table))
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
+
+  return ret_val;
+}
 #endif /* SDDS */
 
 
@@ -1641,128 +2234,19 @@ StripDataSource_dump    (StripDataSource        the_sds,
   FILE                   *outfile,char * cgi) /* Albert */
 {
   StripDataSourceInfo   *sds = (StripDataSourceInfo *)the_sds;
-  char                  buf[SDS_DUMP_FIELDWIDTH+1];
-  int                   i, j;
   struct timeval Start,End;
-  struct timeval StartCopy,EndCopy;
-  CurveData *cd;
-
-  struct timeval *timeP=0;
   StripGraph sg = (StripGraph) cgi; /* Albert */
 
   /* if range is not initialized, return failure  Albert not nessary for hist
      if (sds->idx_t0 == sds->idx_t1) return 0; */
 
   /* if no curves, return failure */
-  for (i = 0; i < STRIP_MAX_CURVES; i++) if (sds->buffers[i].curve) break;
-  if (i >= STRIP_MAX_CURVES) { if(DEBUG1)perror("No one curvers");return 0; }
+  if (sds->n_curves == 0) { if(DEBUG1)perror("No one curvers");return 0; }
 
   StripGraph_getattr (sg, STRIPGRAPH_BEGIN_TIME, &Start, 0);
   StripGraph_getattr (sg, STRIPGRAPH_END_TIME,   &End,   0);
 
-  memcpy(&StartCopy,&Start,sizeof(struct timeval));
-  memcpy(  &EndCopy,&End,  sizeof(struct timeval));
-
-  if(DEBUG1)printf("Start=%s",ctime((const time_t *)&(Start.tv_sec)));
-  if(DEBUG1)printf("End=%s",ctime((const time_t *)&(End.tv_sec)));
-
-  if(!cursor) cursor = XCreateFontCursor(XtDisplay(history_topShell),XC_watch);
-  XDefineCursor(XtDisplay(history_topShell),
-    XtWindow(history_topShell), cursor);
-  XFlush(XtDisplay(history_topShell));
-
-  for (i = 0; i < STRIP_MAX_CURVES; i++) {
-    if (!sds->buffers[i].curve) continue; 
-    cd = &sds->buffers[i];
-    StripHistory_fetch
-      (sds->history, cd->curve->details->name, &StartCopy, &EndCopy,
-	  &cd->history, 0, 0);
-  }
-
-  /* this is very straightforward:
-   * (a) for every curve, print out its name across the top
-   * (b) for every time on the range
-   *     (1) print out the time
-   *     (2) for every curve, print out its value
-   */
-
-  /* (a) */
-  fprintf (outfile, "%s\t", "Time");
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
-    if (sds->buffers[i].curve) fprintf(outfile, "%s [%s]\t", 
-	sds->buffers[i].curve->details->name,sds->buffers[i].curve->details->egu);
-  fprintf (outfile, "\n");
-  
-  /* (b) */
-  timeP=&StartCopy;
-
-  while(findNextTime(timeP,timeP,sds) ==0) 
-  {
-    if(compare_times(timeP,&Start)<0) continue;
-    if(compare_times(timeP,&End)>0) break;
-
-    /* (b-1) */
-    memset(buf,0,SDS_DUMP_FIELDWIDTH+1);
-    strftime(buf, SDS_DUMP_FIELDWIDTH, "%m/%d/%Y %H:%M:%S",
-	localtime ((const time_t *)&(timeP->tv_sec)));
-    fprintf (outfile, "%s.%06d\t",buf,(int)timeP->tv_usec);
-      
-    /* (b-2) */
-    for (j = 0; j < STRIP_MAX_CURVES; j++)
-	if (sds->buffers[j].curve)
-	{
-	  cd = &sds->buffers[j];
-	  memset(buf,0,SDS_DUMP_FIELDWIDTH+1);
-	  printData(timeP,cd,buf);
-	  fprintf (outfile, "%s\t",buf);
-	}
-      
-    /* finally, the end-line */
-    fprintf (outfile, "\n");
-  } /* end of history while() handeling */
-
-  
-  if(DEBUG1)printf("Start=%s",ctime((const time_t *)&(Start.tv_sec)));
-  if(DEBUG1)printf("End=%s",ctime((const time_t *)&(End.tv_sec)));
-
-  if (sds->idx_t0 != sds->idx_t1) 
-  {
-    for (i = sds->idx_t0; i != sds->idx_t1; i = (i+1) % sds->buf_size)
-    {
-	if(compare_times(&(sds->times[i]),&End)>0) 
-	{if(DEBUG1)printf("T[%d]>End   break\n",i); break;}
-	if(compare_times(&(sds->times[i]),&Start)<0) 
-	{if(DEBUG1)
-	  printf("Start > T[%d]=%s",i,ctime((const time_t *)&(sds->times[i].tv_sec))); 
-	continue;}
-	if(DEBUG1)printf("Good i=%d\n",i);
-	
-	/* (b-1) */
-	memset(buf,0,SDS_DUMP_FIELDWIDTH+1);
-	strftime(buf, SDS_DUMP_FIELDWIDTH, "%m/%d/%Y %H:%M:%S",
-	  localtime ((const time_t *)&(sds->times[i].tv_sec)));
-	fprintf (outfile, "%s.%06d\t",buf,(int)sds->times[i].tv_usec); 
-	/* (b-2) */
-	for (j = 0; j < STRIP_MAX_CURVES; j++)
-	  if (sds->buffers[j].curve)
-	  {
-	    if (sds->buffers[j].stat[i] & DATASTAT_PLOTABLE)
-		fprintf (outfile, "%g\t",sds->buffers[j].val[i]);
-	    else fprintf (outfile, "%s\t",SDS_DUMP_BADVALUESTR);
-	  }
-	
-	/* finally, the end-line */
-	fprintf (outfile, "\n");
-    }
-  } else {if(DEBUG1) perror("DUMP:NO CURRENT DATA");}
-
-
-  if(DEBUG1)printf("Last i=%d\n",i);
-
-  fflush (outfile);
-  XUndefineCursor(XtDisplay(history_topShell),
-    XtWindow(history_topShell));
-  return 1;
+  return dump_table (sds, outfile, &Start, &End, 0, NULL);
 }
 
 
@@ -1773,137 +2257,38 @@ int
 StripDataSource_dump_csv    (StripDataSource        the_sds,
   FILE                   *outfile,char * cgi)
 {
-  StripDataSourceInfo   *sds = (StripDataSourceInfo *)the_sds;
-  char                  buf[SDS_DUMP_FIELDWIDTH+1];
-  int                   i, j;
   struct timeval Start,End;
-  struct timeval StartCopy,EndCopy;
-  CurveData *cd;
-
-  struct timeval *timeP=0;
   StripGraph sg = (StripGraph) cgi;
 
-  /* if range is not initialized, return failure 
-     if (sds->idx_t0 == sds->idx_t1) return 0; */
-
-  /* if no curves, return failure */
-  for (i = 0; i < STRIP_MAX_CURVES; i++) if (sds->buffers[i].curve) break;
-  if (i >= STRIP_MAX_CURVES) { if(DEBUG1)perror("No one curvers");return 0; }
-
   StripGraph_getattr (sg, STRIPGRAPH_BEGIN_TIME, &Start, 0);
   StripGraph_getattr (sg, STRIPGRAPH_END_TIME,   &End,   0);
 
-  memcpy(&StartCopy,&Start,sizeof(struct timeval));
-  memcpy(  &EndCopy,&End,  sizeof(struct timeval));
-
-  if(DEBUG1)printf("Start=%s",ctime(&(Start.tv_sec)));
-  if(DEBUG1)printf("End=%s",ctime(&(End.tv_sec)));
-
-  if(!cursor) cursor = XCreateFontCursor(XtDisplay(history_topShell),XC_watch);
-  XDefineCursor(XtDisplay(history_topShell),
-    XtWindow(history_topShell), cursor);
-  XFlush(XtDisplay(history_topShell));
-
-  for (i = 0; i < STRIP_MAX_CURVES; i++) {
-    if (!sds->buffers[i].curve) continue; 
-    cd = &sds->buffers[i];
-    StripHistory_fetch
-      (sds->history, cd->curve->details->name, &StartCopy, &EndCopy,
-	  &cd->history, 0, 0);
-  }
-
-  /* this is very straightforward:
-   * (a) for every curve, print out its name across the top
-   * (b) for every time on the range
-   *     (1) print out the time
-   *     (2) for every curve, print out its value
-   */
-
-  /* (a) */
-  /* (a) */
-  fprintf (outfile, "%s", "Time");
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
-    if (sds->buffers[i].curve) fprintf(outfile, ",%s [%s]", 
-	sds->buffers[i].curve->details->name,sds->buffers[i].curve->details->egu);
-  fprintf (outfile, "\n");
-  
-  /* (b) */
-  timeP=&StartCopy;
-
-  while(findNextTime(timeP,timeP,sds) ==0) 
-  {
-    if(compare_times(timeP,&Start)<0) continue;
-    if(compare_times(timeP,&End)>0) break;
-
-    /* (b-1) */
-    memset(buf,0,SDS_DUMP_FIELDWIDTH+1);
-    strftime(buf, SDS_DUMP_FIELDWIDTH, "%m/%d/%Y,%H:%M:%S",
-	localtime (&(timeP->tv_sec)));
-    fprintf (outfile, "%s.%06d",buf,(int)timeP->tv_usec);
-      
-    /* (b-2) */
-    for (j = 0; j < STRIP_MAX_CURVES; j++)
-	if (sds->buffers[j].curve)
-	{
-	  cd = &sds->buffers[j];
-	  memset(buf,0,SDS_DUMP_FIELDWIDTH+1);
-	  printData(timeP,cd,buf);
-	  fprintf (outfile, ",%s",buf);
-	}
-      
-    /* finally, the end-line */
-    fprintf (outfile, "\n");
-  } /* end of history while() handeling */
-
-  
-  if(DEBUG1)printf("Start=%s",ctime(&(Start.tv_sec)));
-  if(DEBUG1)printf("End=%s",ctime(&(End.tv_sec)));
+  return StripDataSource_dump_csv_range (the_sds, outfile, &Start, &End);
+}
 
-  if (sds->idx_t0 != sds->idx_t1) 
-  {
-    for (i = sds->idx_t0; i != sds->idx_t1; i = (i+1) % sds->buf_size)
-    {
-	if(compare_times(&(sds->times[i]),&End)>0) 
-	{if(DEBUG1)printf("T[%d]>End   break\n",i); break;}
-	if(compare_times(&(sds->times[i]),&Start)<0) 
-	{if(DEBUG1)
-	  printf("Start > T[%d]=%s",i,ctime(&(sds->times[i].tv_sec))); 
-	continue;}
-	if(DEBUG1)printf("Good i=%d\n",i);
-	
-	/* (b-1) */
-	memset(buf,0,SDS_DUMP_FIELDWIDTH+1);
-	strftime(buf, SDS_DUMP_FIELDWIDTH, "%m/%d/%Y %H:%M:%S",
-	  localtime (&(sds->times[i].tv_sec)));
-	fprintf (outfile, "%s.%06d",buf,(int)sds->times[i].tv_usec); 
-	/* (b-2) */
-	for (j = 0; j < STRIP_MAX_CURVES; j++)
-	  if (sds->buffers[j].curve)
-	  {
-	    if (sds->buffers[j].stat[i] & DATASTAT_PLOTABLE)
-		fprintf (outfile, ",%g",sds->buffers[j].val[i]);
-	    else fprintf (outfile, ",%s",SDS_DUMP_BADVALUESTR);
-	  }
-	
-	/* finally, the end-line */
-	fprintf (outfile, "\n");
-    }
-  } else {if(DEBUG1) perror("DUMP:NO CURRENT DATA");}
 
+/*
+ * StripDataSource_dump_csv_range
+ */
+int
+StripDataSource_dump_csv_range  (StripDataSource        the_sds,
+  FILE                   *outfile,
+  struct timeval         *begin,
+  struct timeval         *end)
+{
+  StripDataSourceInfo   *sds = (StripDataSourceInfo *)the_sds;
 
-  if(DEBUG1)printf("Last i=%d\n",i);
+  /* if no curves, return failure */
+  if (sds->n_curves == 0) { if(DEBUG1)perror("No one curvers");return 0; }
 
-  fflush (outfile);
-  XUndefineCursor(XtDisplay(history_topShell),
-    XtWindow(history_topShell));
-  return 1;
+  return dump_table (sds, outfile, begin, end, 1, NULL);
 }
 
 
 /* ====== Static Functions ====== */
 static long
-find_date_idx   (struct timeval         *t,
-  struct timeval         *times,
+find_date_idx   (sdsTime                t,
+  sdsTime                *times,
   size_t                 n_times,
   size_t                 max_times,
   size_t                 idx_latest,
@@ -1922,7 +2307,7 @@ find_date_idx   (struct timeval         *t,
   /* first check boundary conditions */
   if (mode == SDS_LTE)
   {
-    x = compare_times (&times[a], t);
+    x = compare_sds (times[a], t);
     if (x > 0)
       return -1;
     else if (x == 0)    /* hey, we found it! */
@@ -1930,7 +2315,7 @@ find_date_idx   (struct timeval         *t,
   }
   else if (mode == SDS_GTE)
   {
-    x = compare_times (&times[b], t);
+    x = compare_sds (times[b], t);
     if (x < 0)
       return -1;
     else if (x == 0)    /* hey, we found it! */
@@ -1943,7 +2328,7 @@ find_date_idx   (struct timeval         *t,
   {
     /* the buffer wraps around --determine whether t lies btw a and n,
      * or 0 and b */
-    x = compare_times (t, &times[max_times-1]);
+    x = compare_sds (t, times[max_times-1]);
     if (x < 0)
       b = (long)max_times-1;
     else if (x > 0)
@@ -1955,7 +2340,7 @@ find_date_idx   (struct timeval         *t,
   /* now do a binary search */
   do {
     i = a + ((b-a)/2);
-    x = compare_times (&times[i], t);
+    x = compare_sds (times[i], t);
 
     if (x > 0)
       b = i-1;
@@ -1995,6 +2380,8 @@ resize  (StripDataSourceInfo *sds, size_t buf_size)
   int                   ret_val = 0;
   
   int                   new_index;
+  size_t                *age = NULL;
+  CurveData             *cd;
 
     
 #if DEBUG_SDS_TIMES
@@ -2004,28 +2391,41 @@ resize  (StripDataSourceInfo *sds, size_t buf_size)
   
   if (sds->buf_size == 0)
   {
-    sds->times = (struct timeval *)malloc
-      (buf_size * sizeof(struct timeval));
+    sds->times = (sdsTime *)malloc (buf_size * sizeof(sdsTime));
     new_index = new_count = 0;
     ret_val = (sds->times != NULL);
   }
   else
   {
+#ifdef STRIP_SAMPLE_STORE
+    /* the oldest samples may not fit, so put them in the store first */
+    for (i = 0; i + (int)buf_size < sds->count; i++)
+      store_spill
+        (sds, (sds->cur_idx + sds->buf_size - sds->count + 1 + i) %
+         sds->buf_size);
+#endif
+    /* each curve's first sample, by how far back it is */
+    if (sds->n_curves > 0)
+      age = (size_t *)malloc (sds->n_curves * sizeof (size_t));
+    for (i = 0; age && (i < sds->n_curves); i++)
+      if ((age[i] = sds->curves[i]->first) != SIZE_MAX)
+        age[i] = (sds->cur_idx + sds->buf_size - age[i]) % sds->buf_size;
+    
     ret_val = pack_array
-      ((void **)&sds->times, sizeof(struct timeval),
+      ((void **)&sds->times, sizeof(sdsTime),
 	  sds->buf_size, sds->cur_idx, sds->count,
 	  buf_size, &new_index, &new_count);
     if (ret_val)
-      for (i = 0; i < STRIP_MAX_CURVES; i++)
-        if (sds->buffers[i].val)
+      for (i = 0; i < sds->n_curves; i++)
+        if (sds->curves[i]->val)
         {
           ret_val = pack_array
-            ((void **)&sds->buffers[i].val, sizeof(double),
+            ((void **)&sds->curves[i]->val, sizeof(double),
 		  sds->buf_size, sds->cur_idx, sds->count,
 		  buf_size, 0, 0);
           if (ret_val)
             ret_val = pack_array
-              ((void **)&sds->buffers[i].stat, sizeof (StatusType),
+              ((void **)&sds->curves[i]->stat, sizeof (StatusType),
 		    sds->buf_size, sds->cur_idx, sds->count,
 		    buf_size, 0, 0);
           if (!ret_val) break;
@@ -2036,7 +2436,21 @@ resize  (StripDataSourceInfo *sds, size_t buf_size)
     sds->buf_size = buf_size;
     sds->cur_idx = new_index;
     sds->count = new_count;
+
+    /* the samples have moved, so the summaries must be rebuilt, and the
+     * first samples found again (or the oldest, if they are gone) */
+    for (i = 0; i < sds->n_curves; i++)
+    {
+      cd = sds->curves[i];
+      if (age && (age[i] != SIZE_MAX))
+        cd->first =
+          (new_index + buf_size - min (age[i], (size_t)new_count - 1)) %
+          buf_size;
+      if (cd->val)
+        mm_build (sds, cd);
+    }
   }
+  if (age) free (age);
   return ret_val;
 }
 
@@ -2100,78 +2514,2163 @@ pack_array      (void   **p,    /* address of pointer */
 }
 
 
-static int
-verify_render_buffer    (RenderBuffer *rbuf, int n)
+/* fetch_history
+ *
+ *      Requests history data for the curve on [t0, t1], then keeps a
+ *      copy of the resulting time stamps in the data source's own time
+ *      representation, which is what render() and friends search.
+ *
+ *      If a callback is given, the history module may return
+ *      FETCH_PENDING, in which case the callback takes over when the
+ *      data comes in.  With history_joined(), the caller is expected to
+ *      collect the data with StripHistory_wait().
+ */
+static FetchStatus
+fetch_history   (StripDataSourceInfo    *sds,
+                 CurveData              *cd,
+                 struct timeval         *t0,
+                 struct timeval         *t1,
+                 StripHistoryCallback   callback)
 {
-  XSegment      *s;
-  int           ret = 1;
+  FetchStatus   ret;
+
+  ret = StripHistory_fetch
+    (sds->history, cd->curve->details->name, t0, t1, &cd->history,
+     callback, callback? (void *)sds : 0);
+
+  if (ret == FETCH_PENDING)
+    return ret;
   
-  if (rbuf->max_segs < n)
-  {
-    if (!rbuf->segs)
-      s = (XSegment *)malloc (n * sizeof (XSegment));
-    else s = (XSegment *)realloc (rbuf->segs, n * sizeof (XSegment));
+  convert_history (cd);
+  return ret;
+}
 
-    if (s)
+
+/* convert_history
+ *
+ *      Called once a history result has been filled in.  Converts its
+ *      time stamps and drops the cached extrema.
+ */
+static FetchStatus
+convert_history (CurveData *cd)
+{
+  sdsTime       *p;
+  int           i;
+
+  cd->hmm_idx[0] = -1;
+  cd->hr_bucket = 0;
+  cd->zs_pre_stale = True;
+
+  if ((cd->history.fetch_stat == FETCH_DONE) && (cd->history.n_points > 0))
+  {
+    p = (sdsTime *)realloc (cd->htimes, cd->history.n_points * sizeof(sdsTime));
+    if (!p)
     {
-      rbuf->segs = s;
-      rbuf->max_segs = n;
+      fprintf
+        (stderr,
+         "StripDataSource_fetch_history():\n"
+         "  memory exhausted, ignoring history data for %s\n",
+         cd->curve->details->name);
+      cd->history.fetch_stat = FETCH_NODATA;
+      return FETCH_NODATA;
     }
-    else ret = 0;
+    cd->htimes = p;
+    for (i = 0; i < cd->history.n_points; i++)
+      cd->htimes[i] = time2sds (&cd->history.times[i]);
   }
 
-  return ret;
+  return cd->history.fetch_stat;
 }
 
 
-/* static function for HistoryDump: Albert */
-static int findNextTime (struct timeval *tv,struct timeval *result,StripDataSourceInfo *sds)
+/* history_arrived
+ *
+ *      StripHistoryCallback for asynchronous fetches.  The new data can
+ *      only be shown by a complete refresh, so the client is told, but
+ *      only once the history for all curves is in.
+ */
+static void
+history_arrived (StripHistoryResult *result, void *data)
 {
-  CurveData *cd;
-  int m,i;
-  int first=1;
+  StripDataSourceInfo   *sds = (StripDataSourceInfo *)data;
+  int                   i;
 
-  for (m = 0; m < STRIP_MAX_CURVES; m++)
-  {
-    if (sds->buffers[m].curve == NULL) continue;
-    cd = &sds->buffers[m];
-    if(cd->history.n_points<1) continue;
-    if(cd->history.fetch_stat!=FETCH_DONE){perror("FETCH_DONE!"); continue;}
+  history_joined (result, data);
 
-    for(i=0;i<cd->history.n_points;i++) 
+  for (i = 0; i < sds->n_curves; i++)
+    if (sds->curves[i]->history.fetch_stat == FETCH_PENDING)
+      return;
+  
+  if (sds->history_func)
+    sds->history_func (sds->history_data);
+}
+
+
+/* history_joined
+ *
+ *      StripHistoryCallback for fetches collected by StripHistory_wait().
+ */
+static void
+history_joined  (StripHistoryResult *result, void *data)
+{
+  StripDataSourceInfo   *sds = (StripDataSourceInfo *)data;
+  int                   i;
+
+  for (i = 0; i < sds->n_curves; i++)
+    if (&sds->curves[i]->history == result)
     {
-	if( compare_times(&(cd->history.times[i]),tv) >0) {
-	  if (first) {
-	    first=0;
-	    result->tv_sec= (cd->history.times[i]).tv_sec;
-	    result->tv_usec=(cd->history.times[i]).tv_usec;
-	    continue;
-	  }
-	  if(compare_times(&(cd->history.times[i]),result)<0) { 
-	    result->tv_sec= (cd->history.times[i]).tv_sec;
-	    result->tv_usec=(cd->history.times[i]).tv_usec;
-	  }
-	}
+      convert_history (sds->curves[i]);
+      break;
     }
+}
+
+
+/* prefetch_arrived
+ *
+ *      StripHistoryCallback for prefetches.  The data is in the history
+ *      cache by now, which is all that was wanted, so the result lets go
+ *      of it at once.
+ */
+static void
+prefetch_arrived        (StripHistoryResult *result, void *data)
+{
+  StripDataSourceInfo   *sds = (StripDataSourceInfo *)data;
+
+  StripHistoryResult_release (sds->history, result);
+  result->fetch_stat = FETCH_IDLE;
+}
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * history reduction routines
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifdef STRIP_ASYNC_HISTORY
+/* ReduceJob
+ *
+ *      The curves to be reduced, handed out one at a time to the
+ *      threads working on them.
+ */
+typedef struct          _ReduceJob
+{
+  StripDataSourceInfo   *sds;
+  sdsTime               bucket;
+  int                   method;
+  int                   next;
+  pthread_mutex_t       lock;
+}
+ReduceJob;
+#endif
+
+
+/* reduce_curves
+ *
+ *      Decides for each curve whether its history result is to be
+ *      reduced for the given bins, and brings the reduced copies up to
+ *      date.  The history module keeps the raw result, so that it can
+ *      be reduced again for other bins.
+ */
+static void
+reduce_curves   (StripDataSourceInfo *sds, double bin_size, int n_bins)
+{
+  CurveData     *cd;
+  sdsTime       bucket = dbl2sds (bin_size);
+  int           method = SDS_REDUCE_MINMAX;
+  int           i, n_work = 0;
+#ifdef STRIP_ASYNC_HISTORY
+  ReduceJob     job;
+  pthread_t     threads[STRIP_HISTORY_THREADS];
+  int           n_threads;
+#endif
+
+#ifdef USE_CAR
+  /* the server does its own reductions, otherwise */
+  if ((radioBoxAlgorithm >= 0) && (radioBoxAlgorithm < SDS_REDUCE_LAST))
+    method = (int)radioBoxAlgorithm;
+#endif
+
+  for (i = 0; i < sds->n_curves; i++)
+  {
+    cd = sds->curves[i];
+    cd->hr_active =
+      ((cd->history.fetch_stat == FETCH_DONE) &&
+       (method != SDS_REDUCE_RAW) && (bucket > 0) &&
+       (cd->history.n_points > SDS_REDUCE_RATIO * n_bins));
+    if (cd->hr_active &&
+        ((cd->hr_bucket != bucket) || (cd->hr_method != method)))
+      n_work++;
+  }
+  if (n_work == 0) return;
+
+#ifdef STRIP_ASYNC_HISTORY
+  if (n_work > 1)
+  {
+    job.sds = sds;
+    job.bucket = bucket;
+    job.method = method;
+    job.next = 0;
+    pthread_mutex_init (&job.lock, NULL);
+
+    /* this thread does its share too */
+    for (n_threads = 0;
+         (n_threads < STRIP_HISTORY_THREADS) && (n_threads < n_work - 1);
+         n_threads++)
+      if (pthread_create
+          (&threads[n_threads], NULL, reduce_thread, (void *)&job) != 0)
+        break;
+    reduce_thread ((void *)&job);
+    for (i = 0; i < n_threads; i++)
+      pthread_join (threads[i], NULL);
+    
+    pthread_mutex_destroy (&job.lock);
+    return;
   }
+#endif
 
-  return(first);
+  for (i = 0; i < sds->n_curves; i++)
+  {
+    cd = sds->curves[i];
+    if (cd->hr_active &&
+        ((cd->hr_bucket != bucket) || (cd->hr_method != method)))
+      cd->hr_active = reduce_history (cd, bucket, method);
+  }
 }
 
-static int printData(struct timeval *time, CurveData *cd, char *val)
+
+#ifdef STRIP_ASYNC_HISTORY
+/* reduce_thread
+ *
+ *      Reduces curves until there are none left.  Each curve is only
+ *      touched by the thread which took it.
+ */
+static void *
+reduce_thread   (void *arg)
 {
-  int i;
-  short first=1;
-  for(i=0;i<cd->history.n_points;i++) 
+  ReduceJob     *job = (ReduceJob *)arg;
+  CurveData     *cd;
+  int           i;
+
+  for (;;)
   {
-    if(!compare_times(&(cd->history.times[i]),time)) {
-	first=0;
-	sprintf(val,"%g",cd->history.data[i]);
-    }
+    pthread_mutex_lock (&job->lock);
+    i = job->next++;
+    pthread_mutex_unlock (&job->lock);
+    if (i >= job->sds->n_curves) break;
+    
+    cd = job->sds->curves[i];
+    if (cd->hr_active &&
+        ((cd->hr_bucket != job->bucket) || (cd->hr_method != job->method)))
+      cd->hr_active = reduce_history (cd, job->bucket, job->method);
   }
-  if(first) sprintf(val,"%s","N/A");
-  return(first);    
+  
+  return NULL;
+}
+#endif
+
+
+/* reduce_history
+ *
+ *      Reduces the curve's history result into its hr_ arrays, by the
+ *      given method, with bins of the given width.  The bins are aligned
+ *      on whole multiples of the width rather than on the plot, so that
+ *      the copy stays good while the plot scrolls.  Unplotable points
+ *      are kept (once per gap), and end the bin they fall into.  LTTB
+ *      also keeps the first and last point of each run of plotable
+ *      points, and picks, in every other bin, the point making the
+ *      largest triangle with the point picked before and the mean of
+ *      the next bin.  Every input point is looked at no more than twice.
+ *
+ *      Returns false if there is not enough memory.
+ */
+static int
+reduce_history  (CurveData *cd, sdsTime bucket, int method)
+{
+  sdsTime       *times = cd->htimes;
+  double        *val = cd->history.data;
+  short         *stat = cd->history.status;
+  int           n = cd->history.n_points;
+  int           i, j, k, m, lo, hi, first_bin, pick;
+  double        sum, area, best, tc, vc, ta, va;
+  int           anchor = -1;
+  size_t        new_size;
+  void          *p;
+
+#define RH_PLOTABLE(I)  (stat[I] & DATASTAT_PLOTABLE)
+#define RH_BIN_END(I,J)                                                 \
+  do {                                                                  \
+    for ((J) = (I) + 1;                                                 \
+         ((J) < n) && RH_PLOTABLE (J) &&                                \
+           (times[J] / bucket == times[I] / bucket);                    \
+         (J)++);                                                        \
+  } while (0)
+#define RH_GROW()                                                       \
+  do {                                                                  \
+    if (cd->hr_n >= cd->hr_size)                                        \
+    {                                                                   \
+      new_size = cd->hr_size? 2 * cd->hr_size : 1024;                   \
+      if (!(p = realloc (cd->hr_times, new_size * sizeof (sdsTime))))   \
+        goto nomem;                                                     \
+      cd->hr_times = (sdsTime *)p;                                      \
+      if (!(p = realloc (cd->hr_val, new_size * sizeof (double))))      \
+        goto nomem;                                                     \
+      cd->hr_val = (double *)p;                                         \
+      if (!(p = realloc (cd->hr_stat, new_size * sizeof (StatusType)))) \
+        goto nomem;                                                     \
+      cd->hr_stat = (StatusType *)p;                                    \
+      cd->hr_size = new_size;                                           \
+    }                                                                   \
+  } while (0)
+#define RH_EMIT(T,V,S)                                                  \
+  do {                                                                  \
+    RH_GROW();                                                          \
+    cd->hr_times[cd->hr_n] = (T);                                       \
+    cd->hr_val[cd->hr_n] = (V);                                         \
+    cd->hr_stat[cd->hr_n] = (S);                                        \
+    cd->hr_n++;                                                         \
+  } while (0)
+#define RH_EMIT_IDX(I)  RH_EMIT (times[I], val[I], stat[I])
+
+  cd->hr_n = 0;
+  cd->hr_bucket = 0;
+  first_bin = 1;
+  
+  for (i = 0; i < n; i = j)
+  {
+    if (!RH_PLOTABLE (i))
+    {
+      if ((cd->hr_n == 0) || (cd->hr_stat[cd->hr_n-1] & DATASTAT_PLOTABLE))
+        RH_EMIT_IDX (i);
+      j = i + 1;
+      first_bin = 1;
+      continue;
+    }
+
+    /* the bin is [i, j) */
+    RH_BIN_END (i, j);
+    
+    switch (method)
+    {
+        case SDS_REDUCE_AVERAGE:
+          for (k = i, sum = 0; k < j; k++) sum += val[k];
+          RH_EMIT
+            (times[i] + (times[j-1] - times[i]) / 2, sum / (j - i), stat[i]);
+          break;
+          
+        case SDS_REDUCE_SHARP:
+          RH_EMIT_IDX (j-1);
+          break;
+
+        case SDS_REDUCE_LTTB:
+          /* first and last bins of the run keep their end points */
+          if (first_bin || (j >= n) || !RH_PLOTABLE (j))
+          {
+            if (first_bin) RH_EMIT_IDX (i);
+            if ((j >= n) || !RH_PLOTABLE (j))
+              if (!first_bin || (j - 1 > i)) RH_EMIT_IDX (j-1);
+            anchor = first_bin? i : j-1;
+            break;
+          }
+          
+          /* mean of the next bin */
+          RH_BIN_END (j, m);
+          for (k = j, tc = vc = 0; k < m; k++)
+          {
+            tc += sds2dbl (times[k] - times[anchor]);
+            vc += val[k];
+          }
+          tc /= (m - j);
+          vc /= (m - j);
+
+          ta = 0;
+          va = val[anchor];
+          pick = i;
+          best = -1;
+          for (k = i; k < j; k++)
+          {
+            area = (ta - tc) * (val[k] - va) -
+              (ta - sds2dbl (times[k] - times[anchor])) * (vc - va);
+            if (area < 0) area = -area;
+            if (area > best)
+            {
+              best = area;
+              pick = k;
+            }
+          }
+          RH_EMIT_IDX (pick);
+          anchor = pick;
+          break;
+          
+        case SDS_REDUCE_MINMAX:
+        default:
+          for (k = lo = hi = i; k < j; k++)
+          {
+            if (val[k] < val[lo]) lo = k;
+            if (val[k] > val[hi]) hi = k;
+          }
+          if (hi < lo) { k = lo; lo = hi; hi = k; }
+          RH_EMIT_IDX (i);
+          if (lo > i) RH_EMIT_IDX (lo);
+          if ((hi > lo) && (hi > i)) RH_EMIT_IDX (hi);
+          if ((j-1 > hi) && (j-1 > i)) RH_EMIT_IDX (j-1);
+          break;
+    }
+    first_bin = 0;
+  }
+
+  cd->hr_bucket = bucket;
+  cd->hr_method = method;
+  cd->zs_pre_stale = True;
+  return 1;
+
+  nomem:
+  fprintf
+    (stderr,
+     "StripDataSource_init_range():\n"
+     "  unable to reduce history data for %s, rendering will be slower\n",
+     cd->curve->details->name);
+  reduce_free (cd);
+  return 0;
+
+#undef RH_EMIT_IDX
+#undef RH_EMIT
+#undef RH_GROW
+#undef RH_BIN_END
+#undef RH_PLOTABLE
+}
+
+
+/* reduce_free
+ */
+static void
+reduce_free     (CurveData *cd)
+{
+  if (cd->hr_times) free (cd->hr_times);
+  if (cd->hr_val) free (cd->hr_val);
+  if (cd->hr_stat) free (cd->hr_stat);
+  cd->hr_times = NULL;
+  cd->hr_val = NULL;
+  cd->hr_stat = NULL;
+  cd->hr_n = cd->hr_size = 0;
+  cd->hr_bucket = 0;
+  cd->hr_active = False;
+}
+
+
+#ifdef STRIP_SAMPLE_STORE
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * compressed sample store routines
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* store_spill
+ *
+ *      Called before the ring buffer slot is overwritten, to move each
+ *      curve's sample there into its store.  A curve's samples are taken
+ *      from its first one on, but not in monitor mode, where the curve's
+ *      own time line holds the data.
+ */
+static void
+store_spill     (StripDataSourceInfo *sds, size_t slot)
+{
+  CurveData     *cd;
+  int           i;
+
+  for (i = 0; i < sds->n_curves; i++)
+  {
+    cd = sds->curves[i];
+    if ((cd->first == SIZE_MAX) || SDS_MONITORED (cd)) continue;
+    if (cd->zs_last || (slot == cd->first))
+      store_append (cd, sds->times[slot], cd->val[slot], cd->stat[slot]);
+  }
+}
+
+
+/* store_append
+ *
+ *      Adds a sample to the newest block, or starts a new one if it
+ *      might not fit, dropping the oldest block if the store is full.
+ *      Samples must come in time order, and any others are ignored.
+ *
+ *      Time: '0' if the interval is unchanged, otherwise '10', '110',
+ *      '1110' or '1111', followed by the change in 10, 18, 28 or 64 bits.
+ *      Value: '0' if unchanged, '10' followed by the XOR's bits within
+ *      the previous XOR's significant ones, or '11', 6 bits of leading
+ *      zeros, 6 bits of the number of significant bits less one, and
+ *      these bits.  Status: '0' if unchanged, or '1' and 16 bits.
+ */
+static void
+store_append    (CurveData *cd, sdsTime t, double v, StatusType s)
+{
+  static int    dod_bits[] = {10, 18, 28};
+  SampleBlock   *b = cd->zs_last;
+  StoreWord     w, x;
+  sdsTime       us, delta, dod;
+  int           lead, trail, i;
+
+  if (b && (t <= b->t1)) return;
+
+  if (!b || (b->n_bits + SDS_STORE_MAX_SAMPLE_BITS > 8 * SDS_STORE_BLOCK_BYTES))
+  {
+    if (cd->zs_first && (cd->zs_blocks >= SDS_STORE_MAX_BLOCKS))
+    {
+      b = cd->zs_first;
+      cd->zs_first = b->next;
+      if (!cd->zs_first) cd->zs_last = NULL;
+      cd->zs_blocks--;
+      memset (b, 0, sizeof (SampleBlock));
+    }
+    else if (!(b = (SampleBlock *)calloc (1, sizeof (SampleBlock))))
+      return;
+
+    b->t0 = b->t1 = t;
+    b->v0 = v;
+    b->s0 = b->last_s = s;
+    b->n = 1;
+    b->last_us = t / 1000;
+    memcpy (&b->last_v, &v, sizeof (StoreWord));
+    b->lead = -1;
+    if (cd->zs_last) cd->zs_last->next = b;
+    else cd->zs_first = b;
+    cd->zs_last = b;
+    cd->zs_blocks++;
+    return;
+  }
+
+  /* time */
+  us = t / 1000;
+  delta = us - b->last_us;
+  dod = delta - b->last_delta;
+  if (dod == 0)
+    store_put (b, 0, 1);
+  else
+  {
+    for (i = 0; i < 3; i++)
+      if ((dod >= -((sdsTime)1 << (dod_bits[i] - 1))) &&
+          (dod < ((sdsTime)1 << (dod_bits[i] - 1))))
+        break;
+    if (i == 3)
+    {
+      store_put (b, 15, 4);
+      store_put (b, (StoreWord)dod, 64);
+    }
+    else
+    {
+      store_put (b, ((StoreWord)1 << (i + 2)) - 2, i + 2);      /* 1..10 */
+      store_put
+        (b, (StoreWord)dod & (((StoreWord)1 << dod_bits[i]) - 1),
+         dod_bits[i]);
+    }
+  }
+  b->last_us = us;
+  b->last_delta = delta;
+
+  /* value */
+  memcpy (&w, &v, sizeof (StoreWord));
+  x = w ^ b->last_v;
+  if (x == 0)
+    store_put (b, 0, 1);
+  else
+  {
+    for (lead = 0; !(x & ((StoreWord)1 << (63 - lead))); lead++);
+    for (trail = 0; !(x & ((StoreWord)1 << trail)); trail++);
+    if ((b->lead >= 0) && (lead >= b->lead) && (trail >= b->trail))
+    {
+      store_put (b, 2, 2);
+      store_put (b, x >> b->trail, 64 - b->lead - b->trail);
+    }
+    else
+    {
+      store_put (b, 3, 2);
+      store_put (b, (StoreWord)lead, 6);
+      store_put (b, (StoreWord)(63 - lead - trail), 6);
+      store_put (b, x >> trail, 64 - lead - trail);
+      b->lead = lead;
+      b->trail = trail;
+    }
+  }
+  b->last_v = w;
+
+  /* status */
+  if (s == b->last_s)
+    store_put (b, 0, 1);
+  else
+  {
+    store_put (b, 1, 1);
+    store_put (b, (StoreWord)(unsigned short)s, 16);
+    b->last_s = s;
+  }
+
+  b->t1 = t;
+  b->n++;
+}
+
+
+/* store_put
+ *
+ *      Appends the low n bits of w to the block, most significant first,
+ *      a byte at a time where possible.
+ */
+static void
+store_put       (SampleBlock *b, StoreWord w, int n)
+{
+  int   off, k;
+
+  while (n > 0)
+  {
+    off = (int)(b->n_bits & 7);
+    k = min (8 - off, n);
+    n -= k;
+    b->bits[b->n_bits >> 3] |=
+      (unsigned char)(((unsigned)(w >> n) & ((1u << k) - 1)) << (8 - off - k));
+    b->n_bits += k;
+  }
+}
+
+
+/* store_get
+ *
+ *      Reads n bits of the block from the given bit position on, and
+ *      moves the position past them.
+ */
+static StoreWord
+store_get       (SampleBlock *b, size_t *pos, int n)
+{
+  StoreWord     w = 0;
+  int           off, k;
+
+  while (n > 0)
+  {
+    off = (int)(*pos & 7);
+    k = min (8 - off, n);
+    n -= k;
+    w = (w << k) |
+      ((StoreWord)(b->bits[*pos >> 3] >> (8 - off - k)) & ((1u << k) - 1));
+    *pos += k;
+  }
+  return w;
+}
+
+
+/* store_grow
+ *
+ *      Makes room for n points in the zs arrays.
+ */
+static int
+store_grow      (CurveData *cd, size_t n)
+{
+  size_t        new_size;
+  void          *p;
+
+  if (n <= cd->zs_size) return 1;
+
+  new_size = cd->zs_size? 2 * cd->zs_size : 1024;
+  if (new_size < n) new_size = n;
+  if (!(p = realloc (cd->zs_times, new_size * sizeof (sdsTime))))
+    return 0;
+  cd->zs_times = (sdsTime *)p;
+  if (!(p = realloc (cd->zs_val, new_size * sizeof (double))))
+    return 0;
+  cd->zs_val = (double *)p;
+  if (!(p = realloc (cd->zs_stat, new_size * sizeof (StatusType))))
+    return 0;
+  cd->zs_stat = (StatusType *)p;
+  cd->zs_size = new_size;
+  return 1;
+}
+
+
+/* store_decode
+ *
+ *      Decodes the block's samples into the zs arrays from index at on,
+ *      either all of them, or only those not decoded before (see
+ *      SampleBlock).  The arrays must have room.  Returns the number of
+ *      samples written.
+ */
+static size_t
+store_decode    (CurveData *cd, SampleBlock *b, size_t at, int restart)
+{
+  static int    dod_bits[] = {10, 18, 28, 64};
+  sdsTime       dod;
+  StoreWord     x;
+  double        v;
+  size_t        n = at;
+  int           k;
+
+  if (restart || (b->dec_n == 0))
+  {
+    cd->zs_times[n] = b->t0;
+    cd->zs_val[n] = b->v0;
+    cd->zs_stat[n] = b->s0;
+    n++;
+    b->dec_n = 1;
+    b->dec_pos = 0;
+    b->dec_us = b->t0 / 1000;
+    b->dec_delta = 0;
+    memcpy (&b->dec_w, &b->v0, sizeof (StoreWord));
+    b->dec_lead = b->dec_trail = 0;
+    b->dec_s = b->s0;
+  }
+
+  for (; b->dec_n < b->n; b->dec_n++)
+  {
+    /* time */
+    for (k = 0; (k < 4) && store_get (b, &b->dec_pos, 1); k++);
+    if (k > 0)
+    {
+      dod = (sdsTime)store_get (b, &b->dec_pos, dod_bits[k-1]);
+      if ((k < 4) && (dod & ((sdsTime)1 << (dod_bits[k-1] - 1))))
+        dod -= (sdsTime)1 << dod_bits[k-1];             /* negative */
+      b->dec_delta += dod;
+    }
+    b->dec_us += b->dec_delta;
+
+    /* value */
+    if (store_get (b, &b->dec_pos, 1))
+    {
+      if (store_get (b, &b->dec_pos, 1))
+      {
+        b->dec_lead = (int)store_get (b, &b->dec_pos, 6);
+        b->dec_trail = 63 - b->dec_lead - (int)store_get (b, &b->dec_pos, 6);
+      }
+      x = store_get (b, &b->dec_pos, 64 - b->dec_lead - b->dec_trail);
+      b->dec_w ^= x << b->dec_trail;
+    }
+
+    /* status */
+    if (store_get (b, &b->dec_pos, 1))
+      b->dec_s = (StatusType)store_get (b, &b->dec_pos, 16);
+
+    memcpy (&v, &b->dec_w, sizeof (double));
+    cd->zs_times[n] = b->dec_us * 1000;
+    cd->zs_val[n] = v;
+    cd->zs_stat[n] = b->dec_s;
+    n++;
+  }
+
+  return n - at;
+}
+
+
+/* store_history
+ *
+ *      Puts the curve's history (reduced, if it is, and up to date) from
+ *      before the oldest stored sample ahead of the decoded samples, if
+ *      it has changed.  Returns false if there is not enough memory.
+ */
+static int
+store_history   (CurveData *cd)
+{
+  sdsTime       *times = NULL;
+  double        *vals = NULL;
+  StatusType    *stats = NULL;
+  size_t        n = 0, m = 0, n_dec;
+  long          i;
+
+  if (cd->history.fetch_stat == FETCH_DONE)
+  {
+    if (cd->hr_active && cd->hr_bucket)
+    {
+      times = cd->hr_times;
+      vals = cd->hr_val;
+      stats = cd->hr_stat;
+      n = cd->hr_n;
+    }
+    else if (cd->htimes)
+    {
+      times = cd->htimes;
+      vals = cd->history.data;
+      stats = cd->history.status;
+      n = cd->history.n_points;
+    }
+  }
+  if (!cd->zs_pre_stale && (times == cd->zs_pre_src) &&
+      (cd->zs_pre_end == cd->zs_first->t0))
+    return 1;
+
+  if (n > 0)
+  {
+    i = find_date_idx (cd->zs_first->t0 - 1, times, n, n, n - 1, SDS_LTE);
+    m = (size_t)(i + 1);
+  }
+  n_dec = cd->zs_n - cd->zs_pre;
+  if (!store_grow (cd, m + n_dec)) return 0;
+
+  if ((m != cd->zs_pre) && (n_dec > 0))
+  {
+    memmove (cd->zs_times + m, cd->zs_times + cd->zs_pre,
+             n_dec * sizeof (sdsTime));
+    memmove (cd->zs_val + m, cd->zs_val + cd->zs_pre,
+             n_dec * sizeof (double));
+    memmove (cd->zs_stat + m, cd->zs_stat + cd->zs_pre,
+             n_dec * sizeof (StatusType));
+  }
+  if (m > 0)
+  {
+    memcpy (cd->zs_times, times, m * sizeof (sdsTime));
+    memcpy (cd->zs_val, vals, m * sizeof (double));
+    memcpy (cd->zs_stat, stats, m * sizeof (StatusType));
+  }
+  
+  cd->zs_pre = m;
+  cd->zs_n = m + n_dec;
+  cd->zs_pre_src = times;
+  cd->zs_pre_end = cd->zs_first->t0;
+  cd->zs_pre_stale = False;
+  return 1;
+}
+
+
+/* store_range
+ *
+ *      Brings the zs arrays up to date for the range t0 to t1 (see
+ *      CurveData): the decoded blocks are trimmed to those overlapping
+ *      the range, and only the blocks newly on it, or the samples added
+ *      to the newest since it was last decoded, are decoded.  Returns
+ *      whether there are any points on the range, which is also what
+ *      zs_active is set to, and their first and last index in *i0 and
+ *      *i1.
+ */
+static int
+store_range     (CurveData      *cd,
+                 sdsTime        t0,
+                 sdsTime        t1,
+                 long           *i0,
+                 long           *i1)
+{
+  SampleBlock   *b, *c, *ba, *bb;
+  size_t        base, n, k;
+  long          i;
+
+#define ZS_MOVE(TO,FROM,N)                                              \
+  do {                                                                  \
+    memmove (cd->zs_times + (TO), cd->zs_times + (FROM),                \
+             (N) * sizeof (sdsTime));                                   \
+    memmove (cd->zs_val + (TO), cd->zs_val + (FROM),                    \
+             (N) * sizeof (double));                                    \
+    memmove (cd->zs_stat + (TO), cd->zs_stat + (FROM),                  \
+             (N) * sizeof (StatusType));                                \
+  } while (0)
+
+  cd->zs_active = False;
+  if (!cd->zs_first || (cd->zs_first->t0 > t1) || (cd->zs_last->t1 < t0))
+    return 0;
+
+  if (!store_history (cd)) return 0;
+  base = cd->zs_pre;
+
+  /* the blocks overlapping the range */
+  for (ba = cd->zs_first; ba->t1 < t0; ba = ba->next);
+  for (bb = ba; bb->next && (bb->next->t0 <= t1); bb = bb->next);
+
+  /* nothing decoded worth keeping?  (This includes blocks which have
+   * since been dropped from the store.) */
+  if ((cd->zs_n > base) &&
+      ((cd->zs_dec_t1 < ba->t0) || (cd->zs_dec_t0 > bb->t0)))
+    cd->zs_n = base;
+
+  if (cd->zs_n == base)
+  {
+    for (n = 0, b = ba; ; b = b->next)
+    {
+      n += b->n;
+      if (b == bb) break;
+    }
+    if (!store_grow (cd, base + n)) return 0;
+    for (b = ba; ; b = b->next)
+    {
+      cd->zs_n += store_decode (cd, b, cd->zs_n, 1);
+      if (b == bb) break;
+    }
+  }
+  else
+  {
+    /* front: drop the blocks now off the range, or decode those now on
+     * it, into the room made for them */
+    if (cd->zs_dec_t0 < ba->t0)
+    {
+      i = find_date_idx
+        (ba->t0, cd->zs_times + base, cd->zs_n - base, cd->zs_n - base,
+         cd->zs_n - base - 1, SDS_GTE);
+      k = (size_t)i;
+      ZS_MOVE (base, base + k, cd->zs_n - base - k);
+      cd->zs_n -= k;
+    }
+    else if (cd->zs_dec_t0 > ba->t0)
+    {
+      for (n = 0, b = ba; b->t0 < cd->zs_dec_t0; b = b->next)
+        n += b->n;
+      if (!store_grow (cd, cd->zs_n + n)) return 0;
+      ZS_MOVE (base + n, base, cd->zs_n - base);
+      cd->zs_n += n;
+      for (k = base, b = ba; b->t0 < cd->zs_dec_t0; b = b->next)
+        k += store_decode (cd, b, k, 1);
+    }
+
+    /* back: the same, except that the last block decoded may have had
+     * samples added since */
+    if (cd->zs_dec_t1 > bb->t0)
+    {
+      i = find_date_idx
+        (bb->t1, cd->zs_times + base, cd->zs_n - base, cd->zs_n - base,
+         cd->zs_n - base - 1, SDS_LTE);
+      cd->zs_n = base + (size_t)(i + 1);
+    }
+    else
+    {
+      for (b = ba; b->t0 < cd->zs_dec_t1; b = b->next);
+      for (n = b->n - b->dec_n, c = b; c != bb; )
+      {
+        c = c->next;
+        n += c->n;
+      }
+      if (!store_grow (cd, cd->zs_n + n)) return 0;
+      cd->zs_n += store_decode (cd, b, cd->zs_n, 0);
+      while (b != bb)
+      {
+        b = b->next;
+        cd->zs_n += store_decode (cd, b, cd->zs_n, 1);
+      }
+    }
+  }
+  cd->zs_dec_t0 = ba->t0;
+  cd->zs_dec_t1 = bb->t0;
+
+#undef ZS_MOVE
+
+  if (cd->zs_n == 0) return 0;
+  *i0 = find_date_idx
+    (t0, cd->zs_times, cd->zs_n, cd->zs_n, cd->zs_n - 1, SDS_GTE);
+  *i1 = find_date_idx
+    (t1, cd->zs_times, cd->zs_n, cd->zs_n, cd->zs_n - 1, SDS_LTE);
+  cd->zs_active = ((*i0 >= 0) && (*i1 >= *i0));
+  return cd->zs_active;
+}
+
+
+/* store_free
+ */
+static void
+store_free      (CurveData *cd)
+{
+  SampleBlock   *b;
+
+  while ((b = cd->zs_first))
+  {
+    cd->zs_first = b->next;
+    free (b);
+  }
+  cd->zs_last = NULL;
+  cd->zs_blocks = 0;
+  if (cd->zs_times) free (cd->zs_times);
+  if (cd->zs_val) free (cd->zs_val);
+  if (cd->zs_stat) free (cd->zs_stat);
+  cd->zs_times = NULL;
+  cd->zs_val = NULL;
+  cd->zs_stat = NULL;
+  cd->zs_n = cd->zs_size = 0;
+  cd->zs_pre = 0;
+  cd->zs_pre_src = NULL;
+  cd->zs_active = False;
+}
+#endif /* STRIP_SAMPLE_STORE */
+
+
+/* busy_cursor
+ *
+ *      Shows the watch cursor over the history window while the data
+ *      source is busy (on), and the usual cursor again after.  Without
+ *      X this does nothing, so that the rest of the module doesn't need
+ *      a display.
+ */
+static void
+busy_cursor     (int on)
+{
+#ifndef NO_X11_HERE
+  /* no window in batch mode */
+  if (!history_topShell) return;
+  
+  if (on)
+  {
+    if (!cursor)
+      cursor = XCreateFontCursor (XtDisplay (history_topShell), XC_watch);
+    XDefineCursor
+      (XtDisplay (history_topShell), XtWindow (history_topShell), cursor);
+    XFlush (XtDisplay (history_topShell));
+  }
+  else XUndefineCursor
+         (XtDisplay (history_topShell), XtWindow (history_topShell));
+#endif
+}
+
+
+static int
+verify_render_buffer    (RenderBuffer *rbuf, int n)
+{
+  sdsSegment    *s;
+  int           ret = 1;
+  
+  if (rbuf->max_segs < n)
+  {
+    if (!rbuf->segs)
+      s = (sdsSegment *)malloc (n * sizeof (sdsSegment));
+    else s = (sdsSegment *)realloc (rbuf->segs, n * sizeof (sdsSegment));
+
+    if (s)
+    {
+      rbuf->segs = s;
+      rbuf->max_segs = n;
+    }
+    else ret = 0;
+  }
+
+  return ret;
+}
+
+
+/* verify_point_buffer
+ *
+ *      Makes sure the point buffer can hold at least n points.
+ */
+static int
+verify_point_buffer     (PointBuffer *pbuf, size_t n)
+{
+  size_t        max_points;
+  void          *t, *v, *s;
+
+  if (pbuf->max_points < n)
+  {
+    max_points = max (2 * pbuf->max_points, n);
+    t = realloc (pbuf->times, max_points * sizeof (sdsTime));
+    if (t) pbuf->times = (sdsTime *)t;
+    v = realloc (pbuf->val, max_points * sizeof (double));
+    if (v) pbuf->val = (double *)v;
+    s = realloc (pbuf->stat, max_points * sizeof (StatusType));
+    if (s) pbuf->stat = (StatusType *)s;
+    if (!t || !v || !s)
+      return 0;
+    pbuf->max_points = max_points;
+  }
+
+  return 1;
+}
+
+
+/* use_point_buffer
+ *
+ *      Points the segmentify() parameters at the first n points of
+ *      the point buffer.
+ */
+static void
+use_point_buffer        (PointBuffer    *pbuf,
+                         size_t         n,
+                         TimeBuffer     *times,
+                         ValueBuffer    *values,
+                         StatusBuffer   *status)
+{
+  times->base = times->ptr = pbuf->times;
+  times->count = n;
+  values->base = values->ptr = pbuf->val;
+  values->count = n;
+  status->base = status->ptr = pbuf->stat;
+  status->count = n;
+}
+
+
+/* m4_reduce
+ *
+ *      Starting at the current positions of the supplied buffers, and
+ *      moving forward, reduces up to max_points points, stopping past
+ *      stop_t, into m4_buffer.  The points falling in each bin are
+ *      replaced by the first, min, max and last among them, in time
+ *      order.  Unplotable points are kept (once per gap) so that holes
+ *      in the data remain.  The supplied buffers are left untouched.
+ *
+ *      Returns the number of points, or 0 if there is not enough memory.
+ */
+static size_t
+m4_reduce       (StripDataSourceInfo    *sds,
+                 TimeBuffer             *the_times,
+                 ValueBuffer            *the_values,
+                 StatusBuffer           *the_status,
+                 int                    max_points,
+                 sdsTime                stop_t)
+{
+  TimeBuffer    times = *the_times;
+  ValueBuffer   values = *the_values;
+  StatusBuffer  status = *the_status;
+  DataPoint     bin[4];         /* first, min, max, last */
+  int           pos[4];         /* their positions in the input */
+  int           order[4];
+  Boolean       have_bin = False;
+  long          bin_idx = 0, idx;
+  double        t0 = sds2dbl (sds->req_t0);
+  size_t        n = 0;
+  int           n_processed = 0;
+  int           i, last_pos;
+  DataPoint     p;
+
+#define M4_EMIT(P)                                                      \
+  do {                                                                  \
+    if (!verify_point_buffer (&m4_buffer, n+1)) return 0;               \
+    m4_buffer.times[n] = (P).t;                                         \
+    m4_buffer.val[n] = (P).v;                                           \
+    m4_buffer.stat[n] = (P).s;                                          \
+    n++;                                                                \
+  } while (0)
+
+#define M4_FLUSH()                                                      \
+  do {                                                                  \
+    order[0] = 0; order[3] = 3;                                         \
+    if (pos[1] <= pos[2]) { order[1] = 1; order[2] = 2; }               \
+    else { order[1] = 2; order[2] = 1; }                                \
+    for (i = 0, last_pos = -1; i < 4; i++)                              \
+      if (pos[order[i]] != last_pos)                                    \
+      {                                                                 \
+        M4_EMIT (bin[order[i]]);                                        \
+        last_pos = pos[order[i]];                                       \
+      }                                                                 \
+  } while (0)
+
+  while ((n_processed < max_points) && (*times.ptr <= stop_t))
+  {
+    p.t = *times.ptr++;
+    p.v = *values.ptr++;
+    p.s = *status.ptr++;
+    n_processed++;
+
+    /* check buffers for wrap around */
+    if (times.ptr >= times.base + times.count)
+      times.ptr -= times.count;
+    if (values.ptr >= values.base + values.count)
+      values.ptr -= values.count;
+    if (status.ptr >= status.base + status.count)
+      status.ptr -= status.count;
+
+    if (!(p.s & DATASTAT_PLOTABLE))
+    {
+      if (have_bin) M4_FLUSH();
+      have_bin = False;
+      if ((n == 0) || (m4_buffer.stat[n-1] & DATASTAT_PLOTABLE))
+        M4_EMIT (p);
+      continue;
+    }
+
+    idx = (long)((sds2dbl (p.t) - t0) / sds->bin_size);
+    if (have_bin && (idx == bin_idx))
+    {
+      if (p.v < bin[1].v) { bin[1] = p; pos[1] = n_processed; }
+      if (p.v > bin[2].v) { bin[2] = p; pos[2] = n_processed; }
+      bin[3] = p; pos[3] = n_processed;
+    }
+    else
+    {
+      if (have_bin) M4_FLUSH();
+      for (i = 0; i < 4; i++)
+      {
+        bin[i] = p;
+        pos[i] = n_processed;
+      }
+      bin_idx = idx;
+      have_bin = True;
+    }
+  }
+  if (have_bin) M4_FLUSH();
+
+#undef M4_FLUSH
+#undef M4_EMIT
+
+  return n;
+}
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * min/max summary pyramid routines
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* mm_leaf
+ *
+ *      Recomputes block b of the finest level from the raw samples.
+ */
+static void
+mm_leaf (StripDataSourceInfo *sds, CurveData *cd, size_t b)
+{
+  size_t        i, i1;
+  size_t        imin = SIZE_MAX, imax = SIZE_MAX;
+
+  i1 = min ((b+1) * SDS_MM_BASE, sds->buf_size);
+  for (i = b * SDS_MM_BASE; i < i1; i++)
+    if (cd->stat[i] & DATASTAT_PLOTABLE)
+    {
+      if ((imin == SIZE_MAX) || (cd->val[i] < cd->val[imin])) imin = i;
+      if ((imax == SIZE_MAX) || (cd->val[i] > cd->val[imax])) imax = i;
+    }
+
+  cd->mm_min[b] = imin;
+  cd->mm_max[b] = imax;
+}
+
+
+/* mm_combine
+ *
+ *      Recomputes block b of a level from its (one or two) children
+ *      on the level below, which starts at offset off_child and has
+ *      n_child blocks.  The level being computed starts at off.
+ */
+static void
+mm_combine      (CurveData      *cd,
+                 size_t         off_child,
+                 size_t         n_child,
+                 size_t         off,
+                 size_t         b)
+{
+  size_t        a = off_child + 2*b;
+  size_t        imin = cd->mm_min[a];
+  size_t        imax = cd->mm_max[a];
+  size_t        x;
+
+  if (2*b + 1 < n_child)
+  {
+    x = cd->mm_min[a+1];
+    if ((x != SIZE_MAX) && ((imin == SIZE_MAX) || (cd->val[x] < cd->val[imin])))
+      imin = x;
+    x = cd->mm_max[a+1];
+    if ((x != SIZE_MAX) && ((imax == SIZE_MAX) || (cd->val[x] > cd->val[imax])))
+      imax = x;
+  }
+
+  cd->mm_min[off+b] = imin;
+  cd->mm_max[off+b] = imax;
+}
+
+
+/* mm_free
+ */
+static void
+mm_free (CurveData *cd)
+{
+  if (cd->mm_min) free (cd->mm_min);
+  if (cd->mm_max) free (cd->mm_max);
+  cd->mm_min = cd->mm_max = NULL;
+  cd->mm_levels = 0;
+}
+
+
+/* mm_build
+ *
+ *      (Re)allocates the summary pyramid for the curve's ring buffer
+ *      and computes it from scratch.  Returns false if there is not
+ *      enough memory, in which case the curve simply has no summaries.
+ */
+static int
+mm_build (StripDataSourceInfo *sds, CurveData *cd)
+{
+  size_t        n, n_child, total, off, off_child, b;
+  int           k, levels;
+
+  mm_free (cd);
+  if ((sds->buf_size == 0) || !cd->val || !cd->stat)
+    return 0;
+
+  /* count the blocks on all levels, down to a single block */
+  total = 0;
+  levels = 0;
+  do
+  {
+    n = SDS_MM_NBLOCKS (sds->buf_size, levels);
+    total += n;
+    levels++;
+  } while (n > 1);
+
+  cd->mm_min = (size_t *)malloc (total * sizeof (size_t));
+  cd->mm_max = (size_t *)malloc (total * sizeof (size_t));
+  if (!cd->mm_min || !cd->mm_max)
+  {
+    fprintf
+      (stderr,
+       "StripDataSource_addcurve():\n"
+       "  unable to allocate min/max summary, rendering will be slower\n");
+    mm_free (cd);
+    return 0;
+  }
+  cd->mm_levels = levels;
+
+  n_child = SDS_MM_NBLOCKS (sds->buf_size, 0);
+  for (b = 0; b < n_child; b++)
+    mm_leaf (sds, cd, b);
+
+  off_child = 0;
+  for (k = 1; k < levels; k++)
+  {
+    off = off_child + n_child;
+    n = SDS_MM_NBLOCKS (sds->buf_size, k);
+    for (b = 0; b < n; b++)
+      mm_combine (cd, off_child, n_child, off, b);
+    off_child = off;
+    n_child = n;
+  }
+
+  return 1;
+}
+
+
+/* mm_update
+ *
+ *      Refreshes every block containing ring buffer index idx, after
+ *      a new sample has been stored there.
+ */
+static void
+mm_update (StripDataSourceInfo *sds, CurveData *cd, size_t idx)
+{
+  size_t        n, n_child, off, off_child, b;
+  int           k;
+
+  b = idx / SDS_MM_BASE;
+  mm_leaf (sds, cd, b);
+
+  off_child = 0;
+  n_child = SDS_MM_NBLOCKS (sds->buf_size, 0);
+  for (k = 1; k < cd->mm_levels; k++)
+  {
+    off = off_child + n_child;
+    n = SDS_MM_NBLOCKS (sds->buf_size, k);
+    b >>= 1;
+    mm_combine (cd, off_child, n_child, off, b);
+    off_child = off;
+    n_child = n;
+  }
+}
+
+
+/* mm_level
+ *
+ *      Returns the coarsest summary level which still provides at
+ *      least SDS_MM_BLOCKS_PER_BIN blocks per bin for n_points samples,
+ *      or -1 if the raw samples should be rendered instead.
+ */
+static int
+mm_level (CurveData *cd, int n_points, int n_bins)
+{
+  int   k;
+
+  if (!cd->mm_min || (n_bins <= 0))
+    return -1;
+
+  for (k = cd->mm_levels - 1; k >= 0; k--)
+    if (SDS_MM_BLOCK(k) * SDS_MM_BLOCKS_PER_BIN * (size_t)n_bins
+        <= (size_t)n_points)
+      break;
+
+  return k;
+}
+
+
+/* mm_extrema
+ *
+ *      Folds the indexes of the smallest and largest plotable values
+ *      between ring buffer indexes i0 and i1 (inclusive, i0 <= i1) into
+ *      *imin and *imax, which must be SIZE_MAX or valid indexes on entry.
+ *      The largest summary blocks lying on the range are used, so only
+ *      O(log N) blocks and samples are visited.  Without summaries, the
+ *      raw samples are scanned.
+ */
+static void
+mm_extrema      (StripDataSourceInfo    *sds,
+                 CurveData              *cd,
+                 size_t                 i0,
+                 size_t                 i1,
+                 size_t                 *imin,
+                 size_t                 *imax)
+{
+  size_t        offsets[sizeof(size_t) * 8];
+  size_t        p, len, blk, x;
+  int           k;
+
+  for (offsets[0] = 0, k = 1; k < cd->mm_levels; k++)
+    offsets[k] = offsets[k-1] + SDS_MM_NBLOCKS (sds->buf_size, k-1);
+
+  p = i0;
+  while (p <= i1)
+  {
+    len = blk = 1;
+    for (k = cd->mm_levels - 1; k >= 0; k--)
+    {
+      blk = SDS_MM_BLOCK(k);
+      if ((p % blk) != 0) continue;
+      len = min (blk, sds->buf_size - p);
+      if (p + len - 1 <= i1) break;
+    }
+
+    if (k < 0)
+    {
+      if (cd->stat[p] & DATASTAT_PLOTABLE)
+      {
+        if ((*imin == SIZE_MAX) || (cd->val[p] < cd->val[*imin])) *imin = p;
+        if ((*imax == SIZE_MAX) || (cd->val[p] > cd->val[*imax])) *imax = p;
+      }
+      p++;
+      continue;
+    }
+
+    x = cd->mm_min[offsets[k] + (p / blk)];
+    if ((x != SIZE_MAX) && ((*imin == SIZE_MAX) || (cd->val[x] < cd->val[*imin])))
+      *imin = x;
+    x = cd->mm_max[offsets[k] + (p / blk)];
+    if ((x != SIZE_MAX) && ((*imax == SIZE_MAX) || (cd->val[x] > cd->val[*imax])))
+      *imax = x;
+    p += len;
+  }
+}
+
+
+/* mm_decimate
+ *
+ *      Walks the n_points samples of the current ring buffer range,
+ *      copying into decimate_buffer, in time order, the points which
+ *      render to the same pixels as the raw samples.
+ *
+ *      Starting from the given level, the largest summary block which
+ *      begins at the current sample, lies on the range, and falls
+ *      entirely within one bin is taken; otherwise the raw sample is
+ *      copied.  For each block, its min and max samples are copied, as
+ *      well as its first sample if it opens a bin and its last if it
+ *      closes one.  The first and last samples on the range are always
+ *      copied, so that the rendered endpoints are the real ones.
+ *
+ *      Returns the number of points, or 0 if there is not enough memory.
+ */
+static size_t
+mm_decimate (StripDataSourceInfo *sds, CurveData *cd, int level, int n_points)
+{
+  size_t        offsets[sizeof(size_t) * 8];
+  size_t        remaining = (size_t)n_points;
+  size_t        n, p, q, len, blk, bi, i0, i1;
+  size_t        last_i = SIZE_MAX;
+  long          col, prev_col;
+  double        t0 = sds2dbl (sds->req_t0);
+  int           k;
+
+#define MM_COL(i)                                                       \
+  ((long)((sds2dbl (sds->times[i]) - t0) / sds->bin_size))
+
+#define MM_EMIT(i)                                                      \
+  do {                                                                  \
+    if ((i) != last_i)                                                  \
+    {                                                                   \
+      if (!verify_point_buffer (&decimate_buffer, n+1)) return 0;       \
+      decimate_buffer.times[n] = sds->times[i];                         \
+      decimate_buffer.val[n] = cd->val[i];                              \
+      decimate_buffer.stat[n] = cd->stat[i];                            \
+      last_i = (i);                                                     \
+      n++;                                                              \
+    }                                                                   \
+  } while (0)
+
+  for (offsets[0] = 0, k = 1; k <= level; k++)
+    offsets[k] = offsets[k-1] + SDS_MM_NBLOCKS (sds->buf_size, k-1);
+
+  n = 0;
+  p = sds->idx_t0;
+  MM_EMIT (p);
+  prev_col = MM_COL (p);
+  p = (p + 1) % sds->buf_size;
+  remaining--;
+
+  /* Blocks lying wholly on the range never contain the wrap point of
+   * the ring buffer, so their index order is also their time order.
+   * Keep the last sample out of them. */
+  while (remaining > 1)
+  {
+    col = 0;
+    len = q = 0;
+    for (k = level; k >= 0; k--)
+    {
+      blk = SDS_MM_BLOCK(k);
+      if ((p % blk) != 0) continue;
+      len = min (blk, sds->buf_size - p);
+      if (len >= remaining) continue;
+      q = p + len - 1;
+      if ((col = MM_COL (p)) == MM_COL (q)) break;
+    }
+
+    if (k < 0)
+    {
+      MM_EMIT (p);
+      prev_col = MM_COL (p);
+      p = (p + 1) % sds->buf_size;
+      remaining--;
+      continue;
+    }
+    
+    bi = offsets[k] + (p / blk);
+    i0 = cd->mm_min[bi];
+    i1 = cd->mm_max[bi];
+
+    if ((col != prev_col) || (i0 == SIZE_MAX))
+      MM_EMIT (p);
+    if (i0 != SIZE_MAX)
+    {
+      MM_EMIT (min (i0, i1));
+      MM_EMIT (max (i0, i1));
+    }
+    if (MM_COL ((q + 1) % sds->buf_size) != col)
+      MM_EMIT (q);
+
+    prev_col = col;
+    p = (q + 1) % sds->buf_size;
+    remaining -= len;
+  }
+  MM_EMIT (sds->idx_t1);
+
+#undef MM_EMIT
+#undef MM_COL
+
+  return n;
+}
+
+
+/* monitor_sample
+ *
+ *      Called for each curve at sample time t, with the sampled value a.
+ *      In monitor mode, collects the updates which came in since the
+ *      last sample into the curve's time line, or if there are none,
+ *      holds the newest value up to t.  Curves which can't report their
+ *      updates are recorded at the sample times instead, and an
+ *      unplotable point ends the line while the curve is disconnected.
+ *      The time line is dropped when the curve leaves monitor mode.
+ */
+static void
+monitor_sample  (StripDataSourceInfo    *sds,
+                 CurveData              *cd,
+                 sdsTime                t,
+                 double                 a)
+{
+  StripCurveInfo        *c = cd->curve;
+  struct timeval        ev_t[SDS_MONITOR_CHUNK];
+  double                ev_v[SDS_MONITOR_CHUNK];
+  int                   n_events = 0;
+  int                   i, n;
+
+  if (!c->details || !c->details->monitor)
+  {
+    if (cd->mtimes) monitor_free (cd);
+    return;
+  }
+
+  if ((c->status & STRIPCURVE_CONNECTED) &&
+      !(c->status & STRIPCURVE_WAITING))
+  {
+    if (c->get_events)
+      while ((n = c->get_events
+              (c->func_data, ev_t, ev_v, SDS_MONITOR_CHUNK)) > 0)
+      {
+        for (i = 0; i < n; i++)
+          monitor_event (sds, cd, time2sds (&ev_t[i]), ev_v[i]);
+        n_events += n;
+      }
+
+    /* no updates to report, or none yet?  Start with the sample */
+    if (!c->get_events || !SDS_MONITORED (cd))
+    {
+      if (n_events == 0)
+        monitor_event (sds, cd, t, a);
+    }
+
+    /* nothing new, so the newest value holds until now */
+    else if ((n_events == 0) &&
+             (cd->mstat[cd->m_cur] & DATASTAT_PLOTABLE) &&
+             (cd->mtimes[cd->m_cur] < t))
+    {
+      if (cd->m_held)
+        cd->mtimes[cd->m_cur] = t;
+      else if (monitor_push
+               (sds, cd, t, cd->mval[cd->m_cur], DATASTAT_PLOTABLE))
+        cd->m_held = True;
+    }
+  }
+  else if (SDS_MONITORED (cd) && (cd->mstat[cd->m_cur] & DATASTAT_PLOTABLE))
+  {
+    monitor_push (sds, cd, t, cd->mval[cd->m_cur], 0);
+    cd->m_held = False;
+  }
+}
+
+
+/* monitor_event
+ *
+ *      Appends an update to the curve's time line.  A held point becomes
+ *      the corner of the step up to the new value.  Time stamps running
+ *      backwards (the IOC clocks needn't agree with ours) are moved up
+ *      to the newest point, so that the time line stays in order.
+ */
+static void
+monitor_event   (StripDataSourceInfo    *sds,
+                 CurveData              *cd,
+                 sdsTime                t,
+                 double                 v)
+{
+  size_t        prev;
+  
+  if (SDS_MONITORED (cd))
+  {
+    if (cd->m_held)
+    {
+      if (t < cd->mtimes[cd->m_cur])
+      {
+        cd->mtimes[cd->m_cur] = t;
+        prev = (cd->m_cur + cd->m_size - 1) % cd->m_size;
+        if ((cd->m_count > 1) && (cd->mtimes[prev] > t))
+          cd->mtimes[cd->m_cur] = cd->mtimes[prev];
+      }
+      cd->m_held = False;
+    }
+    if (t < cd->mtimes[cd->m_cur])
+      t = cd->mtimes[cd->m_cur];
+  }
+
+  monitor_push (sds, cd, t, v, DATASTAT_PLOTABLE);
+}
+
+
+/* monitor_push
+ *
+ *      Adds a point after the newest one of the curve's time line.  The
+ *      ring grows while it is smaller than the sample ring, after which
+ *      the oldest point is overwritten.  Returns false if there is no
+ *      memory for the ring, in which case the time line is dropped.
+ */
+static int
+monitor_push    (StripDataSourceInfo    *sds,
+                 CurveData              *cd,
+                 sdsTime                t,
+                 double                 v,
+                 StatusType             s)
+{
+  int           n, new_index = 0, new_count = 0;
+  int           ok;
+
+  if ((cd->m_count == cd->m_size) && (cd->m_size < sds->buf_size))
+  {
+    n = (int)min
+      (max (2 * cd->m_size, (size_t)SDS_MONITOR_INCREMENT), sds->buf_size);
+    if (!cd->mtimes)
+    {
+      cd->mtimes = (sdsTime *)malloc (n * sizeof (sdsTime));
+      cd->mval = (double *)malloc (n * sizeof (double));
+      cd->mstat = (StatusType *)malloc (n * sizeof (StatusType));
+      ok = (cd->mtimes && cd->mval && cd->mstat);
+    }
+    else
+    {
+      ok = pack_array
+        ((void **)&cd->mtimes, sizeof (sdsTime),
+         cd->m_size, cd->m_cur, cd->m_count, n, &new_index, &new_count);
+      if (ok)
+        ok = pack_array
+          ((void **)&cd->mval, sizeof (double),
+           cd->m_size, cd->m_cur, cd->m_count, n, 0, 0);
+      if (ok)
+        ok = pack_array
+          ((void **)&cd->mstat, sizeof (StatusType),
+           cd->m_size, cd->m_cur, cd->m_count, n, 0, 0);
+    }
+    if (!ok)
+    {
+      monitor_free (cd);
+      return 0;
+    }
+    cd->m_size = n;
+    cd->m_cur = new_index;
+    cd->m_count = new_count;
+  }
+
+  if (cd->m_size == 0)
+    return 0;
+  
+  cd->m_cur = (cd->m_count > 0)? (cd->m_cur + 1) % cd->m_size : 0;
+  cd->mtimes[cd->m_cur] = t;
+  cd->mval[cd->m_cur] = v;
+  cd->mstat[cd->m_cur] = s;
+  if (cd->m_count < cd->m_size)
+    cd->m_count++;
+  return 1;
+}
+
+
+/* monitor_find
+ *
+ *      Finds the points of the curve's time line to be drawn on [t0, t1]:
+ *      from the last one at or before t0, whose value holds at t0, or else
+ *      the first one after it, up to the last one at or before t1.
+ *      Returns true if there are any, otherwise both indexes are -1.
+ */
+static int
+monitor_find    (CurveData      *cd,
+                 sdsTime        t0,
+                 sdsTime        t1,
+                 long           *i0,
+                 long           *i1)
+{
+  *i0 = *i1 = -1;
+  
+  if (SDS_MONITORED (cd))
+  {
+    *i0 = find_date_idx
+      (t0, cd->mtimes, cd->m_count, cd->m_size, cd->m_cur, SDS_LTE);
+    if (*i0 < 0)
+      *i0 = find_date_idx
+        (t0, cd->mtimes, cd->m_count, cd->m_size, cd->m_cur, SDS_GTE);
+    if (*i0 >= 0)
+      *i1 = find_date_idx
+        (t1, cd->mtimes, cd->m_count, cd->m_size, cd->m_cur, SDS_LTE);
+    if ((*i0 < 0) || (*i1 < 0) || (cd->mtimes[*i0] > cd->mtimes[*i1]))
+      *i0 = *i1 = -1;
+  }
+
+  return (*i0 >= 0);
+}
+
+
+/* monitor_range
+ *
+ *      Copies the points of the curve's time line on the current range
+ *      into monitor_buffer, oldest first, moving a point held from before
+ *      the range up to its beginning.  Returns the number of points, or
+ *      0 if there are none or there is not enough memory.
+ */
+static size_t
+monitor_range   (StripDataSourceInfo *sds, CurveData *cd)
+{
+  size_t        i, j, n;
+
+  if ((cd->midx_t0 < 0) || (cd->midx_t1 < 0) ||
+      ((size_t)cd->midx_t0 >= cd->m_size) ||
+      ((size_t)cd->midx_t1 >= cd->m_size))
+    return 0;
+
+  if (cd->midx_t0 <= cd->midx_t1)
+    n = cd->midx_t1 - cd->midx_t0 + 1;
+  else n = cd->m_size - cd->midx_t0 + cd->midx_t1 + 1;
+  
+  if (!verify_point_buffer (&monitor_buffer, n))
+    return 0;
+
+  for (i = 0, j = cd->midx_t0; i < n; i++, j = (j + 1) % cd->m_size)
+  {
+    monitor_buffer.times[i] = cd->mtimes[j];
+    monitor_buffer.val[i] = cd->mval[j];
+    monitor_buffer.stat[i] = cd->mstat[j];
+  }
+  if (monitor_buffer.times[0] < sds->req_t0)
+    monitor_buffer.times[0] = sds->req_t0;
+
+  return n;
+}
+
+
+/* monitor_free
+ */
+static void
+monitor_free    (CurveData *cd)
+{
+  if (cd->mtimes) free (cd->mtimes);
+  if (cd->mval) free (cd->mval);
+  if (cd->mstat) free (cd->mstat);
+  cd->mtimes = NULL;
+  cd->mval = NULL;
+  cd->mstat = NULL;
+  cd->m_size = cd->m_cur = cd->m_count = 0;
+  cd->m_held = False;
+  cd->midx_t0 = cd->midx_t1 = -1;
+}
+
+
+/* dump_table
+ *
+ *      Fetches the history of every curve for [t0, t1] and writes it out,
+ *      along with the buffered data on the current range, as a table with
+ *      one row per time stamp: tab separated, or comma separated if csv.
+ *
+ *      The range is walked SDS_DUMP_CHUNK seconds at a time, so that only
+ *      one chunk of history is held at once and output starts right away.
+ *      Each chunk is fetched for all curves together, then written out,
+ *      and its result released, before the next one is fetched.  A chunk
+ *      takes the points from its begin time up to, but not including, its
+ *      end time (the last chunk includes t1), so that each point is
+ *      written exactly once, as if the range had been fetched whole.
+ *
+ *      Where a curve has a sample store, the samples gone from the ring
+ *      buffer are written out from it, after the history from before it.
+ *
+ *      Within a chunk, each history result is sorted, so the rows are
+ *      produced by merging them, with the ring buffer as one more sorted
+ *      source, in a single pass: every row takes the earliest time among
+ *      the sources' heads, and advances those which are at that time.
+ *      Finding it costs one comparison per curve, no more than printing
+ *      the row, so that the whole dump is linear in its size.  A curve
+ *      with no history point at a row's time gets SDS_DUMP_NOVALUESTR.
+ *
+ *      Rows are assembled in a local buffer and written a block at a time,
+ *      and the date and time of day is only formatted again when the
+ *      second changes.  Given an SDDS table, the rows are set in it
+ *      instead, with no value set where there is none.
+ */
+static int
+dump_table      (StripDataSourceInfo    *sds,
+                 FILE                   *outfile,
+                 struct timeval         *begin,
+                 struct timeval         *end,
+                 int                    csv,
+                 DumpSDDS               *sdds)
+{
+  char                  obuf[SDS_DUMP_BUFSIZE];
+  char                  tbuf[SDS_DUMP_FIELDWIDTH+1];
+  char                  *p, *q;
+  size_t                tlen = 0;
+  time_t                tsec = (time_t)-1;
+  struct timeval        c0_tv, c1_tv;
+  sdsTime               t0, t1, c0, c1, t, th, tr;
+  DumpSource            *src, *hs;
+  size_t                r, r_end;
+  double                v;
+  CurveData             *cd;
+  char                  sep = csv? ',' : '\t';
+  int                   i, found, last;
+#ifdef STRIP_SAMPLE_STORE
+  long                  i0, i1;
+#endif
+
+  if (!(src = (DumpSource *)malloc (sds->n_curves * sizeof (DumpSource))))
+  {
+    fprintf (stderr, "StripDataSource_dump(): memory exhausted\n");
+    return 0;
+  }
+  
+  t0 = time2sds (begin);
+  t1 = time2sds (end);
+
+  busy_cursor (1);
+
+  /* for every curve, print out its name across the top */
+  if (!sdds)
+  {
+    fprintf (outfile, "%s", "Time");
+    for (i = 0; i < sds->n_curves; i++)
+      fprintf
+        (outfile, "%c%s [%s]", sep,
+         sds->curves[i]->curve->details->name,
+         sds->curves[i]->curve->details->egu);
+    fprintf (outfile, csv? "\n" : "\t\n");
+  }
+
+  /* the ring buffer source, over the current range */
+  r = sds->idx_t0;
+  r_end = sds->idx_t1;
+  while ((r != r_end) && (sds->times[r] < t0))
+    r = (r + 1) % sds->buf_size;
+
+  /* every point is written out, so none should be reduced away */
+  StripHistory_resolution (sds->history, 0);
+
+  p = obuf;
+  for (c0 = t0, last = 0; !last; c0 = c1)
+  {
+    c1 = c0 + SDS_DUMP_CHUNK * SDS_NSEC_PER_SEC;
+    if (c1 >= t1)
+    {
+      c1 = t1;
+      last = 1;
+    }
+    
+    /* send off all of the requests, then wait for them together */
+    sds2time (&c0_tv, c0);
+    sds2time (&c1_tv, c1);
+    for (i = 0; i < sds->n_curves; i++)
+      fetch_history (sds, sds->curves[i], &c0_tv, &c1_tv, history_joined);
+    StripHistory_wait (sds->history);
+
+    /* position each history source on its first point in the chunk
+     * (rather than search, since the points are all visited anyway) */
+    for (i = 0; i < sds->n_curves; i++)
+    {
+      cd = sds->curves[i];
+      hs = &src[i];
+      hs->n = hs->pos = 0;
+#ifdef STRIP_SAMPLE_STORE
+      if ((cd->first != SIZE_MAX) && !SDS_MONITORED (cd) &&
+          store_range
+          (cd, c0, min (c1, sds->times[cd->first] - 1), &i0, &i1))
+      {
+        hs->times = cd->zs_times + i0;
+        hs->val = cd->zs_val + i0;
+        hs->n = (size_t)(i1 - i0 + 1);
+        continue;
+      }
+#endif
+      if ((cd->history.fetch_stat != FETCH_DONE) || !cd->htimes)
+        continue;
+      hs->times = cd->htimes;
+      hs->val = cd->history.data;
+      hs->n = (size_t)cd->history.n_points;
+      while ((hs->pos < hs->n) && (hs->times[hs->pos] < c0))
+        hs->pos++;
+    }
+
+    for (;;)
+    {
+      /* earliest history time */
+      found = 0;
+      th = 0;
+      for (i = 0; i < sds->n_curves; i++)
+      {
+        hs = &src[i];
+        if (hs->pos >= hs->n)
+          continue;
+        t = hs->times[hs->pos];
+        if (!found || (t < th)) th = t;
+        found = 1;
+      }
+      if (found && ((th > c1) || ((th == c1) && !last))) found = 0;
+
+      tr = -1;
+      if ((r != r_end) &&
+          ((sds->times[r] < c1) || ((sds->times[r] == c1) && last)))
+        tr = sds->times[r];
+      if (!found && (tr < 0)) break;
+
+      /* make sure a whole field will fit, for every field */
+      if (p - obuf > SDS_DUMP_BUFSIZE - (SDS_DUMP_FIELDWIDTH + 2))
+      {
+        fwrite (obuf, 1, p - obuf, outfile);
+        p = obuf;
+      }
+
+      /* history row, ahead of a ring row at the same time */
+      if (found && ((tr < 0) || (th <= tr)))
+      {
+#ifdef USE_SDDS
+        if (sdds) dump_sdds_time (sdds, th);
+        else
+#endif
+        p = dump_time (p, th, &tsec, tbuf, &tlen);
+        for (i = 0; i < sds->n_curves; i++)
+        {
+          hs = &src[i];
+          found = 0;
+          v = 0;
+          while ((hs->pos < hs->n) && (hs->times[hs->pos] == th))
+          {
+            /* the last of several points at the same time wins */
+            v = hs->val[hs->pos++];
+            found = 1;
+          }
+#ifdef USE_SDDS
+          if (sdds)
+          {
+            if (found) dump_sdds_value (sdds, sds->curves[i], v);
+            continue;
+          }
+#endif
+          
+          if (p - obuf > SDS_DUMP_BUFSIZE - (SDS_DUMP_FIELDWIDTH + 2))
+          {
+            fwrite (obuf, 1, p - obuf, outfile);
+            p = obuf;
+          }
+          *p++ = sep;
+          if (found)
+            p += sprintf (p, "%g", v);
+          else for (q = SDS_DUMP_NOVALUESTR; *q; q++) *p++ = *q;
+        }
+      }
+
+      /* ring buffer row */
+      else
+      {
+#ifdef USE_SDDS
+        if (sdds) dump_sdds_time (sdds, tr);
+        else
+#endif
+        p = dump_time (p, tr, &tsec, tbuf, &tlen);
+        for (i = 0; i < sds->n_curves; i++)
+        {
+          cd = sds->curves[i];
+#ifdef USE_SDDS
+          if (sdds)
+          {
+            if (cd->stat[r] & DATASTAT_PLOTABLE)
+              dump_sdds_value (sdds, cd, cd->val[r]);
+            continue;
+          }
+#endif
+          
+          if (p - obuf > SDS_DUMP_BUFSIZE - (SDS_DUMP_FIELDWIDTH + 2))
+          {
+            fwrite (obuf, 1, p - obuf, outfile);
+            p = obuf;
+          }
+          *p++ = sep;
+          if (cd->stat[r] & DATASTAT_PLOTABLE)
+            p += sprintf (p, "%g", cd->val[r]);
+          else for (q = SDS_DUMP_BADVALUESTR; *q; q++) *p++ = *q;
+        }
+        r = (r + 1) % sds->buf_size;
+      }
+
+      /* finally, the end-line */
+#ifdef USE_SDDS
+      if (sdds)
+      {
+        sdds->row++;
+        continue;
+      }
+#endif
+      if (!csv) *p++ = '\t';
+      *p++ = '\n';
+    }
+
+    /* the chunk is done with, so get it out */
+    if (sdds) continue;
+    if (p > obuf) fwrite (obuf, 1, p - obuf, outfile);
+    p = obuf;
+    fflush (outfile);
+  }
+
+  /* don't hold on to the last chunk: the history result no longer
+   * matches what is plotted, and will be fetched again when needed */
+  for (i = 0; i < sds->n_curves; i++)
+  {
+    cd = sds->curves[i];
+    StripHistoryResult_release (sds->history, &cd->history);
+    cd->history.fetch_stat = FETCH_IDLE;
+    cd->hmm_idx[0] = -1;
+  }
+  
+  free (src);
+  busy_cursor (0);
+  return 1;
+}
+
+
+/* dump_time
+ *
+ *      Writes out time stamp t as "MM/DD/YYYY HH:MM:SS.uuuuuu" at p,
+ *      returning the end.  The formatted date and time of day (up to the
+ *      second) is cached in tbuf, for second *tsec, length *tlen.
+ */
+static char *
+dump_time       (char           *p,
+                 sdsTime        t,
+                 time_t         *tsec,
+                 char           *tbuf,
+                 size_t         *tlen)
+{
+  struct timeval        tv;
+  int                   i;
+  long                  usec;
+
+  sds2time (&tv, t);
+  if ((time_t)tv.tv_sec != *tsec)
+  {
+    *tsec = (time_t)tv.tv_sec;
+    tbuf[0] = 0;
+    strftime (tbuf, SDS_DUMP_FIELDWIDTH, "%m/%d/%Y %H:%M:%S", localtime (tsec));
+    *tlen = strlen (tbuf);
+  }
+  memcpy (p, tbuf, *tlen);
+  p += *tlen;
+  
+  *p++ = '.';
+  usec = tv.tv_usec;
+  for (i = 5; i >= 0; i--)
+  {
+    p[i] = (char)('0' + usec % 10);
+    usec /= 10;
+  }
+  return p + 6;
+}
+
+
+#ifdef USE_SDDS
+/* dump_sdds_layout
+ *
+ *      Opens SDDS file fName on table, with a time column and a column
+ *      for each curve, and writes out the layout.
+ */
+static void
+dump_sdds_layout        (StripDataSourceInfo    *sds,
+                         SDDS_TABLE             *table,
+                         char                   *fName)
+{
+  char                  buf[SDS_DUMP_FIELDWIDTH+1];
+  int                   i;
+
+  /* Initializes a SDDS_TABLE structure for use writing data to a SDDS file */
+  if (!SDDS_InitializeOutput(table,SDDS_BINARY,1L,DUMP_SDDS_DESCRIPTION,
+	  DUMP_SDDS_CONTENTS,fName))
+    SDDS_PrintErrors(stderr,SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
+
+  /* Processes definition of the time column */
+  if (SDDS_DefineColumn(table,DUMP_SDDS_TIME_COL,NULL,DUMP_SDDS_TIME_COL_UNITS,
+    NULL,NULL,SDDS_DOUBLE,0) == -1)
+    SDDS_PrintErrors(stderr,SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
+
+  /* Processes definitions of the data columns */
+  for (i = 0; i < sds->n_curves; i++)
+    {
+      if(SDS_DUMP_NUMWIDTH>sds->curves[i]->curve->details->precision)
+        sprintf(buf,"%%%d.%dg",SDS_DUMP_NUMWIDTH,
+	    sds->curves[i]->curve->details->precision);
+      else
+        sprintf(buf,"%%%dg",SDS_DUMP_NUMWIDTH);
+      if (SDDS_DefineColumn(table, sds->curves[i]->curve->details->name,NULL,
+		sds->curves[i]->curve->details->egu,
+		sds->curves[i]->curve->details->comment,
+		buf, SDDS_DOUBLE, 0) == -1)
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
+    }
+
+  /* Writes the SDDS header describing the layout of the data tables */
+  if (!SDDS_WriteLayout(table))
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
+}
+
+
+/* dump_sdds_time
+ *
+ *      Starts the table's next row, at time t, lengthening the table if
+ *      it is full.
+ */
+static void
+dump_sdds_time  (DumpSDDS *d, sdsTime t)
+{
+  double        time;
+
+  if (d->row >= d->n_rows)
+  {
+    if (!SDDS_LengthenTable (&d->table, SDS_DUMP_SDDS_ROWS))
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
+    d->n_rows += SDS_DUMP_SDDS_ROWS;
+  }
+
+  time = (double)(t / SDS_NSEC_PER_SEC) +
+    (double)(t % SDS_NSEC_PER_SEC) / (double)SDS_NSEC_PER_SEC;
+  if (SDDS_SetRowValues(&d->table, SDDS_SET_BY_NAME|SDDS_PASS_BY_VALUE,
+        d->row, DUMP_SDDS_TIME_COL, time, NULL) != 1)
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
+}
+
+
+/* dump_sdds_value
+ *
+ *      Sets the curve's value on the table's current row.
+ */
+static void
+dump_sdds_value (DumpSDDS *d, CurveData *cd, double v)
+{
+  if (SDDS_SetRowValues(&d->table, SDDS_SET_BY_NAME|SDDS_PASS_BY_VALUE,
+        d->row, cd->curve->details->name, v, NULL) != 1)
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors|SDDS_EXIT_PrintErrors);
 }
+#endif /* USE_SDDS */
 
 /* **************************** Emacs Editing Sequences ***************** */
 /* Local Variables: */
@@ -20,16 +20,104 @@
 
 typedef short   StatusType;
 
+/* sdsTime
+ *
+ *      Time stamps are kept inside the data source as 64-bit counts of
+ *      nanoseconds since the epoch, so that searching and comparing them
+ *      are single integer operations.  They are converted to and from
+ *      struct timeval only where they cross the module boundary (init
+ *      range, history requests and results, and dumps).
+ */
+#if defined(_MSC_VER) && (_MSC_VER < 1300)
+typedef __int64         sdsTime;
+#else
+typedef long long       sdsTime;
+#endif
+
+#define SDS_NSEC_PER_SEC        ((sdsTime)1000000000)
+
+/* time2sds
+ */
+#define time2sds(t) \
+((sdsTime)(t)->tv_sec * SDS_NSEC_PER_SEC + (sdsTime)(t)->tv_usec * 1000)
+
+/* sds2time
+ */
+#define sds2time(t,n) \
+(void) \
+((t)->tv_sec = (long)((n) / SDS_NSEC_PER_SEC), \
+ (t)->tv_usec = (long)(((n) % SDS_NSEC_PER_SEC) / 1000))
+
+/* sds2dbl, dbl2sds
+ */
+#define sds2dbl(n)      ((double)(n) / (double)SDS_NSEC_PER_SEC)
+#define dbl2sds(d)      ((sdsTime)((d) * (double)SDS_NSEC_PER_SEC))
+
+/* compare_sds
+ * returns >0 if a>b, 0 if a=b, and <0 if a<b
+ */
+#define compare_sds(a,b)        ((int)(((a) > (b)) - ((a) < (b))))
+
 typedef struct          _DataPoint
 {
-  struct timeval        t;
+  sdsTime               t;
   double                v;
   StatusType            s;
 } DataPoint;
 
+typedef enum
+{
+  SDS_REFRESH_ALL, SDS_JOIN_NEW, SDS_REFRESH_M4
+}
+sdsRenderTechnique;
+
+/* sdsReduction
+ *
+ *      How history data is reduced when it holds many more points than
+ *      there are bins to plot them in (see StripDataSource_init_range).
+ *      With the CAR archiver, the method is the one chosen in the
+ *      algorithm dialog, in this order.
+ *
+ *      MINMAX          first, min, max and last points of each bin
+ *      AVERAGE         mean of each bin
+ *      SHARP           last point of each bin
+ *      RAW             no reduction
+ *      LTTB            largest triangle three buckets: the one point of
+ *                      each bin which best keeps the shape of the line
+ */
+typedef enum
+{
+  SDS_REDUCE_MINMAX = 0,
+  SDS_REDUCE_AVERAGE,
+  SDS_REDUCE_SHARP,
+  SDS_REDUCE_RAW,
+  SDS_REDUCE_LTTB,
+  SDS_REDUCE_LAST
+}
+sdsReduction;
+
+extern char *sdsReductionString[SDS_REDUCE_LAST];
+
+/* sdsPoint, sdsSegment
+ *
+ *      Rendered data, in plot coordinates.  These are the data source's
+ *      own types, so that rendering needs no X, but they are laid out
+ *      like XPoint and XSegment, so that a graph may hand the segments
+ *      straight to XDrawSegments().
+ */
+typedef struct          _sdsPoint
+{
+  short                 x, y;
+} sdsPoint;
+
+typedef struct          _sdsSegment
+{
+  short                 x1, y1, x2, y2;
+} sdsSegment;
+
 typedef struct          _RenderBuffer
 {
-  XSegment              *segs;
+  sdsSegment            *segs;
   int                   max_segs;
   int                   n_segs;
 } RenderBuffer;
@@ -43,43 +131,130 @@ typedef struct          _CurveData
   double                *val;
   StatusType            *stat;
 
+  /* === min/max summary of the ring buffer ===
+   *
+   *  For each level k, the ring buffer is split into blocks of
+   *  (8 << k) samples, and the indexes of the smallest and largest
+   *  plotable values in each block are stored (SIZE_MAX if none).
+   *  The levels are packed one after the other, finest first.
+   */
+  size_t                *mm_min;
+  size_t                *mm_max;
+  int                   mm_levels;
+
   /* === rendered data info === */
   Boolean               connectable;    /* can new data be connected to old? */
   DataPoint             endpoints[2];   /* from most recent render */
-  struct timeval        extents[2];     /* extent of *visible* rendered data */
+  sdsTime               extents[2];     /* extent of *visible* rendered data */
 
   /* === history buffer === */
   StripHistoryResult    history;
+  StripHistoryResult    prefetch;       /* only fills the history cache */
+  sdsTime               *htimes;        /* history.times, converted */
   size_t                hidx_t0, hidx_t1;
+
+  /* === reduced history ===
+   *
+   *  A copy of the history result reduced to a few points per bin,
+   *  which is rendered instead of the result while hr_active is set.
+   *  It was made with bins hr_bucket wide (aligned on whole multiples
+   *  of it), by method hr_method, and is stale if hr_bucket is 0.
+   */
+  Boolean               hr_active;
+  sdsTime               *hr_times;
+  double                *hr_val;
+  StatusType            *hr_stat;
+  size_t                hr_n, hr_size;
+  sdsTime               hr_bucket;
+  int                   hr_method;
+  sdsTime               hr_end;         /* end of history range wanted */
+
+  /* === compressed sample store (STRIP_SAMPLE_STORE) ===
+   *
+   *  Samples pushed out of the ring buffer are kept in a list of
+   *  compressed blocks, oldest first, up to a fixed memory budget.
+   *  The zs arrays hold the zs_pre points of history from before the
+   *  oldest block, followed by the blocks from the one starting at
+   *  zs_dec_t0 to the one starting at zs_dec_t1, decoded.  These are
+   *  kept from one range to the next, so only blocks which are new to
+   *  the range need decoding.  They are rendered in place of the
+   *  history while zs_active is set, and the ring buffer takes over at
+   *  zs_end.
+   */
+  struct _SampleBlock   *zs_first, *zs_last;
+  size_t                zs_blocks;
+  Boolean               zs_active;
+  sdsTime               *zs_times;
+  double                *zs_val;
+  StatusType            *zs_stat;
+  size_t                zs_n, zs_size;
+  size_t                zs_pre;
+  sdsTime               *zs_pre_src;    /* history times they came from */
+  sdsTime               zs_pre_end;     /* oldest block's start, then */
+  Boolean               zs_pre_stale;   /* history has changed since */
+  sdsTime               zs_dec_t0, zs_dec_t1;
+  sdsTime               zs_end;
+
+  /* === cached history extrema, for autoscale ===
+   *
+   *  The min and max history values between indexes hmm_idx[0] and
+   *  hmm_idx[1] of the current history result (hmm_idx[0] < 0 if none).
+   */
+  long                  hmm_idx[2];
+  double                hmm_val[2];
+
+  /* === monitor time line ===
+   *
+   *  In monitor mode, every value update is kept with its own time
+   *  stamp, in a ring which grows as needed up to the size of the
+   *  sample ring.  While no update arrives, the newest point is a copy
+   *  of the previous value which is moved along to the latest sample
+   *  time (m_held), so that the value is seen to hold until it changes.
+   */
+  sdsTime               *mtimes;
+  double                *mval;
+  StatusType            *mstat;
+  size_t                m_size, m_cur, m_count;
+  Boolean               m_held;
+  long                  midx_t0, midx_t1;       /* current range */
 } CurveData;
 
+/* sdsCallback
+ *
+ *      Function called with client data when history data requested by
+ *      init_range() arrives later on, so that the client can re-plot.
+ */
+typedef void    (*sdsCallback)  (void *);
+
 typedef struct          _StripDataSourceInfo
 {
   StripHistory          history;
-  CurveData             buffers[STRIP_MAX_CURVES];
+
+  /* live curves, densely packed in the order they were added */
+  CurveData             **curves;
+  int                   n_curves;
+  int                   max_curves;
+  
+  sdsCallback           history_func;
+  void                  *history_data;
 
   /* ring buffer of sample times */
   size_t                buf_size;
   size_t                cur_idx;
   size_t                count;
-  struct timeval        *times;
+  sdsTime               *times;
 
   /* info for currently initialized time range */
   size_t                idx_t0, idx_t1;
-  struct timeval        req_t0, req_t1;
+  sdsTime               req_t0, req_t1;
   double                bin_size;
   int                   n_bins;
+  sdsRenderTechnique    technique;
 }
 StripDataSourceInfo;
 
 typedef void *  StripDataSource;
 
-typedef enum
-{
-  SDS_REFRESH_ALL, SDS_JOIN_NEW
-}
-sdsRenderTechnique;
-
 /* sdsTransform
  *
  *      Function to transform a set of real values into a set
@@ -108,6 +283,8 @@ typedef enum
 {
   SDS_NUMSAMPLES = 1,   /* (size_t)     number of samples to keep       rw */
   SDS_BEGIN_TIME = 2,   /* (struct timeval *) */
+  SDS_HISTORY_CB_FUNC = 3,     /* (sdsCallback) history arrived        rw */
+  SDS_HISTORY_CB_DATA = 4,     /* (void *)      data for the above     rw */
   SDS_LAST_ATTRIBUTE
 } SDSAttribute;
 
@@ -174,15 +351,43 @@ void    StripDataSource_sample  (StripDataSource, char *); /* Albert */
  *      (The endpoints are included).  Returns true iff some data is available
  *      for plotting.
  *
- *      technique:              refresh all, join new
+ *      History data is requested asynchronously when the history module
+ *      supports it.  Until it arrives, the range is rendered without it,
+ *      and on arrival the SDS_HISTORY_CB_FUNC callback is issued.
+ *
+ *      technique:              refresh all, join new, refresh M4
  *
  *      This specifies the technique to be used in subsequent render calls.
+ *      SDS_REFRESH_M4 is a complete refresh for which the data in each bin
+ *      is first reduced to its first, min, max and last points.  Lines
+ *      joining these points cover the same pixels as lines joining all
+ *      of the data, but no more than four points per bin are rendered.
+ *
+ *      History results holding more than SDS_REDUCE_RATIO points per bin
+ *      are reduced beforehand (see sdsReduction), once for as long as the
+ *      result, the bin size and the method stay the same, and in parallel
+ *      across curves if built with STRIP_ASYNC_HISTORY.
  */
 int     StripDataSource_init_range      (StripDataSource,
                                          struct timeval *,      /* begin */
                                          double,                /* bin size */
                                          int,                   /* n bins */
                                          sdsRenderTechnique);
+
+/*
+ * StripDataSource_prefetch
+ *
+ *      Asks for the history of all curves on [begin, end] in the
+ *      background, at the resolution of the last init_range(), so that it
+ *      is already cached when it comes into view.  Any prefetch still
+ *      outstanding is canceled first, and with a NULL begin that is all
+ *      that happens.  Returns the number of fetches left running, which
+ *      is always 0 without STRIP_ASYNC_HISTORY, since the caller would
+ *      then have to wait for them.
+ */
+int     StripDataSource_prefetch        (StripDataSource,
+                                         struct timeval *,      /* begin */
+                                         struct timeval *);     /* end */
  
 
 /* StripDataSource_render
@@ -194,7 +399,7 @@ int     StripDataSource_init_range      (StripDataSource,
  *      the starting address of which will be written into the supplied
  *      pointer location.  The number of generated segments is returned.
  *
- *      Note that the referenced XSegment array is a static buffer,
+ *      Note that the referenced sdsSegment array is a static buffer,
  *      so its contents are only good until the next call to render(),
  *      at which point they will be overwritten.
  *
@@ -208,16 +413,14 @@ int     StripDataSource_init_range      (StripDataSource,
  *
  *      Assumes init_range() has already been called.
  */
-#ifndef NO_X11_HERE /* Albert */
 size_t  StripDataSource_render  (StripDataSource,
                                  StripCurve,
                                  sdsTransform,          /* x transform */
                                  void *,                /* x transform data */
                                  sdsTransform,          /* y transform */
                                  void *,                /* y transform data */
-                                 XSegment **);          /* result */
+                                 sdsSegment **);        /* result */
 
-#endif /* Albert */
 /*
  * StripDataSource_dump
  *
@@ -234,6 +437,16 @@ int     StripDataSource_dump            (StripDataSource, FILE *,char *sgi);/* A
  */
 int     StripDataSource_dump_csv        (StripDataSource, FILE *,char *sgi);
 
+/*
+ * StripDataSource_dump_csv_range
+ *
+ *      As above, but for the given time range rather than the one shown
+ *      by a graph, so that it can be used without one (batch mode).
+ */
+int     StripDataSource_dump_csv_range  (StripDataSource, FILE *,
+                                         struct timeval *,      /* begin */
+                                         struct timeval *);     /* end */
+
 int   Strip_auto_scale     (Strip the_strip);  /* Albert */
 
 int   StripDataSource_removecurveAll(StripDataSource the_sds);
@@ -251,6 +464,16 @@ int StripDataSource_min_max (StripDataSourceInfo *sds, struct timeval h0,
  *      format to the specified filename.
  */
 int     StripDataSource_dump_sdds            (StripDataSource, char *);
+
+/*
+ * StripDataSource_dump_sdds_range
+ *
+ *      Outputs the history and buffered data on the given time range in
+ *      SDDS format to the specified filename, as dump_csv_range does.
+ */
+int     StripDataSource_dump_sdds_range      (StripDataSource, char *,
+                                              struct timeval *,  /* begin */
+                                              struct timeval *); /* end */
 #endif /* SDDS */
 
 #endif  /* #ifndef _StripDataSource */
@@ -17,9 +17,13 @@
 #define STRIPDIALOG_TITLE       "StripTool Controls"
 #define STRIPDIALOG_ICON_NAME   "Controls"
 
-/* the maximum number of curves
+/* the maximum number of curves (MAX_CURVES in the Makefile)
  *
- * Note: increasing this value will require modifying StripConfig
+ * This sizes the configuration, which has a detail record, a color
+ * and mask bits per curve, the plot order, the dialog's curve rows and
+ * the strip's curve table, which pairs a curve with each detail record.
+ * The graph, legend, data source and DAQ tables grow with the curves
+ * actually added, so they don't depend on it.
  */
 #if !defined (STRIP_MAX_CURVES)
 #  define STRIP_MAX_CURVES      10
@@ -52,6 +52,9 @@
 #define MAX_WINDOW_MENU_ITEMS   10
 #define MAX_REALNUM_LEN         20
 
+/* the curve page scrolls if it has more rows than this */
+#define MAX_UNSCROLLED_CURVES   10
+
 extern int auto_scaleTriger; /* Albert */
 
 typedef enum _sdPage
@@ -96,6 +99,7 @@ typedef enum
   SDTMOPT_NUMSAMPLES,
   SDTMOPT_DS,
   SDTMOPT_GR,
+  SDTMOPT_LG,
   SDTMOPT_MODIFY,
   SDTMOPT_CANCEL,
   SDTMOPT_LAST_ATTRIBUTE
@@ -206,6 +210,7 @@ typedef struct
   Widget        num_samples_txt, num_samples_lbl;
   Widget        ds_txt, ds_lbl;
   Widget        gr_txt, gr_lbl;
+  Widget        lg_txt, lg_lbl;
   SDTimeMask    modified;
   int           modifying;
 }
@@ -316,6 +321,7 @@ static void     setwidgetval_tm_tssecond        (StripDialogInfo *, int);
 static void     setwidgetval_tm_numsamples      (StripDialogInfo *, int);
 static void     setwidgetval_tm_ds              (StripDialogInfo *, double);
 static void     setwidgetval_tm_gr              (StripDialogInfo *, double);
+static void     setwidgetval_tm_lg              (StripDialogInfo *, double);
 static void     setwidgetval_tm_modify          (StripDialogInfo *, int);
 
 static void     getwidgetval_tm_tshour          (StripDialogInfo *, int *);
@@ -324,6 +330,7 @@ static void     getwidgetval_tm_tssecond        (StripDialogInfo *, int *);
 static void     getwidgetval_tm_numsamples      (StripDialogInfo *, int *);
 static void     getwidgetval_tm_ds              (StripDialogInfo *, double *);
 static void     getwidgetval_tm_gr              (StripDialogInfo *, double *);
+static void     getwidgetval_tm_lg              (StripDialogInfo *, double *);
 
 /* graph controls */
 static void     setwidgetval_gr_fg              (StripDialogInfo *, Pixel);
@@ -697,6 +704,31 @@ StripDialog     StripDialog_init        (Widget parent, StripConfig *cfg)
     XtAddCallback (tabs, XgNactivateCallback, tabs_cb, sd);
 
     /* create the curve area form and controls */
+#if STRIP_MAX_CURVES > MAX_UNSCROLLED_CURVES
+    /* a window of them at a time */
+    sd->pages[SDPAGE_CURVES] = XtVaCreateManagedWidget
+      ("curvePageScroll",
+       xmScrolledWindowWidgetClass,     base_form,
+       XmNscrollingPolicy,              XmAUTOMATIC,
+       XmNmappedWhenManaged,            False,
+       XmNtopAttachment,                XmATTACH_WIDGET,
+       XmNtopWidget,                    tabs,
+       XmNtopOffset,                    DEF_WOFFSET,
+       XmNleftAttachment,               XmATTACH_FORM,
+       XmNleftOffset,                   DEF_WOFFSET,
+       XmNrightAttachment,              XmATTACH_FORM,
+       XmNrightOffset,                  DEF_WOFFSET,
+       XmNbottomAttachment,             XmATTACH_FORM,
+       XmNbottomOffset,                 DEF_WOFFSET,
+       NULL);
+    sd->curve_form = form = XtVaCreateManagedWidget
+      ("curvePageForm",
+       xmFormWidgetClass,               sd->pages[SDPAGE_CURVES],
+       XmNfractionBase,                 (STRIP_MAX_CURVES + 1) * 10,
+       XmNnoResize,                     False,
+       XmNmappedWhenManaged,            False,
+       NULL);
+#else
     sd->pages[SDPAGE_CURVES] = sd->curve_form = form = XtVaCreateManagedWidget
       ("curvePageForm",
        xmFormWidgetClass,               base_form,
@@ -713,6 +745,7 @@ StripDialog     StripDialog_init        (Widget parent, StripConfig *cfg)
        XmNbottomAttachment,             XmATTACH_FORM,
        XmNbottomOffset,                 DEF_WOFFSET,
        NULL);
+#endif
     
     curve_column_lbl[i = SDCURVE_NAME] = XtVaCreateManagedWidget
       (SDCurveAttributeWidgetName[SDCURVE_NAME],
@@ -1275,6 +1308,55 @@ StripDialog     StripDialog_init        (Widget parent, StripConfig *cfg)
        XmNbottomWidget,                 w,
        NULL);
       
+    sd->time_info.lg_txt = txt = XtVaCreateManagedWidget
+      ("text",
+       xmTextWidgetClass,               form,
+       XmNcolumns,                      4,
+       XmNmappedWhenManaged,            False,
+       XmNtopAttachment,                XmATTACH_WIDGET,
+       XmNtopWidget,                    w,
+       XmNleftAttachment,               XmATTACH_POSITION,
+       XmNleftPosition,                 1,
+       NULL);
+    XtAddCallback (txt, XmNfocusCallback, text_focus_cb, (XtPointer)0);
+    sd->time_info.lg_lbl = XtVaCreateManagedWidget
+      ("????",
+       xmLabelWidgetClass,              form,
+       XmNtopAttachment,                XmATTACH_OPPOSITE_WIDGET,
+       XmNtopWidget,                    sd->time_info.lg_txt,
+       XmNleftAttachment,               XmATTACH_OPPOSITE_WIDGET,
+       XmNleftWidget,                   sd->time_info.lg_txt,
+       XmNrightAttachment,              XmATTACH_OPPOSITE_WIDGET,
+       XmNrightWidget,                  sd->time_info.lg_txt,
+       XmNbottomAttachment,             XmATTACH_OPPOSITE_WIDGET,
+       XmNbottomWidget,                 sd->time_info.lg_txt,
+       NULL);
+    sd->time_info.widgets[SDTMOPT_LG] = sd->time_info.lg_lbl;
+    w = txt;
+    XtVaCreateManagedWidget
+      ("seconds",
+       xmLabelWidgetClass,              form,
+       XmNtopAttachment,                XmATTACH_OPPOSITE_WIDGET,
+       XmNtopWidget,                    w,
+       XmNleftAttachment,               XmATTACH_WIDGET,
+       XmNleftWidget,                   txt,
+       XmNbottomAttachment,             XmATTACH_OPPOSITE_WIDGET,
+       XmNbottomWidget,                 w,
+       NULL);
+    lbl = XtVaCreateManagedWidget
+      ("Legend Update Interval: ",
+       xmLabelWidgetClass,              form,
+       XmNalignment,                    XmALIGNMENT_BEGINNING,
+       XmNtopAttachment,                XmATTACH_OPPOSITE_WIDGET,
+       XmNtopWidget,                    w,
+       XmNleftAttachment,               XmATTACH_POSITION,
+       XmNleftPosition,                 0,
+       XmNrightAttachment,              XmATTACH_POSITION,
+       XmNrightPosition,                1,
+       XmNbottomAttachment,             XmATTACH_OPPOSITE_WIDGET,
+       XmNbottomWidget,                 w,
+       NULL);
+      
     sep = XtVaCreateManagedWidget
       ("separator",
        xmSeparatorWidgetClass,          form,
@@ -1527,6 +1609,7 @@ StripDialog     StripDialog_init        (Widget parent, StripConfig *cfg)
 
     XtRealizeWidget (sd->shell);
     XtMapWidget (sd->current_page = sd->pages[SDPAGE_CURVES]);
+    XtMapWidget (sd->curve_form);
     XmProcessTraversal (sd->connect_txt, XmTRAVERSE_CURRENT);    
     XUnmapWindow (sd->display, XtWindow (sd->shell));
 
@@ -2420,6 +2503,20 @@ static void     setwidgetval_tm_gr      (StripDialogInfo        *sd,
 }
 
 
+static void     setwidgetval_tm_lg      (StripDialogInfo        *sd,
+                                         double                 val)
+{
+  sprintf(char_buf, "%.3g", val);
+  xstr = XmStringCreateLocalized (char_buf);
+  XmTextSetString (sd->time_info.lg_txt, char_buf);
+  XtVaSetValues
+    (sd->time_info.lg_lbl,
+     XmNlabelString,                    xstr,
+     NULL);
+  XmStringFree (xstr);
+}
+
+
 static void     setwidgetval_tm_modify  (StripDialogInfo        *sd,
                                          int                    modify)
 {
@@ -2431,6 +2528,7 @@ static void     setwidgetval_tm_modify  (StripDialogInfo        *sd,
     sd->time_info.widgets[SDTMOPT_NUMSAMPLES] = sd->time_info.num_samples_txt;
     sd->time_info.widgets[SDTMOPT_DS] = sd->time_info.ds_txt;
     sd->time_info.widgets[SDTMOPT_GR] = sd->time_info.gr_txt;
+    sd->time_info.widgets[SDTMOPT_LG] = sd->time_info.lg_txt;
     xstr = modify_btn_str[1];
   }
   else
@@ -2441,6 +2539,7 @@ static void     setwidgetval_tm_modify  (StripDialogInfo        *sd,
     sd->time_info.widgets[SDTMOPT_NUMSAMPLES] = sd->time_info.num_samples_lbl;
     sd->time_info.widgets[SDTMOPT_DS] = sd->time_info.ds_lbl;
     sd->time_info.widgets[SDTMOPT_GR] = sd->time_info.gr_lbl;
+    sd->time_info.widgets[SDTMOPT_LG] = sd->time_info.lg_lbl;
     xstr = modify_btn_str[0];
   }
   XtVaSetValues
@@ -2516,6 +2615,17 @@ static void     getwidgetval_tm_gr             (StripDialogInfo        *sd,
 }
 
 
+static void     getwidgetval_tm_lg             (StripDialogInfo        *sd,
+                                                 double                 *val)
+{
+  char  *str;
+
+  str = XmTextGetString (sd->time_info.lg_txt);
+  *val = atof (str);
+  XtFree (str);
+}
+
+
 /* graph controls */
 static void     setwidgetval_gr_fg              (StripDialogInfo *sd,
                                                  Pixel           pixel)
@@ -2813,7 +2923,7 @@ static void     tmmodify_btn_cb (Widget         BOGUS(1),
 
   StripConfigMask_clear (&mask);
 
-  for (i = SDTMOPT_TSHOUR; i <= SDTMOPT_GR; i++)
+  for (i = SDTMOPT_TSHOUR; i <= SDTMOPT_LG; i++)
     XtUnmapWidget (sd->time_info.widgets[i]);
   
   if (sd->time_info.modifying)
@@ -2873,6 +2983,16 @@ static void     tmmodify_btn_cb (Widget         BOGUS(1),
       StripConfigMask_set (&mask, SCFGMASK_TIME_REFRESH_INTERVAL);
     }
     else setwidgetval_tm_gr (sd, sd->config->Time.refresh_interval);
+      
+    getwidgetval_tm_lg (sd, &dval);
+    if (StripConfig_setattr
+        (sd->config,
+         STRIPCONFIG_TIME_LEGEND_INTERVAL, dval,
+         0))
+    {
+      StripConfigMask_set (&mask, SCFGMASK_TIME_LEGEND_INTERVAL);
+    }
+    else setwidgetval_tm_lg (sd, sd->config->Time.legend_interval);
 
     if (StripConfigMask_intersect (&mask, &SCFGMASK_ALL))
       StripConfig_update (sd->config, mask);
@@ -2881,7 +3001,7 @@ static void     tmmodify_btn_cb (Widget         BOGUS(1),
   
   setwidgetval_tm_modify (sd, !sd->time_info.modifying);
 
-  for (i = SDTMOPT_TSHOUR; i <= SDTMOPT_GR; i++)
+  for (i = SDTMOPT_TSHOUR; i <= SDTMOPT_LG; i++)
     XtMapWidget (sd->time_info.widgets[i]);
 }
 
@@ -2894,7 +3014,7 @@ static void     tmcancel_btn_cb (Widget         BOGUS(1),
   int                   i;
   int                   h, m, s;
 
-  for (i = SDTMOPT_TSHOUR; i <= SDTMOPT_GR; i++)
+  for (i = SDTMOPT_TSHOUR; i <= SDTMOPT_LG; i++)
     XtUnmapWidget (sd->time_info.widgets[i]);
   
   XtUnmapWidget (sd->time_info.widgets[SDTMOPT_CANCEL]);
@@ -2907,9 +3027,10 @@ static void     tmcancel_btn_cb (Widget         BOGUS(1),
   setwidgetval_tm_numsamples (sd, sd->config->Time.num_samples);
   setwidgetval_tm_ds (sd, sd->config->Time.sample_interval);
   setwidgetval_tm_gr (sd, sd->config->Time.refresh_interval);
+  setwidgetval_tm_lg (sd, sd->config->Time.legend_interval);
   setwidgetval_tm_modify (sd, !sd->time_info.modifying);
 
-  for (i = SDTMOPT_TSHOUR; i <= SDTMOPT_GR; i++)
+  for (i = SDTMOPT_TSHOUR; i <= SDTMOPT_LG; i++)
     XtMapWidget (sd->time_info.widgets[i]);
 }
 
@@ -3163,6 +3284,7 @@ static void     tabs_cb (Widget w, XtPointer data, XtPointer call)
 
   XtUnmapWidget (sd->pages[cbs->old_tab]);
   XtMapWidget (sd->pages[cbs->tab]);
+  if (cbs->tab == SDPAGE_CURVES) XtMapWidget (sd->curve_form);
   sd->current_page = sd->pages[cbs->tab];
   cbs->doit = True;
 }
@@ -3287,6 +3409,11 @@ static void     StripDialog_cfgupdate   (StripConfigMask mask, void *data)
   {
     setwidgetval_tm_gr (sd, sd->config->Time.refresh_interval);
   }
+  
+  if (StripConfigMask_stat (&mask, SCFGMASK_TIME_LEGEND_INTERVAL))
+  {
+    setwidgetval_tm_lg (sd, sd->config->Time.legend_interval);
+  }
 
   /* colors */
   if (StripConfigMask_intersect (&mask, &SCFGMASK_COLOR))
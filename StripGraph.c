@@ -48,6 +48,16 @@ extern int algorithmLength;
 #define SG_DUMP_MATRIX_BADVALUESTR      "???"
 #define LEGEND_OFFSET                   5
 
+/* layout of exported SVG images (pixels) */
+#define SG_SVG_MARGIN_LEFT              80
+#define SG_SVG_MARGIN_TOP               24
+#define SG_SVG_MARGIN_BOTTOM            36
+#define SG_SVG_LEGEND_GAP               10
+#define SG_SVG_LEGEND_WIDTH             210
+#define SG_SVG_TIC_LENGTH               5
+#define SG_SVG_FONT_SIZE                12
+#define SG_SVG_LINE_HEIGHT              16
+
 extern int auto_scaleTriger; /* Albert */
 #ifdef STRIP_HISTORY
 extern int arch_flag ;       /* Albert */
@@ -65,6 +75,82 @@ static char     *SGComponentStr[SGCOMP_COUNT] =
 };
 #endif
 
+#ifdef STRIP_PLOT_STATS
+/* PlotStats
+ *
+ *      Timings of StripGraph_plotdata(), kept apart for the scrolling
+ *      path, which shifts the plot pixmap and renders only the new
+ *      data, and the refresh path, which renders everything.  Frame
+ *      times are counted in bins of powers of two microseconds.  The
+ *      reasons for falling back on a refresh are counted too.
+ */
+#ifndef STRIP_PLOT_STATS_INTERVAL
+#  define STRIP_PLOT_STATS_INTERVAL     60      /* seconds between reports */
+#endif
+#define PLOT_STATS_NBINS                24
+
+typedef enum
+{
+  PLOTPATH_SCROLL, PLOTPATH_REFRESH, PLOTPATH_COUNT
+} PlotPath;
+
+typedef enum
+{
+  REFRESH_REQUESTED,    /* asked for before the plot was drawn */
+  REFRESH_WIDTH,        /* interval width has changed */
+  REFRESH_DISJOINT,     /* new range doesn't intersect previous */
+  REFRESH_BACKWARD,     /* shift is in negative direction */
+  REFRESH_COUNT
+} RefreshReason;
+
+typedef struct
+{
+  unsigned long         frames;
+  unsigned long         segs;
+  double                total, max;     /* frame times (seconds) */
+  double                render;         /* in StripDataSource_render */
+  unsigned long         hist[PLOT_STATS_NBINS];
+} PlotPathStats;
+
+typedef struct
+{
+  PlotPathStats         path[PLOTPATH_COUNT];
+  unsigned long         refresh[REFRESH_COUNT];
+  struct timeval        reported;       /* time of last report */
+} PlotStats;
+
+static char     *PlotPathStr[PLOTPATH_COUNT] =
+{
+  "scroll",
+  "refresh"
+};
+
+static char     *RefreshReasonStr[REFRESH_COUNT] =
+{
+  "requested",
+  "width changed",
+  "no overlap",
+  "backwards"
+};
+#endif
+
+
+/* StripGraphCurve
+ *
+ *      A curve slot of the graph: the curve, its transform and legend
+ *      item, and its value if changed since the legend was last shown.
+ */
+typedef struct
+{
+  StripCurveInfo        *curve;
+  jlaTransformInfo      transform;
+  LegendItem            lgitem;
+  char                  lgdirty;
+  double                lgvalue;
+}
+StripGraphCurve;
+
+
 /* StripGraphInfo
  *
  *      This is the graph object.
@@ -96,10 +182,14 @@ typedef struct
   
   /* === graph components === */
   StripConfig           *config;
-  StripCurveInfo        *curves[STRIP_MAX_CURVES];
-  jlaTransformInfo      transforms[STRIP_MAX_CURVES];
-  LegendItem            lgitems[STRIP_MAX_CURVES];
+  StripGraphCurve       *curves;        /* slots, grown as needed */
+  int                   n_curves;       /* number of slots */
+  int                   n_used;         /* number of slots in use */
   StripCurveInfo        *selected_curve;
+
+  /* === legend values changed since last shown === */
+  int                   n_lgdirty;
+  struct timeval        lgtime;         /* when last shown */
   StripDataSource       data;
   XPoint                loc_xy;     /* (x,y) of pointer position */
 
@@ -115,6 +205,10 @@ typedef struct
 
   void                  *annotation_info;
   void                  *user_data;
+
+#ifdef STRIP_PLOT_STATS
+  PlotStats             stats;
+#endif
 }
 StripGraphInfo;
 
@@ -138,10 +232,24 @@ typedef struct
 } sgTransformXData;
 
 
+/* the data source's segments are drawn as they are, so they had better
+ * look like XSegments */
+typedef char    sgSegmentCheck
+[(sizeof (sdsSegment) == sizeof (XSegment))? 1 : -1];
+
+
 /* prototypes for internal static functions */
 static void     StripGraph_manage_geometry      (StripGraphInfo *);
 static void     StripGraph_plotdata             (StripGraphInfo *);
 static void     StripGraph_update_loc_lbl       (StripGraphInfo *sgi);
+static int      StripGraph_curvetransform       (StripGraphInfo *, int);
+static void     StripGraph_svgcolor             (char *, cColor *);
+#ifdef STRIP_PLOT_STATS
+static void     StripGraph_plotstats_frame      (StripGraphInfo *, PlotPath,
+                                                 struct timeval *, double,
+                                                 unsigned long);
+static void     StripGraph_plotstats_report     (StripGraphInfo *);
+#endif
 static void     callback                        (Widget, XtPointer, XtPointer);
 static void     crossing_event_handler          (Widget,
                                                  XtPointer,
@@ -172,7 +280,6 @@ StripGraph StripGraph_init (Widget      parent,
                             StripConfig *cfg)
 {
   StripGraphInfo        *sgi;
-  int                   i;
 
   if ((sgi = (StripGraphInfo *)malloc (sizeof(StripGraphInfo))) != NULL)
   {
@@ -301,9 +408,15 @@ StripGraph StripGraph_init (Widget      parent,
     sgi->data           = 0;
     sgi->config         = cfg;
 
-    for (i = 0; i < STRIP_MAX_CURVES; i++) sgi->curves[i] = 0;
+    sgi->curves = 0;
+    sgi->n_curves = 0;
+    sgi->n_used = 0;
     sgi->selected_curve = 0;
 
+    sgi->n_lgdirty = 0;
+    sgi->lgtime.tv_sec = 0;
+    sgi->lgtime.tv_usec = 0;
+
     get_current_time (&sgi->t1);
     dbl2time (&tv, sgi->config->Time.timespan);
     subtract_times (&sgi->t0, &tv, &sgi->t1);
@@ -321,6 +434,11 @@ StripGraph StripGraph_init (Widget      parent,
 
     sgi->annotation_info = NULL;
     sgi->user_data = NULL;
+
+#ifdef STRIP_PLOT_STATS
+    memset (&sgi->stats, 0, sizeof (sgi->stats));
+    get_current_time (&sgi->stats.reported);
+#endif
   }
   
   return (StripGraph)sgi;
@@ -334,10 +452,14 @@ void StripGraph_delete (StripGraph the_graph)
 {
   StripGraphInfo        *sgi = (StripGraphInfo *)the_graph;
   
+#ifdef STRIP_PLOT_STATS
+  StripGraph_plotstats_report (sgi);
+#endif
   if (sgi->plotpix) XFreePixmap (sgi->display, sgi->plotpix);
   if (sgi->pixmap) XFreePixmap (sgi->display, sgi->pixmap);
   if (sgi->gc) XFreeGC (sgi->display, sgi->gc);
-  
+
+  free (sgi->curves);
   free (sgi);
 }
 
@@ -362,7 +484,7 @@ int     StripGraph_setattr      (StripGraph the_sgi, ...)
       switch (attrib)
       {
           case STRIPGRAPH_HEADING:
-#ifdef USE_AAPI/*only under AAPI it's possible choose reduction algorithms*/ 
+#if defined(USE_AAPI) || defined(USE_CAR) /*only these offer reduction algorithms*/
 	    if((radioBoxAlgorithm >=0) && (radioBoxAlgorithm <algorithmLength))
 	      {
 		tmpPt=va_arg (ap, char *);
@@ -373,7 +495,7 @@ int     StripGraph_setattr      (StripGraph the_sgi, ...)
 		sgi->title=tmp;
 	      }
 	    else 
-#endif /*  USE_AAPI */
+#endif /*  USE_AAPI || USE_CAR */
 	      sgi->title = va_arg (ap, char *);
 
             xstr = XmStringCreateLocalized (sgi->title? sgi->title : "");
@@ -624,10 +746,10 @@ void StripGraph_draw    (StripGraph     the_graph,
   {
     if (!sgi->selected_curve)
     {
-      for (i = 0; i < STRIP_MAX_CURVES; i++)
-        if (sgi->curves[i])
+      for (i = 0; i < sgi->n_curves; i++)
+        if (sgi->curves[i].curve)
         {
-          sgi->selected_curve = sgi->curves[i];
+          sgi->selected_curve = sgi->curves[i].curve;
           break;
         }
     }
@@ -696,33 +818,40 @@ void StripGraph_draw    (StripGraph     the_graph,
   if ((sgi->draw_mask & SGCOMPMASK_LEGEND) &&
       StripGraph_getstat ((StripGraph)sgi, SGSTAT_LEGEND_REFRESH))
   {
-    /* make sure the legend info is up to date */
-    for (i = 0; i < STRIP_MAX_CURVES; i++)
-      if (sgi->curves[i])
+    XtVaSetValues
+      (sgi->legend,
+       XmNforeground,       sgi->config->Color.foreground.xcolor.pixel,
+       XmNbackground,       sgi->config->Color.background.xcolor.pixel,
+       NULL);
+    
+    /* make sure the legend info is up to date.  The legend only
+     * redraws the fields which have actually changed. */
+    for (i = 0; i < sgi->n_curves; i++)
+      if (sgi->curves[i].curve)
 	{
-        XtVaSetValues
-          (sgi->legend,
-		XmNforeground,       sgi->config->Color.foreground.xcolor.pixel,
-		XmNbackground,       sgi->config->Color.background.xcolor.pixel,
-		NULL);
+        sgi->curves[i].lgdirty = 0;
         sprintf
           (buf,
-		sgi->curves[i]->details->scale == STRIPSCALE_LOG_10?
+		sgi->curves[i].curve->details->scale == STRIPSCALE_LOG_10?
 		"log10 (%g, %g)  VAL=%g" : "(%g, %g)  VAL=%g",
-		sgi->curves[i]->details->min, sgi->curves[i]->details->max,
-		sgi->curves[i]->get_value(sgi->curves[i]->func_data));
+		sgi->curves[i].curve->details->min,
+		sgi->curves[i].curve->details->max,
+		sgi->curves[i].curve->get_value
+		(sgi->curves[i].curve->func_data));
 	  
         XjLegendUpdateItem
           (sgi->legend,
-		sgi->lgitems[i],
-		sgi->curves[i]->details->name,
+		sgi->curves[i].lgitem,
+		sgi->curves[i].curve->details->name,
 		buf,
-		strcmp (sgi->curves[i]->details->egu, STRIPDEF_CURVE_EGU)?
-		sgi->curves[i]->details->egu : 0,
-		sgi->curves[i]->details->comment,
-		sgi->curves[i]->details->color->xcolor.pixel);
+		strcmp (sgi->curves[i].curve->details->egu, STRIPDEF_CURVE_EGU)?
+		sgi->curves[i].curve->details->egu : 0,
+		sgi->curves[i].curve->details->comment,
+		sgi->curves[i].curve->details->color->xcolor.pixel);
       }
     XjLegendResize (sgi->legend);
+    LegendRefresh ((LegendWidget)sgi->legend);
+    sgi->n_lgdirty = 0;
     sgi->draw_mask &= ~SGCOMPMASK_LEGEND;
     StripGraph_clearstat (sgi, SGSTAT_LEGEND_REFRESH);
   }
@@ -799,8 +928,7 @@ void StripGraph_draw    (StripGraph     the_graph,
 
   Annotation_draw(sgi->display, sgi->pixmap, sgi->gc,
                  sgi->window_rect,sgi->annotation_info,
-                 &(sgi->plotted_t0),&(sgi->plotted_t1),
-                 sgi->curves);
+                 &(sgi->plotted_t0),&(sgi->plotted_t1));
   XSetForeground
     (sgi->display, sgi->gc, sgi->config->Color.foreground.xcolor.pixel);
 
@@ -826,7 +954,7 @@ void StripGraph_draw    (StripGraph     the_graph,
 static void StripGraph_plotdata (StripGraphInfo *sgi)
 {
   StripCurveInfo        *curve;
-  XSegment              *segs;
+  sdsSegment            *segs;
   struct timeval        dt_new, dt_cur; /* interval width (time) */
   double                dl_new, dl_cur; /* interval width (real) */
   double                db = 0.0;       /* bin width (real) */
@@ -834,14 +962,20 @@ static void StripGraph_plotdata (StripGraphInfo *sgi)
   double                l_min, l_max;   /* min, max (real) */
   int                   b_min, b_max;   /* min, max (quantized) */
   int                   n_shift = 0;
-  int                   n, m;
+  int                   n, m, k;
   struct timeval        t;
   double                r;
   sdsRenderTechnique    method;
   sgTransformYData      y_data;
   sgTransformXData      x_data;
-  Boolean               need_xform;
-  Boolean               ok;
+#ifdef STRIP_PLOT_STATS
+  PlotPath              path;
+  struct timeval        frame_t0, render_t0, render_t1;
+  double                render_time = 0.0;
+  unsigned long         n_segs = 0;
+
+  get_current_time (&frame_t0);
+#endif
 
   /* new and current interval widths, in real and time types */
   dl_new = subtract_times (&dt_new, &sgi->t0, &sgi->t1);
@@ -871,8 +1005,18 @@ static void StripGraph_plotdata (StripGraphInfo *sgi)
         (b_min >= sgi->window_rect.width - 1) ||
         (b_max <= 0) ||
         (n_shift < 0))
+    {
+#ifdef STRIP_PLOT_STATS
+      sgi->stats.refresh
+        [(ABS(dl_new - dl_cur) > DBL_EPSILON)? REFRESH_WIDTH :
+         (n_shift >= 0)? REFRESH_DISJOINT : REFRESH_BACKWARD]++;
+#endif
       StripGraph_setstat (sgi, SGSTAT_GRAPH_REFRESH);
+    }
   }
+#ifdef STRIP_PLOT_STATS
+  else sgi->stats.refresh[REFRESH_REQUESTED]++;
+#endif
   
   /* if everything needs to be re-plotted, erase the whole pixmap */
   if (StripGraph_getstat (sgi, SGSTAT_GRAPH_REFRESH))
@@ -888,7 +1032,17 @@ static void StripGraph_plotdata (StripGraphInfo *sgi)
     sgi->plotted_t1 = sgi->t1;
     db = dl_new / (sgi->window_rect.width - 1);
     dl = dl_new;
-    method = SDS_REFRESH_ALL;
+    
+    /* the archive point markers need every point, not just the
+     * extremes of each pixel column */
+#ifdef STRIP_HISTORY
+    method = arch_flag? SDS_REFRESH_ALL : SDS_REFRESH_M4;
+#else
+    method = SDS_REFRESH_M4;
+#endif
+#ifdef STRIP_PLOT_STATS
+    path = PLOTPATH_REFRESH;
+#endif
   }
 
   /* if only a portion needs to be plotted, re-arrange the displayed data
@@ -921,6 +1075,9 @@ static void StripGraph_plotdata (StripGraphInfo *sgi)
 
     dl = dl_cur;
     method = SDS_JOIN_NEW;
+#ifdef STRIP_PLOT_STATS
+    path = PLOTPATH_SCROLL;
+#endif
   }
 
   XSetLineAttributes
@@ -933,55 +1090,21 @@ static void StripGraph_plotdata (StripGraphInfo *sgi)
       (sgi->data, &sgi->plotted_t0, db, sgi->window_rect.width, method) > 0)
   {
 #ifdef QUANTIFY_PRECISE
-    if (method == SDS_REFRESH_ALL)
+    if (method != SDS_JOIN_NEW)
       quantify_start_recording_data();
 #endif
-    /* for each plotted curve ... */
-    for (m = 0; m < STRIP_MAX_CURVES; m++)
+    /* for each plotted curve ... (stopping once all have been found,
+     * as the plot order covers every curve the strip could have) */
+    for (m = 0, k = 0; (m < STRIP_MAX_CURVES) && (k < sgi->n_used); m++)
     {
       n = sgi->config->Curves.plot_order[m];
-      curve = sgi->curves[n];
-      if (!curve) continue;
+      if (n >= sgi->n_curves || !(curve = sgi->curves[n].curve)) continue;
+      k++;
       if (curve->details->plotstat != STRIPCURVE_PLOTTED) continue;
 
-      /* if this is the selected curve, get its transform info from
-       * the axis */
-      if (curve == sgi->selected_curve)
-        XjAxisGetTransform (sgi->y_axis, &sgi->transforms[n]);
-
-      /* otherwise, verify that the current transform info is valid */
-      else
-      {
-        if (curve->details->scale == STRIPSCALE_LOG_10)
-          need_xform = (sgi->transforms[n].transform != XjAXIS_LOG10);
-        else need_xform = (sgi->transforms[n].transform != XjAXIS_LINEAR);
-        
-        need_xform |= (sgi->transforms[n].min_pos == 0);
-        need_xform |=
-          (sgi->transforms[n].max_pos == sgi->window_rect.height - 1);
-        need_xform |= (sgi->transforms[n].min_val != curve->details->min);
-        need_xform |= (sgi->transforms[n].max_val != curve->details->max);
-        need_xform |=
-          (sgi->transforms[n].log_epsilon != curve->details->precision);
-        
-        if (need_xform)
-        {
-          ok = jlaBuildTransform
-            (&sgi->transforms[n],
-             curve->details->scale == STRIPSCALE_LOG_10?
-             XjAXIS_LOG10 : XjAXIS_LINEAR,
-             XjAXIS_REAL,
-             (AxisEndpointPosition)0,
-             (AxisEndpointPosition)(sgi->window_rect.height - 1),
-             curve->details->min,
-             curve->details->max,
-             -curve->details->precision);
-          
-          if (!ok) continue;
-        }
-      }
+      if (!StripGraph_curvetransform (sgi, n)) continue;
   
-      y_data.xform = &sgi->transforms[n];
+      y_data.xform = &sgi->curves[n].transform;
       y_data.sgi = sgi;
       y_data.curve = curve;
 
@@ -989,18 +1112,27 @@ static void StripGraph_plotdata (StripGraphInfo *sgi)
       x_data.db = db;
 
       /* transform data into axis coordinates */
+#ifdef STRIP_PLOT_STATS
+      get_current_time (&render_t0);
+#endif
       n = StripDataSource_render
         (sgi->data, curve,
          (sdsTransform)x_transform, &x_data,
          (sdsTransform)y_transform, &y_data,
          &segs);
+#ifdef STRIP_PLOT_STATS
+      get_current_time (&render_t1);
+      render_time += subtract_times (&t, &render_t0, &render_t1);
+      if (n > 0) n_segs += n;
+#endif
 
       /* draw the segments */
       if (n > 0)
       {
         XSetForeground
           (sgi->display, sgi->gc, curve->details->color->xcolor.pixel);
-        XDrawSegments (sgi->display, sgi->plotpix, sgi->gc, segs, n);
+        XDrawSegments
+          (sgi->display, sgi->plotpix, sgi->gc, (XSegment *)segs, n);
 
 #ifdef STRIP_HISTORY
 	if (arch_flag) {
@@ -1041,9 +1173,146 @@ static void StripGraph_plotdata (StripGraphInfo *sgi)
 #endif
     
   }
+
+#ifdef STRIP_PLOT_STATS
+  /* wait for the server, so that its drawing time is counted too */
+  XSync (sgi->display, False);
+  StripGraph_plotstats_frame (sgi, path, &frame_t0, render_time, n_segs);
+#endif
+}
+
+
+/*
+ * StripGraph_curvetransform
+ *
+ * Makes sure the transform info for the n'th curve is up to date,
+ * returning false if it can't be built.  The selected curve uses the
+ * y axis transform.
+ */
+static int StripGraph_curvetransform (StripGraphInfo *sgi, int n)
+{
+  StripCurveInfo        *curve = sgi->curves[n].curve;
+  Boolean               need_xform;
+  Boolean               ok = True;
+
+  /* if this is the selected curve, get its transform info from
+   * the axis */
+  if (curve == sgi->selected_curve)
+    XjAxisGetTransform (sgi->y_axis, &sgi->curves[n].transform);
+
+  /* otherwise, verify that the current transform info is valid */
+  else
+  {
+    if (curve->details->scale == STRIPSCALE_LOG_10)
+      need_xform = (sgi->curves[n].transform.transform != XjAXIS_LOG10);
+    else need_xform = (sgi->curves[n].transform.transform != XjAXIS_LINEAR);
+    
+    need_xform |= (sgi->curves[n].transform.min_pos == 0);
+    need_xform |=
+      (sgi->curves[n].transform.max_pos == sgi->window_rect.height - 1);
+    need_xform |= (sgi->curves[n].transform.min_val != curve->details->min);
+    need_xform |= (sgi->curves[n].transform.max_val != curve->details->max);
+    need_xform |=
+      (sgi->curves[n].transform.log_epsilon != curve->details->precision);
+    
+    if (need_xform)
+      ok = jlaBuildTransform
+        (&sgi->curves[n].transform,
+         curve->details->scale == STRIPSCALE_LOG_10?
+         XjAXIS_LOG10 : XjAXIS_LINEAR,
+         XjAXIS_REAL,
+         (AxisEndpointPosition)0,
+         (AxisEndpointPosition)(sgi->window_rect.height - 1),
+         curve->details->min,
+         curve->details->max,
+         -curve->details->precision);
+  }
+
+  return ok;
 }
 
 
+#ifdef STRIP_PLOT_STATS
+/*
+ * StripGraph_plotstats_frame
+ *
+ *      Counts one call of StripGraph_plotdata(), which began at t0, and
+ *      reports the totals if it is time to.
+ */
+static void StripGraph_plotstats_frame (StripGraphInfo  *sgi,
+                                        PlotPath        path,
+                                        struct timeval  *t0,
+                                        double          render,
+                                        unsigned long   segs)
+{
+  PlotPathStats         *ps = &sgi->stats.path[path];
+  struct timeval        now, t;
+  double                d;
+  long                  us;
+  int                   i;
+
+  get_current_time (&now);
+  d = subtract_times (&t, t0, &now);
+
+  ps->frames++;
+  ps->segs += segs;
+  ps->total += d;
+  ps->render += render;
+  if (d > ps->max) ps->max = d;
+
+  /* bin i holds times of [2^i, 2^(i+1)) microseconds */
+  for (i = 0, us = (long)(d * 1e6); (us > 1) && (i < PLOT_STATS_NBINS-1); i++)
+    us >>= 1;
+  ps->hist[i]++;
+
+  if (subtract_times (&t, &sgi->stats.reported, &now) >=
+      STRIP_PLOT_STATS_INTERVAL)
+  {
+    StripGraph_plotstats_report (sgi);
+    sgi->stats.reported = now;
+  }
+}
+
+
+/*
+ * StripGraph_plotstats_report
+ *
+ *      Prints the plot timings gathered since the graph was created.
+ */
+static void StripGraph_plotstats_report (StripGraphInfo *sgi)
+{
+  PlotPathStats         *ps;
+  int                   i, j;
+
+  fprintf (stderr, "StripGraph: plot timings\n");
+  for (i = 0; i < PLOTPATH_COUNT; i++)
+  {
+    ps = &sgi->stats.path[i];
+    if (!ps->frames) continue;
+    
+    fprintf
+      (stderr,
+       "  %-8s %lu frames, mean %.3f ms (render %.3f ms), max %.3f ms, "
+       "%lu segments/frame\n",
+       PlotPathStr[i], ps->frames,
+       1e3 * ps->total / ps->frames, 1e3 * ps->render / ps->frames,
+       1e3 * ps->max, ps->segs / ps->frames);
+    for (j = 0; j < PLOT_STATS_NBINS; j++)
+      if (ps->hist[j])
+        fprintf
+          (stderr, "    < %9ld us: %lu\n", 2L << j, ps->hist[j]);
+  }
+  
+  fprintf (stderr, "  refreshes:");
+  for (i = 0; i < REFRESH_COUNT; i++)
+    fprintf
+      (stderr, "%s %s %lu", i? "," : "",
+       RefreshReasonStr[i], sgi->stats.refresh[i]);
+  fprintf (stderr, "\n");
+}
+#endif /* STRIP_PLOT_STATS */
+
+
 /*
  * StripGraph_addcurve
  */
@@ -1051,20 +1320,26 @@ int     StripGraph_addcurve     (StripGraph the_sgi, StripCurve curve)
 {
   StripGraphInfo        *sgi = (StripGraphInfo *)the_sgi;
   StripCurveInfo        *c = (StripCurveInfo *)curve;
+  StripGraphCurve       *slots;
   int                   i;
   int                   ok;
   char                  buf[256];
 
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
-    if (!sgi->curves[i]) break;
+  for (i = 0; i < sgi->n_curves; i++)
+    if (!sgi->curves[i].curve) break;
+
+  if ((i == sgi->n_curves) &&
+      (slots = (StripGraphCurve *)grow_table
+       (sgi->curves, &sgi->n_curves, sizeof (StripGraphCurve))))
+    sgi->curves = slots;
 
-  if ((ok = (i < STRIP_MAX_CURVES)))
+  if ((ok = (i < sgi->n_curves)))
   {
-    sgi->curves[i] = c;
+    sgi->curves[i].curve = c;
 
     /* build transform for this curve */
     ok = jlaBuildTransform
-      (&sgi->transforms[i],
+      (&sgi->curves[i].transform,
 	  c->details->scale == STRIPSCALE_LOG_10? XjAXIS_LOG10 : XjAXIS_LINEAR,
 	  XjAXIS_REAL,
 	  (AxisEndpointPosition)0,
@@ -1075,21 +1350,23 @@ int     StripGraph_addcurve     (StripGraph the_sgi, StripCurve curve)
     
     if (!ok) {
       fprintf (stderr, "unable to build transform for curve\n");
-      sgi->curves[i] = 0;
+      sgi->curves[i].curve = 0;
       return 0;
     }
     
     sprintf
       (buf, "(%g, %g) VAL=%g",
-	  sgi->curves[i]->details->min, sgi->curves[i]->details->max,
-	  sgi->curves[i]->get_value(sgi->curves[i]->func_data) );
-    sgi->lgitems[i] = XjLegendNewItem
+	  sgi->curves[i].curve->details->min,
+	  sgi->curves[i].curve->details->max,
+	  sgi->curves[i].curve->get_value(sgi->curves[i].curve->func_data) );
+    sgi->curves[i].lgitem = XjLegendNewItem
       (sgi->legend,
-	  sgi->curves[i]->details->name,
+	  sgi->curves[i].curve->details->name,
 	  buf,
-	  sgi->curves[i]->details->egu,
-	  sgi->curves[i]->details->comment,
-	  sgi->curves[i]->details->color->xcolor.pixel);
+	  sgi->curves[i].curve->details->egu,
+	  sgi->curves[i].curve->details->comment,
+	  sgi->curves[i].curve->details->color->xcolor.pixel);
+    sgi->n_used++;
     
     StripGraph_setstat (sgi, SGSTAT_GRAPH_REFRESH | SGSTAT_LEGEND_REFRESH);
   }
@@ -1107,17 +1384,23 @@ int     StripGraph_removecurve  (StripGraph the_sgi, StripCurve curve)
   int                   i;
   int                   ret_val;
 
-  for (i = 0; i < STRIP_MAX_CURVES; i++)
-    if (sgi->curves[i] == (StripCurveInfo *)curve)
+  for (i = 0; i < sgi->n_curves; i++)
+    if (sgi->curves[i].curve == (StripCurveInfo *)curve)
       break;
 
-  if ((ret_val = (i < STRIP_MAX_CURVES)))
+  if ((ret_val = (i < sgi->n_curves)))
   {
-    XjLegendDeleteItem (sgi->legend, sgi->lgitems[i]);
+    XjLegendDeleteItem (sgi->legend, sgi->curves[i].lgitem);
     if (sgi->selected_curve == (StripCurveInfo *)curve)
       sgi->selected_curve = NULL;
-    sgi->curves[i] = 0;
-    sgi->lgitems[i] = 0;
+    sgi->curves[i].curve = 0;
+    sgi->curves[i].lgitem = 0;
+    sgi->n_used--;
+    if (sgi->curves[i].lgdirty)
+    {
+      sgi->curves[i].lgdirty = 0;
+      sgi->n_lgdirty--;
+    }
     StripGraph_setstat (sgi, SGSTAT_GRAPH_REFRESH | SGSTAT_LEGEND_REFRESH);
   }
 
@@ -1160,6 +1443,232 @@ int     StripGraph_dumpdata_csv     (StripGraph the_sgi, FILE *f)
   return StripDataSource_dump_csv (sgi->data, f,the_sgi);
 }
 
+/*
+ * StripGraph_dumpsvg
+ *
+ * Writes the graph as an SVG image: the data on the current time range,
+ * rendered straight from the data source with the same transforms as
+ * the plot, the axis tics from the axis widgets, the grid, the
+ * annotations and the legend.  Nothing is read back from the X server.
+ */
+int     StripGraph_dumpsvg      (StripGraph the_sgi, FILE *f)
+{
+  StripGraphInfo        *sgi = (StripGraphInfo *)the_sgi;
+  StripCurveInfo        *curve;
+  sdsSegment            *segs;
+  sgTransformYData      y_data;
+  sgTransformXData      x_data;
+  jlaTransformInfo      y_xform;
+  int                   tic_offsets[AXIS_MAX_TICS+1];
+  char                  fg[8], bg[8], gc[8], cc[8];
+  char                  buf[256];
+  struct timeval        t;
+  time_t                tt;
+  double                dl, db, r, v;
+  int                   width, height, x0, y0, legend_x, lw;
+  int                   i, j, k, m, n;
+
+  width = sgi->window_rect.width;
+  height = sgi->window_rect.height;
+  if ((width < 2) || (height < 2)) return 0;
+
+  StripGraph_svgcolor (fg, &sgi->config->Color.foreground);
+  StripGraph_svgcolor (bg, &sgi->config->Color.background);
+  StripGraph_svgcolor (gc, &sgi->config->Color.grid);
+  lw = sgi->config->Option.graph_linewidth;
+  if (lw < 1) lw = 1;
+
+  /* plot area offset, and legend position */
+  x0 = SG_SVG_MARGIN_LEFT;
+  y0 = SG_SVG_MARGIN_TOP;
+  legend_x = x0 + width + SG_SVG_LEGEND_GAP;
+  n = sgi->n_used;
+
+  fprintf
+    (f,
+     "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+     "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+     "width=\"%d\" height=\"%d\" "
+     "font-family=\"sans-serif\" font-size=\"%d\">\n",
+     legend_x + SG_SVG_LEGEND_WIDTH,
+     max (y0 + height + SG_SVG_MARGIN_BOTTOM,
+          y0 + n * 4 * SG_SVG_LINE_HEIGHT),
+     SG_SVG_FONT_SIZE);
+  fprintf
+    (f,
+     "<defs><clipPath id=\"plot\"><rect x=\"0\" y=\"0\" "
+     "width=\"%d\" height=\"%d\"/></clipPath></defs>\n",
+     width, height);
+  fprintf (f, "<rect width=\"100%%\" height=\"100%%\" fill=\"%s\"/>\n", bg);
+
+  /* title */
+  if (sgi->title && sgi->title[0])
+  {
+    fprintf
+      (f, "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\" fill=\"%s\">",
+       x0 + width / 2, y0 - SG_SVG_LINE_HEIGHT / 2, fg);
+    xml_fputs (sgi->title, f);
+    fprintf (f, "</text>\n");
+  }
+
+  fprintf (f, "<g transform=\"translate(%d,%d)\">\n", x0, y0);
+
+  /* x axis: major tics, time labels and grid */
+  dl = subtract_times (&t, &sgi->t0, &sgi->t1);
+  db = dl / (width - 1);
+  n = XjAxisGetMajorTicOffsets (sgi->x_axis, tic_offsets, AXIS_MAX_TICS+1);
+  for (i = 0; i < n; i++)
+  {
+    if (sgi->config->Option.grid_xon)
+      fprintf
+        (f, "<line x1=\"%d\" y1=\"0\" x2=\"%d\" y2=\"%d\" stroke=\"%s\"/>\n",
+         tic_offsets[i], tic_offsets[i], height - 1, gc);
+    fprintf
+      (f, "<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" stroke=\"%s\"/>\n",
+       tic_offsets[i], height, tic_offsets[i], height + SG_SVG_TIC_LENGTH, fg);
+    r = time2dbl (&sgi->t0) + tic_offsets[i] * db;
+    tt = (time_t)r;
+    strftime (buf, sizeof (buf), "%H:%M:%S", localtime (&tt));
+    fprintf
+      (f, "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\" fill=\"%s\">%s</text>\n",
+       tic_offsets[i], height + SG_SVG_TIC_LENGTH + SG_SVG_LINE_HEIGHT, fg, buf);
+  }
+
+  /* y axis: major tics, value labels and grid */
+  XjAxisGetTransform (sgi->y_axis, &y_xform);
+  n = XjAxisGetMajorTicOffsets (sgi->y_axis, tic_offsets, AXIS_MAX_TICS+1);
+  for (i = 0; i < n; i++)
+  {
+    j = height - 1 - tic_offsets[i];
+    if (sgi->config->Option.grid_yon)
+      fprintf
+        (f, "<line x1=\"0\" y1=\"%d\" x2=\"%d\" y2=\"%d\" stroke=\"%s\"/>\n",
+         j, width - 1, j, gc);
+    fprintf
+      (f, "<line x1=\"%d\" y1=\"%d\" x2=\"0\" y2=\"%d\" stroke=\"%s\"/>\n",
+       -SG_SVG_TIC_LENGTH, j, j, fg);
+    r = tic_offsets[i];
+    jlaUntransformRasterizedValues (&y_xform, &r, &v, 1);
+    fprintf
+      (f, "<text x=\"%d\" y=\"%d\" text-anchor=\"end\" fill=\"%s\">%.*g</text>\n",
+       -SG_SVG_TIC_LENGTH - 2, j + SG_SVG_FONT_SIZE / 2 - 1, fg,
+       (y_xform.transform == XjAXIS_LOG10)? 2 : 6, v);
+  }
+
+  fprintf
+    (f, "<rect x=\"0\" y=\"0\" width=\"%d\" height=\"%d\" "
+     "fill=\"none\" stroke=\"%s\"/>\n",
+     width - 1, height - 1, fg);
+
+  /* data, rendered for the current range the same way the plot is */
+  fprintf (f, "<g clip-path=\"url(#plot)\" fill=\"none\" "
+           "stroke-width=\"%d\" stroke-linejoin=\"miter\">\n", lw);
+  if (StripDataSource_init_range
+      (sgi->data, &sgi->t0, db, width, SDS_REFRESH_M4) > 0)
+  {
+    for (m = 0, k = 0; (m < STRIP_MAX_CURVES) && (k < sgi->n_used); m++)
+    {
+      i = sgi->config->Curves.plot_order[m];
+      if (i >= sgi->n_curves || !(curve = sgi->curves[i].curve)) continue;
+      k++;
+      if (curve->details->plotstat != STRIPCURVE_PLOTTED) continue;
+      if (!StripGraph_curvetransform (sgi, i)) continue;
+
+      y_data.xform = &sgi->curves[i].transform;
+      y_data.sgi = sgi;
+      y_data.curve = curve;
+      x_data.t0 = time2dbl (&sgi->t0);
+      x_data.db = db;
+      
+      n = StripDataSource_render
+        (sgi->data, curve,
+         (sdsTransform)x_transform, &x_data,
+         (sdsTransform)y_transform, &y_data,
+         &segs);
+      if (n <= 0) continue;
+
+      /* one path per curve, joining segments which meet */
+      StripGraph_svgcolor (cc, curve->details->color);
+      fprintf (f, "<path stroke=\"%s\" d=\"", cc);
+      for (j = 0; j < n; j++)
+      {
+        if ((j == 0) ||
+            (segs[j].x1 != segs[j-1].x2) || (segs[j].y1 != segs[j-1].y2))
+          fprintf (f, "%sM%d %d", j? "\n" : "", segs[j].x1, segs[j].y1);
+        fprintf (f, " L%d %d", segs[j].x2, segs[j].y2);
+      }
+      fprintf (f, "\"/>\n");
+    }
+  }
+  fprintf (f, "</g>\n");
+
+  /* the data source's render state now describes the exported range,
+   * so the next plot must start over */
+  StripGraph_setstat (sgi, SGSTAT_GRAPH_REFRESH);
+
+  Annotation_svg (f, sgi->annotation_info, fg, bg);
+  fprintf (f, "</g>\n");
+
+  /* legend: color bar and name, then range, units and comment */
+  y0 = SG_SVG_MARGIN_TOP;
+  for (i = 0; i < sgi->n_curves; i++)
+  {
+    if (!(curve = sgi->curves[i].curve)) continue;
+
+    StripGraph_svgcolor (cc, curve->details->color);
+    fprintf
+      (f, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" "
+       "fill=\"none\" stroke=\"%s\" stroke-width=\"2\"/>\n",
+       legend_x, y0, SG_SVG_LEGEND_WIDTH - SG_SVG_LEGEND_GAP,
+       SG_SVG_LINE_HEIGHT + 2, cc);
+    fprintf
+      (f, "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\" fill=\"%s\">",
+       legend_x + (SG_SVG_LEGEND_WIDTH - SG_SVG_LEGEND_GAP) / 2,
+       y0 + SG_SVG_LINE_HEIGHT - 2, fg);
+    xml_fputs (curve->details->name, f);
+    fprintf (f, "</text>\n");
+    y0 += SG_SVG_LINE_HEIGHT + 4;
+
+    sprintf
+      (buf,
+       curve->details->scale == STRIPSCALE_LOG_10?
+       "log10 (%g, %g)" : "(%g, %g)",
+       curve->details->min, curve->details->max);
+    for (j = 0; j < 3; j++)
+    {
+      char *s = (j == 0)? buf :
+        (j == 1)? curve->details->egu : curve->details->comment;
+      if (!s || !s[0]) continue;
+      if ((j == 1) && !strcmp (s, STRIPDEF_CURVE_EGU)) continue;
+      fprintf
+        (f, "<text x=\"%d\" y=\"%d\" fill=\"%s\">",
+         legend_x + 2, y0 + SG_SVG_LINE_HEIGHT - 4, fg);
+      xml_fputs (s, f);
+      fprintf (f, "</text>\n");
+      y0 += SG_SVG_LINE_HEIGHT;
+    }
+    y0 += SG_SVG_LINE_HEIGHT / 2;
+  }
+
+  fprintf (f, "</svg>\n");
+  return !ferror (f);
+}
+
+
+/*
+ * StripGraph_svgcolor
+ *
+ * Writes the color as "#rrggbb" into buf, which must hold 8 chars.
+ */
+static void StripGraph_svgcolor (char *buf, cColor *color)
+{
+  sprintf
+    (buf, "#%02x%02x%02x",
+     color->xcolor.red >> 8, color->xcolor.green >> 8,
+     color->xcolor.blue >> 8);
+}
+
+
 /*
  * StripGraph_print
  */
@@ -1275,10 +1784,10 @@ static void     callback        (Widget w, XtPointer client, XtPointer call)
   {
     XjLegendCallbackStruct *cbs = (XjLegendCallbackStruct *)call;
     
-    for (i = 0; i < STRIP_MAX_CURVES; i++)
-      if (sgi->lgitems[i] == cbs->item)
+    for (i = 0; i < sgi->n_curves; i++)
+      if (sgi->curves[i].lgitem == cbs->item)
       {
-        sgi->selected_curve = sgi->curves[i];
+        sgi->selected_curve = sgi->curves[i].curve;
         {
           /* re-arrange the plot order */
           int shift;
@@ -1391,33 +1900,71 @@ int StripAuto_min_max (StripDataSource sds, char *sgiP)
 }
 
 
+/*
+ * CurveLegendRefresh
+ *
+ *      Notes the curve's new value, a.  It is shown by the next
+ *      StripGraph_updatelegend().
+ */
 void CurveLegendRefresh(StripCurveInfo *c, StripGraph sg, double a)
+{
+  int i;
+  StripGraphInfo        *sgi = (StripGraphInfo *)sg;
+
+    for (i = 0; i < sgi->n_curves; i++)
+      if (sgi->curves[i].curve == c)
+      {
+        sgi->curves[i].lgvalue = a;
+        if (!sgi->curves[i].lgdirty)
+        {
+          sgi->curves[i].lgdirty = 1;
+          sgi->n_lgdirty++;
+        }
+      }
+}
+
+
+/*
+ * StripGraph_updatelegend
+ */
+void StripGraph_updatelegend (StripGraph sg)
 {
   char buf[256];
   int i;
   StripGraphInfo        *sgi = (StripGraphInfo *)sg;
   LegendWidget cw = (LegendWidget) sgi->legend;
+  struct timeval now, t;
+
+    if (sgi->n_lgdirty == 0) return;
 
-    for (i = 0; i < STRIP_MAX_CURVES; i++)
-      if (sgi->curves[i])
+    get_current_time (&now);
+    if (subtract_times (&t, &sgi->lgtime, &now) <
+        sgi->config->Time.legend_interval)
+      return;
+    sgi->lgtime = now;
+    sgi->n_lgdirty = 0;
+    
+    for (i = 0; i < sgi->n_curves; i++)
+      if (sgi->curves[i].curve && sgi->curves[i].lgdirty)
       {
-	if (strcmp(sgi->curves[i]->details->name,c->details->name)) continue;
+        sgi->curves[i].lgdirty = 0;
         sprintf
           (buf,
-           sgi->curves[i]->details->scale == STRIPSCALE_LOG_10?
+           sgi->curves[i].curve->details->scale == STRIPSCALE_LOG_10?
            "log10 (%g, %g) VAL=%g" : "(%g, %g) VAL=%g",
-           sgi->curves[i]->details->min, sgi->curves[i]->details->max,
-	   sgi->curves[i]->get_value(sgi->curves[i]->func_data) );
+           sgi->curves[i].curve->details->min,
+           sgi->curves[i].curve->details->max,
+	   sgi->curves[i].lgvalue );
 
         XjLegendValueUpdateItem
           (sgi->legend,
-           sgi->lgitems[i],
-           sgi->curves[i]->details->name,
+           sgi->curves[i].lgitem,
+           sgi->curves[i].curve->details->name,
            buf,
-           strcmp (sgi->curves[i]->details->egu, STRIPDEF_CURVE_EGU)?
-           sgi->curves[i]->details->egu : 0,
-           sgi->curves[i]->details->comment,
-           sgi->curves[i]->details->color->xcolor.pixel);
+           strcmp (sgi->curves[i].curve->details->egu, STRIPDEF_CURVE_EGU)?
+           sgi->curves[i].curve->details->egu : 0,
+           sgi->curves[i].curve->details->comment,
+           sgi->curves[i].curve->details->color->xcolor.pixel);
       }
     
     LegendRefresh(cw);
@@ -1426,18 +1973,13 @@ void CurveLegendRefresh(StripCurveInfo *c, StripGraph sg, double a)
 jlaTransformInfo* StripGraph_getTransform(StripGraph the_sgi, StripCurveInfo *curve)
 {
   StripGraphInfo        *sgi = (StripGraphInfo *)the_sgi;
-  int m,n;
+  int n;
 
   if (!curve) return 0;
 
-  /* for each plotted curve ... */
-  for (m = 0; m < STRIP_MAX_CURVES; m++)
-  {
-    n = sgi->config->Curves.plot_order[m];
-    if (curve == sgi->curves[n]) {
-      return &sgi->transforms[n];
-    } 
-  }
+  for (n = 0; n < sgi->n_curves; n++)
+    if (curve == sgi->curves[n].curve)
+      return &sgi->curves[n].transform;
   return  0;
 }
 
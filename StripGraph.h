@@ -155,6 +155,17 @@ int     StripGraph_dumpdata     (StripGraph, FILE *);
 int     StripGraph_dumpdata_csv     (StripGraph, FILE *);
 
 
+/*
+ * StripGraph_dumpsvg
+ *
+ *      Writes the graph as it is now (data on the current time range,
+ *      axes, grid, annotations and legend) to the specified file, as an
+ *      SVG image.  The image is drawn from the data source, not read
+ *      back from the window, so the window needn't be visible.
+ */
+int     StripGraph_dumpsvg      (StripGraph, FILE *);
+
+
 #ifdef USE_SDDS
 /*
  * StripGraph_dumpdata_sdds
@@ -179,6 +190,15 @@ unsigned        StripGraph_clearstat    (StripGraph, unsigned);
  
 int StripAuto_min_max (StripDataSource sds, char *sgi) ; /* Albert */
 void CurveLegendRefresh(StripCurveInfo *c, StripGraph sg, double a);  /* Albert */
+
+/*
+ * StripGraph_updatelegend
+ *
+ *      Shows the values of the curves which have changed since the last
+ *      call, in one legend redraw.  Does nothing if the last call was
+ *      less than the configured legend interval ago.
+ */
+void StripGraph_updatelegend (StripGraph);
 #endif
 
 
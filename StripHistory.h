@@ -136,4 +136,26 @@ FetchStatus     StripHistory_fetch      (StripHistory,
  *      has no effect.
  */
 void            StripHistory_cancel     (StripHistory, StripHistoryResult *);
+
+
+/* StripHistory_wait
+ *
+ *      Blocks until all pending transactions have completed, issuing
+ *      their callbacks.  This allows a client to send off requests for
+ *      several curves at once, so that they may be serviced concurrently,
+ *      and then collect all of the results.
+ */
+void            StripHistory_wait       (StripHistory);
+
+
+/* StripHistory_resolution
+ *
+ *      Tells the history module how far apart in time the points of
+ *      subsequent fetches need to be, which is the width of a plot bin
+ *      (0 for all of the points).  A module fetching reduced data from
+ *      its archiver can then ask for no more points than can be shown,
+ *      fetching again at a finer resolution when the plot zooms in.
+ *      Others ignore it.
+ */
+void            StripHistory_resolution (StripHistory, double);
 #endif
@@ -13,14 +13,158 @@
 #include "StripDataSource.h"
 #include "getHistory.h"
 #include <time.h>
+#ifdef STRIP_ASYNC_HISTORY
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
 
 #define DEBUG 0
 
+/* history cache
+ *
+ *      Fetched history is kept per channel as a list of chunks, sorted by
+ *      time, each one recording the interval it covers.  A fetch only asks
+ *      the archiver for the gaps, that is, the parts of the range which
+ *      are not covered yet.  It then merges the chunks on the range into
+ *      one, and the result points straight into that chunk.  A chunk
+ *      which some result points into is freed only after the result
+ *      releases it.  The cache is kept under STRIP_MAX_CACHE_BYTES by
+ *      dropping the least recently used chunks.
+ *
+ *      The archiver may not have caught up with the last few seconds, so
+ *      for recent gaps only the interval up to the last sample returned
+ *      is taken as covered.
+ *
+ *      Each channel keeps its chunks on several levels of detail.  Level 0
+ *      holds all of the points.  With AAPI, the server reduces the data to
+ *      the resolution asked for (see StripHistory_resolution()), which is
+ *      rounded down to that of a level: level n has CACHE_TILE_POINTS
+ *      points per tile of 2^(n-1) seconds, tiles starting on multiples of
+ *      their length.  Requests on the reduced levels are widened to whole
+ *      tiles, so the gaps are runs of missing tiles.  Zooming out and back
+ *      in thus finds the tiles of both levels still in the cache, and
+ *      scrolling only fetches the tiles coming into view.  The reduced
+ *      levels are dropped when the reduction method changes.
+ */
+#define CACHE_MAX_GAPS          8       /* gaps fetched per request */
+#define CACHE_ARCHIVER_LAG      60.0    /* seconds */
+#define CACHE_LEVELS            28      /* tiles of up to 2^26 seconds */
+#define CACHE_TILE_POINTS       256
+#define CACHE_POINT_BYTES \
+(sizeof (struct timeval) + sizeof (double) + sizeof (short))
+
+typedef struct _HistoryChunk
+{
+  struct _HistoryChunk  *next;          /* next later chunk */
+  struct timeval        t0, t1;         /* interval covered */
+  struct timeval        *times;
+  double                *data;
+  short                 *status;
+  int                   n_points;
+  int                   refs;           /* results pointing into it */
+  int                   retired;        /* no longer in the cache */
+  unsigned long         used;           /* cache clock at last use */
+}
+HistoryChunk;
+
+typedef struct _HistoryChannel
+{
+  struct _HistoryChannel        *next;
+  char                          name[STRIP_MAX_NAME_CHAR+1];
+  HistoryChunk                  *levels[CACHE_LEVELS];
+  long                          method; /* of the reduced levels */
+}
+HistoryChannel;
+
+typedef struct _HistoryLease
+{
+  struct _HistoryLease  *next;
+  StripHistoryResult    *result;
+  HistoryChunk          *chunk;
+}
+HistoryLease;
+
+typedef struct _HistoryGap
+{
+  struct timeval        t0, t1;
+  struct timeval        fetched;        /* when it was fetched */
+  int                   level;
+  HistoryFetchInfo      info;           /* settings, message */
+  unsigned long         err;
+  unsigned long         count;
+  struct timeval        *times;
+  short                 *status;
+  double                *data;
+}
+HistoryGap;
+
+static HistoryChannel   *cache_channel  (StripHistoryInfo *, char *);
+static int              cache_level     (double, long *);
+static int              cache_gaps      (HistoryChannel *, int,
+                                         struct timeval *, struct timeval *,
+                                         HistoryGap *);
+static void             cache_insert    (StripHistoryInfo *, HistoryChannel *,
+                                         HistoryGap *);
+static HistoryChunk     *cache_merge    (StripHistoryInfo *, HistoryChannel *,
+                                         int,
+                                         struct timeval *, struct timeval *);
+static FetchStatus      cache_result    (StripHistoryInfo *, HistoryChannel *,
+                                         int,
+                                         struct timeval *, struct timeval *,
+                                         StripHistoryResult *);
+static void             cache_flush     (StripHistoryInfo *, HistoryChannel *);
+static void             cache_unlease   (StripHistoryInfo *,
+                                         StripHistoryResult *);
+static void             cache_drop      (StripHistoryInfo *, HistoryChunk *);
+static void             cache_trim      (StripHistoryInfo *, HistoryChunk *);
+static void             cache_free      (StripHistoryInfo *);
+static void             fetch_gap       (StripHistoryInfo *, char *,
+                                         HistoryGap *);
+static void             free_gap        (HistoryGap *);
+static void             report_gap      (StripHistoryInfo *, HistoryGap *);
+
+#ifdef STRIP_ASYNC_HISTORY
+/* StripHistoryRequest
+ *
+ *      A fetch handed to the worker thread.  The name and time range are
+ *      copied, since the caller's may change before the fetch is made.
+ */
+typedef struct _StripHistoryRequest
+{
+  struct _StripHistoryRequest   *next;
+  char                          name[STRIP_MAX_NAME_CHAR+1];
+  struct timeval                begin, end;
+  int                           level;
+  StripHistoryResult            *result;
+  StripHistoryCallback          callback;
+  void                          *call_data;
+  int                           canceled;
+  HistoryGap                    gaps[CACHE_MAX_GAPS];
+  int                           n_gaps;
+  int                           n_fetched;      /* by the worker */
+}
+StripHistoryRequest;
+
+static int      start_worker    (StripHistoryInfo *);
+static void     stop_worker     (StripHistoryInfo *);
+static void     *fetch_thread   (void *);
+static void     deliver_cb      (XtPointer, int *, XtInputId *);
+static void     append_request  (StripHistoryRequest **, StripHistoryRequest *);
+static void     discard_request (StripHistoryRequest *);
+#endif
+
 /*#ifdef USE_AAPI TODO */
 extern char **algorithmString;
 extern int algorithmLength;
 
 /* #endif */
+#ifdef USE_AAPI
+extern long radioBoxAlgorithm;
+#endif
+#ifdef STRIP_HISTORY
+extern unsigned int historySize;
+#endif
 
 /* StripHistory_init
  */
@@ -31,6 +175,23 @@ StripHistory    StripHistory_init       (Strip strip)
   if ((shi = (StripHistoryInfo *)malloc (sizeof(StripHistoryInfo))))
   {
     shi->strip = strip;
+    shi->cache = NULL;
+    shi->leases = NULL;
+    shi->cache_bytes = 0;
+    shi->cache_clock = 0;
+    shi->resolution = 0;
+#ifdef STRIP_ASYNC_HISTORY
+    /* the worker is started with the first asynchronous fetch, since
+     * the application context does not exist yet */
+    shi->async = 0;
+    shi->shutdown = 0;
+    shi->queue = shi->busy = shi->done = NULL;
+    shi->pipe_fd[0] = shi->pipe_fd[1] = -1;
+#ifndef STRIP_HISTORY_REENTRANT
+    /* fetches are serialized whether or not the worker ever starts */
+    pthread_mutex_init (&shi->fetch_lock, NULL);
+#endif
+#endif
   } 
   else
     {
@@ -57,6 +218,10 @@ StripHistory    StripHistory_init       (Strip strip)
      fprintf(stderr,"StripHistory_init: can't init CAR\n");
      exit(1);
     }
+
+  /* CAR returns raw data, which the data source reduces itself */
+  algorithmString = sdsReductionString;
+  algorithmLength = SDS_REDUCE_LAST;
 #endif
   return (StripHistory)shi;  
 }
@@ -67,6 +232,13 @@ void    StripHistory_delete     (StripHistory the_shi)
 {
   StripHistoryInfo      *shi = (StripHistoryInfo *)the_shi;
 
+#ifdef STRIP_ASYNC_HISTORY
+  stop_worker (shi);
+#ifndef STRIP_HISTORY_REENTRANT
+  pthread_mutex_destroy (&shi->fetch_lock);
+#endif
+#endif
+  cache_free (shi);
 #ifdef USE_AAPI
   AAPI_free();
 #endif
@@ -86,48 +258,100 @@ FetchStatus     StripHistory_fetch      (StripHistory           the_shi,
                                          StripHistoryCallback   callback,
                                          void                   *call_data)
 {
+  StripHistoryInfo      *shi = (StripHistoryInfo *)the_shi;
+  HistoryChannel        *ch;
+  HistoryGap            gaps[CACHE_MAX_GAPS];
+  struct timeval        from, to;
+  long                  tile;
+  int                   n_gaps, level, i;
+#ifdef STRIP_ASYNC_HISTORY
+  StripHistoryRequest   *req;
 
-  unsigned long err;
+  /* a new request supersedes any outstanding one for this result */
+  StripHistory_cancel (the_shi, result);
+#endif
 
-  struct timeval *times=NULL;
-  short  *status=NULL;
-  double *data=NULL;
-  unsigned long count=0;
-  
   result->t0 = *begin;
   result->t1 = *end;
-  result->n_points = 0;
-  result->fetch_stat=FETCH_NODATA;
   
-  if((err=getHistory(the_shi,name,begin,end,&times,&status,&data,&count)) != 0) 
-    {
-      fprintf(stderr,"err=%ld:bad getHistory; no goodData \n",err);
-      return (FETCH_NODATA);
-    }
-  if(count < 1)
-    {
-      if(DEBUG) fprintf(stderr,"getHistory; no goodData count=%lu\n",count);
-      return (FETCH_NODATA);
-    }
+  if (!(ch = cache_channel (shi, name)))
+  {
+    cache_unlease (shi, result);
+    result->fetch_stat = FETCH_NODATA;
+    return result->fetch_stat;
+  }
+#ifdef USE_AAPI
+  level = cache_level (shi->resolution, &tile);
+  if (ch->method != radioBoxAlgorithm)
+  {
+    cache_flush (shi, ch);
+    ch->method = radioBoxAlgorithm;
+  }
+#else
+  /* the other archivers always return all of the points */
+  level = cache_level (0, &tile);
+#endif
+
+  /* whole tiles only */
+  from = *begin;
+  to = *end;
+  if (level > 0)
+  {
+    from.tv_sec -= from.tv_sec % tile;
+    from.tv_usec = 0;
+    if ((to.tv_sec % tile) || to.tv_usec)
+      to.tv_sec += tile - to.tv_sec % tile;
+    to.tv_usec = 0;
+  }
+  n_gaps = cache_gaps (ch, level, &from, &to, gaps);
+  for (i = 0; i < n_gaps; i++)
+  {
+#ifdef STRIP_HISTORY
+    gaps[i].info.history_size = historySize;
+#else
+    gaps[i].info.history_size = 0;      /* no archiver client */
+#endif
+  }
+  if(DEBUG) printf("%s: StripHistory_fetch: %d gaps\n",name,n_gaps);
   
-  if ((compare_times (begin, &times[count-1]) <= 0) &&
-      (compare_times (end, &times[0]) >= 0) &&
-      (compare_times (begin, end) <= 0))
-    {
-      result->times      = times;
-      result->data       = data;
-      result->status     = status;
-      result->n_points   = count;
-      result->fetch_stat = FETCH_DONE;
-    }
-  else 
+#ifdef STRIP_ASYNC_HISTORY
+  if ((n_gaps > 0) && callback && start_worker (shi))
+  {
+    if ((req = (StripHistoryRequest *)calloc (1, sizeof (StripHistoryRequest))))
     {
-      if(DEBUG) 
-	{
-	  printf("StripHistory_fetch: Compare problem \n");
-	}
-      result->fetch_stat = FETCH_NODATA;
+      strncpy (req->name, name, STRIP_MAX_NAME_CHAR);
+      req->begin = *begin;
+      req->end = *end;
+      req->level = level;
+      req->result = result;
+      req->callback = callback;
+      req->call_data = call_data;
+      memcpy (req->gaps, gaps, n_gaps * sizeof (HistoryGap));
+      req->n_gaps = n_gaps;
+      
+      result->n_points = 0;
+      result->fetch_stat = FETCH_PENDING;
+
+      pthread_mutex_lock (&shi->lock);
+      append_request (&shi->queue, req);
+      pthread_cond_signal (&shi->wakeup);
+      pthread_mutex_unlock (&shi->lock);
+      
+      if(DEBUG) printf("%s: StripHistory_fetch: queued\n",name);
+      return FETCH_PENDING;
     }
+    /* otherwise just fetch it here */
+  }
+#endif
+
+  for (i = 0; i < n_gaps; i++)
+  {
+    fetch_gap (shi, name, &gaps[i]);
+    report_gap (shi, &gaps[i]);
+    cache_insert (shi, ch, &gaps[i]);
+  }
+  
+  cache_result (shi, ch, level, begin, end, result);
   if(DEBUG) printf("%s: StripHistory_fetch: OK\n",name);
   return result->fetch_stat;
 }
@@ -137,16 +361,867 @@ FetchStatus     StripHistory_fetch      (StripHistory           the_shi,
 void    StripHistory_cancel     (StripHistory           the_shi,
                                  StripHistoryResult     *result)
 {
+#ifdef STRIP_ASYNC_HISTORY
+  StripHistoryInfo      *shi = (StripHistoryInfo *)the_shi;
+  StripHistoryRequest   **preq, *req, *dropped = NULL;
+
+  if (!shi->async) return;
+
+  pthread_mutex_lock (&shi->lock);
+
+  /* requests still waiting are simply dropped */
+  for (preq = &shi->queue; *preq; )
+    if ((*preq)->result == result)
+    {
+      req = *preq;
+      *preq = req->next;
+      req->next = dropped;
+      dropped = req;
+    }
+    else preq = &(*preq)->next;
+
+  /* the one being fetched, or already fetched, is thrown away when
+   * it comes back */
+  for (req = shi->busy; req; req = req->next)
+    if (req->result == result)
+      req->canceled = 1;
+  for (req = shi->done; req; req = req->next)
+    if (req->result == result)
+      req->canceled = 1;
+  
+  pthread_mutex_unlock (&shi->lock);
+
+  while ((req = dropped))
+  {
+    dropped = req->next;
+    discard_request (req);
+  }
+
+  if (result->fetch_stat == FETCH_PENDING)
+    result->fetch_stat = FETCH_IDLE;
+#endif
+}
+
+
+/* StripHistory_wait
+ */
+void    StripHistory_wait       (StripHistory the_shi)
+{
+#ifdef STRIP_ASYNC_HISTORY
+  StripHistoryInfo      *shi = (StripHistoryInfo *)the_shi;
+  int                   more;
+
+  if (!shi->async) return;
+
+  /* the callbacks may well issue new requests */
+  for (;;)
+  {
+    pthread_mutex_lock (&shi->lock);
+    while (shi->queue || shi->busy)
+      pthread_cond_wait (&shi->idle, &shi->lock);
+    more = (shi->done != NULL);
+    pthread_mutex_unlock (&shi->lock);
+
+    if (!more) break;
+    deliver_cb ((XtPointer)shi, &shi->pipe_fd[0], NULL);
+  }
+#endif
+}
+/* StripHistory_resolution
+ */
+void    StripHistory_resolution (StripHistory the_shi, double resolution)
+{
+  ((StripHistoryInfo *)the_shi)->resolution = resolution;
 }
+
+
 /* StripHistoryResult_release
  */
-void  StripHistoryResult_release    (StripHistory           BOGUS(the_shi),
+void  StripHistoryResult_release    (StripHistory           the_shi,
                                      StripHistoryResult     *result)
 {
-#ifdef USE_AAPI
-AAPI_Result_release(result);
+  /* the data belongs to the cache */
+  StripHistory_cancel (the_shi, result);
+  cache_unlease ((StripHistoryInfo *)the_shi, result);
+  result->times = NULL;
+  result->data = NULL;
+  result->status = NULL;
+  result->n_points = 0;
+}
+
+
+/* cache_channel
+ *
+ *      Returns the cache entry for the named channel, creating it if
+ *      need be.  Returns NULL if there is not enough memory.
+ */
+static HistoryChannel   *cache_channel  (StripHistoryInfo *shi, char *name)
+{
+  HistoryChannel        *ch;
+
+  for (ch = shi->cache; ch; ch = ch->next)
+    if (strcmp (ch->name, name) == 0)
+      return ch;
+
+  if ((ch = (HistoryChannel *)calloc (1, sizeof (HistoryChannel))))
+  {
+    strncpy (ch->name, name, STRIP_MAX_NAME_CHAR);
+    ch->next = shi->cache;
+    shi->cache = ch;
+  }
+  else fprintf (stderr, "StripHistory: can't allocate cache for %s\n", name);
+
+  return ch;
+}
+
+
+/* cache_level
+ *
+ *      Returns the level holding data of at least the given resolution
+ *      (0 for all of the points), and the length of its tiles in seconds.
+ */
+static int              cache_level     (double resolution, long *tile)
+{
+  int                   level = 0;
+
+  *tile = 0;
+  if (resolution > 0)
+    for (level = 1, *tile = 1;
+         (level < CACHE_LEVELS - 1) &&
+           (2.0 * *tile <= resolution * CACHE_TILE_POINTS);
+         level++)
+      *tile *= 2;
+  return level;
+}
+
+
+/* cache_gaps
+ *
+ *      Writes the parts of [begin, end] which the chunks on the given
+ *      level do not cover into gaps, returning their number.  If there
+ *      are more than CACHE_MAX_GAPS, the last one is stretched to the end
+ *      of the range.
+ */
+static int              cache_gaps      (HistoryChannel *ch,
+                                         int            level,
+                                         struct timeval *begin,
+                                         struct timeval *end,
+                                         HistoryGap     *gaps)
+{
+  HistoryChunk          *c;
+  struct timeval        from = *begin;  /* start of what is left */
+  int                   n = 0;
+
+#define ADD_GAP(a,b)                                                    \
+  do {                                                                  \
+    if (n < CACHE_MAX_GAPS)                                             \
+    {                                                                   \
+      memset (&gaps[n], 0, sizeof (HistoryGap));                        \
+      gaps[n].t0 = (a);                                                 \
+      gaps[n].t1 = (b);                                                 \
+      gaps[n].level = level;                                            \
+      gaps[n].info.method = ch->method;                                 \
+      n++;                                                              \
+    }                                                                   \
+    else gaps[n-1].t1 = *end;                                           \
+  } while (0)
+
+  for (c = ch->levels[level];
+       c && (compare_times (&from, end) < 0);
+       c = c->next)
+  {
+    if (compare_times (&c->t1, &from) < 0) continue;
+    if (compare_times (&c->t0, end) > 0) break;
+    if (compare_times (&c->t0, &from) > 0)
+      ADD_GAP (from, c->t0);
+    if (compare_times (&c->t1, &from) > 0)
+      from = c->t1;
+  }
+  if (compare_times (&from, end) < 0)
+    ADD_GAP (from, *end);
+
+#undef ADD_GAP
+
+  return n;
+}
+
+
+/* cache_insert
+ *
+ *      Turns a fetched gap into a chunk on its level of the channel, which
+ *      takes over its arrays.  Data reduced by a method no longer in use
+ *      is thrown away.
+ */
+static void             cache_insert    (StripHistoryInfo       *shi,
+                                         HistoryChannel         *ch,
+                                         HistoryGap             *gap)
+{
+  HistoryChunk          *c, **pc;
+  struct timeval        t1 = gap->t1;
+
+  if (gap->err != 0)
+  {
+    fprintf(stderr,"err=%ld:bad getHistory; no goodData \n",gap->err);
+    free_gap (gap);
+    return;
+  }
+
+  if ((gap->level > 0) && (gap->info.method != ch->method))
+  {
+    free_gap (gap);
+    return;
+  }
+
+  /* recent gap?  Then only count on what we got */
+  if (time2dbl (&gap->t1) > time2dbl (&gap->fetched) - CACHE_ARCHIVER_LAG)
+  {
+    if (gap->count < 1)
+    {
+      free_gap (gap);
+      return;
+    }
+    if (compare_times (&gap->times[gap->count-1], &t1) < 0)
+      t1 = gap->times[gap->count-1];
+    if (compare_times (&t1, &gap->t0) < 0)
+    {
+      free_gap (gap);
+      return;
+    }
+  }
+
+  if (!(c = (HistoryChunk *)calloc (1, sizeof (HistoryChunk))))
+  {
+    free_gap (gap);
+    return;
+  }
+  c->t0 = gap->t0;
+  c->t1 = t1;
+  c->times = gap->times;
+  c->data = gap->data;
+  c->status = gap->status;
+  c->n_points = (int)gap->count;
+  c->used = ++shi->cache_clock;
+  shi->cache_bytes += c->n_points * CACHE_POINT_BYTES;
+  gap->times = NULL;
+  gap->data = NULL;
+  gap->status = NULL;
+  gap->count = 0;
+
+  for (pc = &ch->levels[gap->level]; *pc; pc = &(*pc)->next)
+    if (compare_times (&(*pc)->t0, &c->t0) > 0)
+      break;
+  c->next = *pc;
+  *pc = c;
+}
+
+
+/* cache_merge
+ *
+ *      Replaces the run of chunks on the level which touch [begin, end]
+ *      and each other, starting from the first of them, with a single
+ *      one, which is returned (NULL if there are none).  Each chunk only
+ *      contributes the samples on the interval it covers, and samples
+ *      are kept in time order.  Chunks past a hole left by a failed
+ *      fetch are kept as they are, so that none of their samples lie
+ *      outside the interval the merged chunk claims to cover.
+ */
+static HistoryChunk     *cache_merge    (StripHistoryInfo       *shi,
+                                         HistoryChannel         *ch,
+                                         int                    level,
+                                         struct timeval         *begin,
+                                         struct timeval         *end)
+{
+  HistoryChunk          **pfirst, *c, *stop, *m;
+  struct timeval        *last, *t1;
+  int                   n_chunks, n, i;
+
+  for (pfirst = &ch->levels[level]; *pfirst; pfirst = &(*pfirst)->next)
+    if (compare_times (&(*pfirst)->t1, begin) >= 0)
+      break;
+
+  n_chunks = n = 0;
+  t1 = NULL;
+  for (c = *pfirst; c && (compare_times (&c->t0, end) <= 0); c = c->next)
+  {
+    if (t1 && (compare_times (&c->t0, t1) > 0)) break;
+    if (!t1 || (compare_times (&c->t1, t1) > 0)) t1 = &c->t1;
+    n_chunks++;
+    n += c->n_points;
+  }
+  stop = c;
+
+  if (n_chunks == 0) return NULL;
+  if (n_chunks == 1) return *pfirst;
+
+  if (!(m = (HistoryChunk *)calloc (1, sizeof (HistoryChunk))) ||
+      ((n > 0) &&
+       (!(m->times = (struct timeval *)malloc (n * sizeof (struct timeval))) ||
+        !(m->data = (double *)malloc (n * sizeof (double))) ||
+        !(m->status = (short *)malloc (n * sizeof (short))))))
+  {
+    fprintf (stderr, "StripHistory: can't merge cached history\n");
+    if (m)
+    {
+      if (m->times) free (m->times);
+      if (m->data) free (m->data);
+      free (m);
+    }
+    return *pfirst;
+  }
+
+  m->t0 = (*pfirst)->t0;
+  m->t1 = *t1;
+  last = NULL;
+  n = 0;
+  for (c = *pfirst; c != stop; c = c->next)
+  {
+    for (i = 0; i < c->n_points; i++)
+    {
+      if (compare_times (&c->times[i], &c->t0) < 0) continue;
+      if (compare_times (&c->times[i], &c->t1) > 0) break;
+      if (last && (compare_times (&c->times[i], last) <= 0)) continue;
+      m->times[n] = c->times[i];
+      m->data[n] = c->data[i];
+      m->status[n] = c->status[i];
+      last = &m->times[n];
+      n++;
+    }
+  }
+  m->n_points = n;
+  m->used = ++shi->cache_clock;
+  shi->cache_bytes += n * CACHE_POINT_BYTES;
+
+  /* swap the new chunk in for the old ones */
+  c = *pfirst;
+  *pfirst = m;
+  m->next = stop;
+  while (c != stop)
+  {
+    HistoryChunk        *next = c->next;
+    cache_drop (shi, c);
+    c = next;
+  }
+
+  return m;
+}
+
+
+/* cache_result
+ *
+ *      Points the result at the samples on [begin, end] cached on the
+ *      level.
+ */
+static FetchStatus      cache_result    (StripHistoryInfo       *shi,
+                                         HistoryChannel         *ch,
+                                         int                    level,
+                                         struct timeval         *begin,
+                                         struct timeval         *end,
+                                         StripHistoryResult     *result)
+{
+  HistoryChunk          *c;
+  HistoryLease          *l = NULL;
+  int                   i0, i1, lo, hi, mid;
+
+  result->t0 = *begin;
+  result->t1 = *end;
+  result->n_points = 0;
+  result->fetch_stat = FETCH_NODATA;
+  
+  c = (ch? cache_merge (shi, ch, level, begin, end) : NULL);
+  cache_unlease (shi, result);
+  result->times = NULL;
+  result->data = NULL;
+  result->status = NULL;
+  
+  if (c && (compare_times (begin, end) <= 0))
+  {
+    /* first sample at or after begin */
+    for (lo = 0, hi = c->n_points; lo < hi; )
+    {
+      mid = (lo + hi) / 2;
+      if (compare_times (&c->times[mid], begin) < 0) lo = mid + 1;
+      else hi = mid;
+    }
+    i0 = lo;
+    
+    /* last sample at or before end */
+    for (lo = i0, hi = c->n_points; lo < hi; )
+    {
+      mid = (lo + hi) / 2;
+      if (compare_times (&c->times[mid], end) <= 0) lo = mid + 1;
+      else hi = mid;
+    }
+    i1 = lo - 1;
+
+    if ((i0 <= i1) && (l = (HistoryLease *)malloc (sizeof (HistoryLease))))
+    {
+      l->result = result;
+      l->chunk = c;
+      l->next = shi->leases;
+      shi->leases = l;
+      c->refs++;
+      c->used = ++shi->cache_clock;
+      
+      result->times      = c->times + i0;
+      result->data       = c->data + i0;
+      result->status     = c->status + i0;
+      result->n_points   = i1 - i0 + 1;
+      result->fetch_stat = FETCH_DONE;
+    }
+  }
+  if ((result->fetch_stat != FETCH_DONE) && DEBUG)
+    printf("StripHistory_fetch: no data on range\n");
+
+  cache_trim (shi, c);
+  return result->fetch_stat;
+}
+
+
+/* cache_unlease
+ *
+ *      Lets go of the chunk the result points into, if any.
+ */
+static void             cache_unlease   (StripHistoryInfo       *shi,
+                                         StripHistoryResult     *result)
+{
+  HistoryLease          **pl, *l;
+
+  for (pl = &shi->leases; *pl; pl = &(*pl)->next)
+    if ((*pl)->result == result)
+      break;
+  if (!(l = *pl)) return;
+
+  *pl = l->next;
+  l->chunk->refs--;
+  if (l->chunk->retired && (l->chunk->refs == 0))
+    cache_drop (shi, l->chunk);
+  free (l);
+}
+
+
+/* cache_drop
+ *
+ *      Frees a chunk which has been taken out of its channel, or marks it
+ *      to be freed once no result points into it.
+ */
+static void             cache_drop      (StripHistoryInfo       *shi,
+                                         HistoryChunk           *c)
+{
+  /* only chunks still in the cache count against its size */
+  if (!c->retired)
+    shi->cache_bytes -= c->n_points * CACHE_POINT_BYTES;
+  
+  if (c->refs > 0)
+  {
+    c->retired = 1;
+    return;
+  }
+  
+  if (c->times) free (c->times);
+  if (c->data) free (c->data);
+  if (c->status) free (c->status);
+  free (c);
+}
+
+
+/* cache_trim
+ *
+ *      Drops the least recently used chunks, other than keep, until the
+ *      cache fits in STRIP_MAX_CACHE_BYTES.
+ */
+static void             cache_trim      (StripHistoryInfo       *shi,
+                                         HistoryChunk           *keep)
+{
+  HistoryChannel        *ch;
+  HistoryChunk          **pc, **lru, *c;
+  int                   level;
+
+  while (shi->cache_bytes > STRIP_MAX_CACHE_BYTES)
+  {
+    lru = NULL;
+    for (ch = shi->cache; ch; ch = ch->next)
+      for (level = 0; level < CACHE_LEVELS; level++)
+        for (pc = &ch->levels[level]; *pc; pc = &(*pc)->next)
+          if ((*pc != keep) && (!lru || ((*pc)->used < (*lru)->used)))
+            lru = pc;
+    if (!lru) break;
+    
+    c = *lru;
+    *lru = c->next;
+    cache_drop (shi, c);
+  }
+}
+
+
+/* cache_flush
+ *
+ *      Drops the chunks on the reduced levels of the channel.
+ */
+static void             cache_flush     (StripHistoryInfo       *shi,
+                                         HistoryChannel         *ch)
+{
+  HistoryChunk          *c;
+  int                   level;
+
+  for (level = 1; level < CACHE_LEVELS; level++)
+    while ((c = ch->levels[level]))
+    {
+      ch->levels[level] = c->next;
+      cache_drop (shi, c);
+    }
+}
+
+
+/* cache_free
+ */
+static void             cache_free      (StripHistoryInfo *shi)
+{
+  HistoryChannel        *ch;
+  HistoryChunk          *c;
+  HistoryLease          *l;
+
+  while ((l = shi->leases))
+  {
+    shi->leases = l->next;
+    if ((--l->chunk->refs == 0) && l->chunk->retired)
+      cache_drop (shi, l->chunk);
+    free (l);
+  }
+  while ((ch = shi->cache))
+  {
+    shi->cache = ch->next;
+    cache_flush (shi, ch);
+    while ((c = ch->levels[0]))
+    {
+      ch->levels[0] = c->next;
+      cache_drop (shi, c);
+    }
+    free (ch);
+  }
+}
+
+
+/* fetch_gap
+ *
+ *      Asks the archiver for the data on the gap.
+ */
+static void             fetch_gap       (StripHistoryInfo       *shi,
+                                         char                   *name,
+                                         HistoryGap             *gap)
+{
+  gap->times = NULL;
+  gap->status = NULL;
+  gap->data = NULL;
+  gap->count = 0;
+  gap->info.resolution = (gap->level > 0)?
+    (double)(1L << (gap->level - 1)) / CACHE_TILE_POINTS : 0;
+  gap->info.msg_title = NULL;
+  gap->info.msg[0] = 0;
+  
+#if defined(STRIP_ASYNC_HISTORY) && !defined(STRIP_HISTORY_REENTRANT)
+  pthread_mutex_lock (&shi->fetch_lock);
 #endif
-#ifdef USE_CAR
-CAR_Result_release(result);
+  gap->err = getHistory
+    ((StripHistory)shi, name, &gap->t0, &gap->t1,
+     &gap->times, &gap->status, &gap->data, &gap->count, &gap->info);
+#if defined(STRIP_ASYNC_HISTORY) && !defined(STRIP_HISTORY_REENTRANT)
+  pthread_mutex_unlock (&shi->fetch_lock);
 #endif
+  get_current_time (&gap->fetched);
+  if(DEBUG) printf("%s: fetched %lu points\n",name,gap->count);
+}
+
+
+/* report_gap
+ *
+ *      Shows the user any message the archiver client left on a fetched
+ *      gap, or prints it without a Strip (batch mode), where there is no
+ *      window to show it in.  Only called from the main thread.
+ */
+static void             report_gap      (StripHistoryInfo       *shi,
+                                         HistoryGap             *gap)
+{
+  size_t                n;
+  
+  if (gap->info.msg_title)
+  {
+    if (shi->strip)
+      History_MessageBox_popup (gap->info.msg_title, "OK", gap->info.msg);
+    else
+    {
+      n = strlen (gap->info.msg);
+      fprintf (stderr, "StripHistory: %s: %s%s", gap->info.msg_title,
+               gap->info.msg, (n && gap->info.msg[n-1] == '\n')? "" : "\n");
+    }
+  }
+  gap->info.msg_title = NULL;
+}
+
+
+/* free_gap
+ *
+ *      Frees the arrays of a fetched gap, which getHistory() allocates
+ *      with calloc().
+ */
+static void             free_gap        (HistoryGap *gap)
+{
+  if (gap->count > 0)
+  {
+    if (gap->times) free (gap->times);
+    if (gap->data) free (gap->data);
+    if (gap->status) free (gap->status);
+  }
+  gap->times = NULL;
+  gap->data = NULL;
+  gap->status = NULL;
+  gap->count = 0;
+}
+
+
+#ifdef STRIP_ASYNC_HISTORY
+/* start_worker
+ *
+ *      Starts the fetch threads and registers the delivery pipe with the
+ *      main loop, if not already done.  Returns false if asynchronous
+ *      fetches are unavailable, in which case fetches are synchronous.
+ */
+static int      start_worker    (StripHistoryInfo *shi)
+{
+  static int    failed = 0;
+
+  if (shi->async || failed) return shi->async;
+
+  /* without a Strip (batch mode) there is no event loop to deliver
+   * the results, so everything is fetched synchronously */
+  if (!shi->strip) return 0;
+
+  failed = 1;
+  if (pipe (shi->pipe_fd) != 0)
+  {
+    perror ("StripHistory: can't create pipe");
+    return 0;
+  }
+  fcntl (shi->pipe_fd[0], F_SETFL, O_NONBLOCK);
+  fcntl (shi->pipe_fd[1], F_SETFL, O_NONBLOCK);
+  
+  pthread_mutex_init (&shi->lock, NULL);
+  pthread_cond_init (&shi->wakeup, NULL);
+  pthread_cond_init (&shi->idle, NULL);
+  
+  if (!Strip_addfd
+      (shi->strip, shi->pipe_fd[0], deliver_cb, (XtPointer)shi))
+  {
+    fprintf
+      (stderr,
+       "StripHistory:\n"
+       "  can't watch history pipe, fetching synchronously\n");
+    close (shi->pipe_fd[0]);
+    close (shi->pipe_fd[1]);
+    return 0;
+  }
+
+  /* make do with fewer threads if need be */
+  for (shi->n_threads = 0;
+       shi->n_threads < STRIP_HISTORY_THREADS;
+       shi->n_threads++)
+    if (pthread_create
+        (&shi->threads[shi->n_threads], NULL, fetch_thread, (void *)shi) != 0)
+      break;
+  
+  if (shi->n_threads == 0)
+  {
+    fprintf
+      (stderr,
+       "StripHistory:\n"
+       "  can't start fetch thread, fetching synchronously\n");
+    Strip_clearfd (shi->strip, shi->pipe_fd[0]);
+    close (shi->pipe_fd[0]);
+    close (shi->pipe_fd[1]);
+    return 0;
+  }
+
+  failed = 0;
+  shi->async = 1;
+  return 1;
+}
+
+
+/* stop_worker
+ *
+ *      Waits for the fetch thread to finish its current request, and
+ *      discards everything not yet delivered.
+ */
+static void     stop_worker     (StripHistoryInfo *shi)
+{
+  StripHistoryRequest   *req;
+  int                   i;
+  
+  if (!shi->async) return;
+
+  pthread_mutex_lock (&shi->lock);
+  shi->shutdown = 1;
+  pthread_cond_broadcast (&shi->wakeup);
+  pthread_mutex_unlock (&shi->lock);
+  for (i = 0; i < shi->n_threads; i++)
+    pthread_join (shi->threads[i], NULL);
+
+  Strip_clearfd (shi->strip, shi->pipe_fd[0]);
+  close (shi->pipe_fd[0]);
+  close (shi->pipe_fd[1]);
+
+  while ((req = shi->queue))
+  {
+    shi->queue = req->next;
+    discard_request (req);
+  }
+  while ((req = shi->done))
+  {
+    shi->done = req->next;
+    discard_request (req);
+  }
+
+  pthread_cond_destroy (&shi->idle);
+  pthread_cond_destroy (&shi->wakeup);
+  pthread_mutex_destroy (&shi->lock);
+  shi->async = 0;
+}
+
+
+/* fetch_thread
+ *
+ *      Run by each thread of the pool.  Takes requests off the queue, one
+ *      at a time, and fetches them.  Each finished request is put on the
+ *      done list, and a byte is written to the pipe to wake up the main
+ *      loop.
+ */
+static void     *fetch_thread   (void *arg)
+{
+  StripHistoryInfo      *shi = (StripHistoryInfo *)arg;
+  StripHistoryRequest   *req, **preq;
+  char                  c = 0;
+
+  pthread_mutex_lock (&shi->lock);
+  for (;;)
+  {
+    while (!shi->queue && !shi->shutdown)
+      pthread_cond_wait (&shi->wakeup, &shi->lock);
+    if (shi->shutdown) break;
+
+    req = shi->queue;
+    shi->queue = req->next;
+    req->next = shi->busy;
+    shi->busy = req;
+    pthread_mutex_unlock (&shi->lock);
+
+    /* stop between gaps if the request has been canceled */
+    for (;;)
+    {
+      fetch_gap (shi, req->name, &req->gaps[req->n_fetched]);
+      req->n_fetched++;
+      
+      pthread_mutex_lock (&shi->lock);
+      if (req->canceled || (req->n_fetched >= req->n_gaps)) break;
+      pthread_mutex_unlock (&shi->lock);
+    }
+
+    for (preq = &shi->busy; *preq != req; preq = &(*preq)->next);
+    *preq = req->next;
+    req->next = NULL;
+    append_request (&shi->done, req);
+    pthread_cond_broadcast (&shi->idle);
+
+    /* if the pipe is full, the main loop has a wake-up pending anyway */
+    while (write (shi->pipe_fd[1], &c, 1) < 0)
+      if (errno != EINTR)
+      {
+        if (errno != EAGAIN)
+          perror ("StripHistory: can't wake up main loop");
+        break;
+      }
+  }
+  pthread_mutex_unlock (&shi->lock);
+
+  return NULL;
+}
+
+
+/* deliver_cb
+ *
+ *      Called from the main loop when the fetch thread has finished
+ *      some requests.  The fetched data always goes into the cache, but
+ *      the result is only filled in, and the callback issued, if the
+ *      request has not been canceled in the meantime.
+ */
+static void     deliver_cb      (XtPointer      client_data,
+                                 int            *fd,
+                                 XtInputId      *BOGUS(id))
+{
+  StripHistoryInfo      *shi = (StripHistoryInfo *)client_data;
+  StripHistoryRequest   *req;
+  HistoryChannel        *ch;
+  StripHistoryResult    *result;
+  StripHistoryCallback  callback;
+  void                  *call_data;
+  char                  buf[64];
+  int                   i;
+
+  while (read (*fd, buf, sizeof (buf)) > 0);
+
+  /* take them one at a time, since a callback may well cancel or
+   * supersede some of the others */
+  for (;;)
+  {
+    pthread_mutex_lock (&shi->lock);
+    if ((req = shi->done)) shi->done = req->next;
+    pthread_mutex_unlock (&shi->lock);
+    if (!req) break;
+
+    ch = cache_channel (shi, req->name);
+    for (i = 0; i < req->n_fetched; i++)
+    {
+      report_gap (shi, &req->gaps[i]);
+      if (ch) cache_insert (shi, ch, &req->gaps[i]);
+      else free_gap (&req->gaps[i]);
+    }
+    
+    if (req->canceled)
+    {
+      free (req);
+      continue;
+    }
+
+    result = req->result;
+    callback = req->callback;
+    call_data = req->call_data;
+    cache_result (shi, ch, req->level, &req->begin, &req->end, result);
+    free (req);
+
+    if (callback) callback (result, call_data);
+  }
+}
+
+
+/* append_request
+ */
+static void     append_request  (StripHistoryRequest    **list,
+                                 StripHistoryRequest    *req)
+{
+  while (*list) list = &(*list)->next;
+  req->next = NULL;
+  *list = req;
+}
+
+
+/* discard_request
+ *
+ *      Frees a request along with any data fetched for it.
+ */
+static void     discard_request (StripHistoryRequest *req)
+{
+  int           i;
+
+  for (i = 0; i < req->n_fetched; i++)
+    free_gap (&req->gaps[i]);
+  free (req);
 }
+#endif /* STRIP_ASYNC_HISTORY */
@@ -185,6 +185,21 @@ extern "C" void    StripHistory_cancel     (StripHistory           BOGUS(the_shi
 }
 
 
+/* StripHistory_wait
+ */
+extern "C" void    StripHistory_wait       (StripHistory BOGUS(the_shi))
+{
+}
+
+
+/* StripHistory_resolution
+ */
+extern "C" void    StripHistory_resolution (StripHistory BOGUS(the_shi),
+					    double BOGUS(resolution))
+{
+}
+
+
 /* StripHistoryResult_release
  */
 void  StripHistoryResult_release    (StripHistory           BOGUS(the_shi),
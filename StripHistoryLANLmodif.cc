@@ -55,7 +55,8 @@ int AccessChanArch(ArchiveI *,
 size_t CountSamples(ArchiveI *, 
 		    const stdString &, 
 		    const osiTime &, 
-		    const osiTime &);
+		    const osiTime &,
+		    HistoryFetchInfo *);
 
 static bool VERBOSE = false;
 
@@ -120,7 +121,7 @@ extern "C" void  CAR_Result_release (StripHistoryResult     *result)
  if(result->status)  delete[] result->status;
 }
 
-size_t CountSamples(ArchiveI *archiveI, const stdString &channel_name, const osiTime &start, const osiTime &end)
+size_t CountSamples(ArchiveI *archiveI, const stdString &channel_name, const osiTime &start, const osiTime &end, HistoryFetchInfo *info)
 {
   size_t chunk_size=0, chunk_cumulative=0;
 
@@ -142,11 +143,13 @@ size_t CountSamples(ArchiveI *archiveI, const stdString &channel_name, const osi
       for(size_t i = 0; i < chunk_size; i++) ++value;
       chunk_cumulative += chunk_size;
 
-      if(chunk_cumulative > historySize) {
-	History_MessageBox_popup
-	  ("BIG REQUEST", 
-	   "Ok",
-	   "So many Data from Archiver\nPlease, decrease interval or increase # historyPoints.\n");	
+      if(chunk_cumulative > info->history_size) {
+	// shown by the caller, since this may run on a fetch thread
+	info->msg_title = "BIG REQUEST";
+	strncpy
+	  (info->msg,
+	   "So many Data from Archiver\nPlease, decrease interval or increase # historyPoints.\n",
+	   HISTORY_MSG_LEN - 1);
 	archive.detach();
 	return 2;
       }
@@ -220,7 +223,8 @@ extern "C" u_long get_CAR_data(        StripHistory   the_shi,
 		     struct timeval **timesP,
 		     short          **statusP,
 		     double         **dataP,
-		     u_long *count)
+		     u_long *count,
+		     HistoryFetchInfo *info)
 {
   StripHistoryInfo *shi = (StripHistoryInfo *)the_shi;
   size_t samples;
@@ -231,7 +235,7 @@ extern "C" u_long get_CAR_data(        StripHistory   the_shi,
   try
     {
       ArchiveI* arI=(ArchiveI*) shi->archiverInfo; 
-      samples = CountSamples((ArchiveI*) shi->archiverInfo, name, t0, t1);
+      samples = CountSamples((ArchiveI*) shi->archiverInfo, name, t0, t1, info);
       if(VERBOSE == true)
 	{  
 	  cout << "Requested Channel: " << name << " " << t0 << " - " << t1
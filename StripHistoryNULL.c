@@ -66,6 +66,20 @@ void    StripHistory_cancel     (StripHistory           BOGUS(1),
 }
 
 
+/* StripHistory_wait
+ */
+void    StripHistory_wait       (StripHistory BOGUS(1))
+{
+}
+
+
+/* StripHistory_resolution
+ */
+void    StripHistory_resolution (StripHistory BOGUS(1), double BOGUS(2))
+{
+}
+
+
 
 /* StripHistoryResult_release
  */
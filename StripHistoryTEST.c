@@ -121,6 +121,20 @@ void    StripHistory_cancel     (StripHistory           the_shi,
 }
 
 
+/* StripHistory_wait
+ */
+void    StripHistory_wait       (StripHistory the_shi)
+{
+}
+
+
+/* StripHistory_resolution
+ */
+void    StripHistory_resolution (StripHistory the_shi, double resolution)
+{
+}
+
+
 
 /* StripHistoryResult_release
  */
@@ -361,6 +361,20 @@ char    *int2str        (int x, char buf[], int n)
 }
 
 
+void    *grow_table     (void *table, int *n_max, size_t size)
+{
+  int   n;
+
+  n = *n_max? 2 * *n_max : STRIP_TABLE_INCREMENT;
+  if ((table = realloc (table, n * size)))
+  {
+    memset ((char *)table + *n_max * size, 0, (n - *n_max) * size);
+    *n_max = n;
+  }
+  return table;
+}
+
+
 /* ====== MessageBox stuff ====== */
 static void     MessageBox_cb           (Widget, XtPointer, XtPointer);
 
@@ -596,6 +610,20 @@ char    *basename_st       (char *path)
   return p;
 }
 
+
+void    xml_fputs       (char *s, FILE *f)
+{
+  for (; *s; s++)
+    switch (*s)
+    {
+    case '&':   fputs ("&amp;", f); break;
+    case '<':   fputs ("&lt;", f); break;
+    case '>':   fputs ("&gt;", f); break;
+    case '"':   fputs ("&quot;", f); break;
+    default:    fputc (*s, f);
+    }
+}
+
 /* Albert */
 extern Widget history_topShell;
 void History_MessageBox_popup(char *title,char *btn_txt,char *str)
@@ -235,11 +235,29 @@ char    *dbl2str        (double,        /* value */
 
 char    *int2str        (int x, char buf[], int n);
 
+/* grow_table
+ *
+ *      Reallocates a table of *n_max elements of the given size to
+ *      twice as many (or STRIP_TABLE_INCREMENT for an empty one),
+ *      clearing the new elements, and updates *n_max.  Returns the new
+ *      table, or NULL, leaving the old one as it was, if out of memory.
+ */
+#define STRIP_TABLE_INCREMENT   16
+
+void    *grow_table     (void *table, int *n_max, size_t size);
+
 /* basename_st
  *
  *      Returns the filename portion of a fully qualified path.
  */
 char    *basename_st    (char *);
+
+/* xml_fputs
+ *
+ *      Writes the string to the file, escaping the characters which
+ *      are special in XML text and attribute values.
+ */
+void    xml_fputs       (char *, FILE *);
 void History_MessageBox_popup(char *title,char *btn_txt,char *str);
 
 /* General purpose output routine
@@ -18,6 +18,8 @@
 #include "Strip.h"
 #include "StripMisc.h"
 #include "StripDAQ.h"
+#include "StripDataSource.h"
+#include "StripHistory.h"
 
 #ifdef WIN32
 # include <direct.h> /* for getcwd (usually in sys/parm.h or unistd.h) */
@@ -49,6 +51,9 @@ static int      request_disconnect      (StripCurve, void *);
 
 static double   get_cpu_usage           (void *);
 
+static int      StripTool_batch         (int, char *[]);
+static int      parse_time              (char *, struct timeval *);
+
 int StripTool_main (int argc, char *argv[])
 {
   int           status;
@@ -66,6 +71,10 @@ int StripTool_main (int argc, char *argv[])
   print("STRIPCURVE_COMMENT_SET=%d\n",STRIPCURVE_COMMENT_SET);
 #endif  
 
+  /* batch mode runs without a display, so check for it first */
+  if ((argc >= 2) && (strcmp (argv[1], "-batch") == 0))
+    return StripTool_batch (argc, argv);
+
   /* WIN32 initialization */
 #if defined(WIN32) & 0
   // This has not been needed since at least Exceed 7 and the
@@ -465,6 +474,230 @@ static int convertNameToFullPath(const char *name, char *pathName, int nChars)
 }
 #endif /* #ifdef USE_OLD_FILE_SEARCH */
 
+#ifdef STRIP_HISTORY
+extern unsigned int     historySize;
+#  define BATCH_POINTS_USAGE    " [-points n]"
+#else
+#  define BATCH_POINTS_USAGE    ""
+#endif
+#ifdef USE_SDDS
+#  define BATCH_SDDS_USAGE      " [-sdds]"
+#else
+#  define BATCH_SDDS_USAGE      ""
+#endif
+
+/*
+ *      StripTool_batch()
+ *
+ *      StripTool -batch [-begin time] [-end time] [-points n] [-sdds]
+ *                [-o file] config
+ *
+ *      Loads the config file without a display, fetches the archived
+ *      history of its curves for the given time range and writes it out
+ *      as comma separated values (to stdout by default), or in SDDS
+ *      format to the file, then returns.  Times are given as
+ *      "MM/DD/YYYY HH:MM:SS", local time, as in the output.  The range
+ *      ends now and spans the config's time span, unless otherwise
+ *      specified.  -points sets the most points the archiver may return
+ *      for a curve at a time, like the history points setting of the
+ *      graph.  Archiver messages are printed on stderr.
+ */
+static int      StripTool_batch         (int argc, char *argv[])
+{
+  StripConfig           *config = NULL;
+  StripHistory          history = NULL;
+  StripDataSource       sds = NULL;
+  StripCurveInfo        curves[STRIP_MAX_CURVES];
+  struct timeval        begin, end;
+  char                  *begin_str = NULL, *end_str = NULL;
+  char                  *out_name = NULL, *cfg_name = NULL;
+  char                  *points_str = NULL;
+  FILE                  *f;
+  FILE                  *out = stdout;
+  int                   sdds = 0;
+  int                   i, n;
+  int                   status = 1;
+
+  for (i = 2; i < argc; i++)
+  {
+    if ((strcmp (argv[i], "-begin") == 0) && (i+1 < argc))
+      begin_str = argv[++i];
+    else if ((strcmp (argv[i], "-end") == 0) && (i+1 < argc))
+      end_str = argv[++i];
+    else if ((strcmp (argv[i], "-o") == 0) && (i+1 < argc))
+      out_name = argv[++i];
+#ifdef STRIP_HISTORY
+    else if ((strcmp (argv[i], "-points") == 0) && (i+1 < argc))
+      points_str = argv[++i];
+#endif
+#ifdef USE_SDDS
+    else if (strcmp (argv[i], "-sdds") == 0)
+      sdds = 1;
+#endif
+    else if ((argv[i][0] != '-') && !cfg_name)
+      cfg_name = argv[i];
+    else break;
+  }
+  
+  if ((i < argc) || !cfg_name || (sdds && !out_name) ||
+      (points_str && (atoi (points_str) <= 0)))
+  {
+    fprintf
+      (stderr,
+       "usage: %s -batch [-begin time] [-end time]"
+       BATCH_POINTS_USAGE BATCH_SDDS_USAGE " [-o file] config\n"
+       "  times are \"MM/DD/YYYY HH:MM:SS\"\n",
+       argv[0]);
+    if (sdds && !out_name)
+      fprintf (stderr, "  SDDS output needs a file\n");
+    return 1;
+  }
+#ifdef STRIP_HISTORY
+  if (points_str) historySize = (unsigned int)atoi (points_str);
+#endif
+
+  /* load the config, with no color manager */
+  StripConfig_preinit ();
+#ifdef USE_OLD_FILE_SEARCH
+  f = fopen (cfg_name, "r");
+#else
+  {
+    char path_used[STRIP_PATH_MAX];
+    f = StripTool_open_file (cfg_name, path_used, sizeof(path_used));
+  }
+#endif
+  if (!f)
+  {
+    fprintf (stderr, "%s: Can't open %s\n", argv[0], cfg_name);
+    return 1;
+  }
+  config = StripConfig_init (NULL, NULL, NULL, SCFGMASK_ALL);
+  if (!config || !StripConfig_load (config, f, SCFGMASK_ALL))
+  {
+    fprintf (stderr, "%s: Unable to load %s\n", argv[0], cfg_name);
+    fclose (f);
+    goto done;
+  }
+  fclose (f);
+
+  /* time range */
+  if (end_str)
+  {
+    if (!parse_time (end_str, &end))
+    {
+      fprintf (stderr, "%s: Bad end time, %s\n", argv[0], end_str);
+      goto done;
+    }
+  }
+  else get_current_time (&end);
+  if (begin_str)
+  {
+    if (!parse_time (begin_str, &begin))
+    {
+      fprintf (stderr, "%s: Bad begin time, %s\n", argv[0], begin_str);
+      goto done;
+    }
+  }
+  else
+  {
+    begin = end;
+    begin.tv_sec -= (long)config->Time.timespan;
+  }
+  if (compare_times (&begin, &end) > 0)
+  {
+    fprintf (stderr, "%s: The begin time is after the end time\n", argv[0]);
+    goto done;
+  }
+
+  /* there is no Strip, so the history is fetched synchronously */
+  if (!(history = StripHistory_init (NULL)) ||
+      !(sds = StripDataSource_init (history)))
+  {
+    fprintf (stderr, "%s: Unable to initialize data source\n", argv[0]);
+    goto done;
+  }
+  StripDataSource_setattr
+    (sds, SDS_NUMSAMPLES, (size_t)config->Time.num_samples, 0);
+
+  /* every curve named in the config file */
+  memset (curves, 0, sizeof (curves));
+  for (i = n = 0; i < STRIP_MAX_CURVES; i++)
+  {
+    if (!StripConfigMask_stat
+        (&config->Curves.Detail[i].update_mask, SCFGMASK_CURVE_NAME))
+      continue;
+    curves[n].scfg = config;
+    curves[n].details = &config->Curves.Detail[i];
+    if (!StripDataSource_addcurve (sds, (StripCurve)&curves[n]))
+    {
+      fprintf (stderr, "%s: Unable to add curve %s\n",
+        argv[0], curves[n].details->name);
+      goto done;
+    }
+    n++;
+  }
+  if (n == 0)
+  {
+    fprintf (stderr, "%s: No curves in %s\n", argv[0], cfg_name);
+    goto done;
+  }
+
+#ifdef USE_SDDS
+  if (sdds)
+  {
+    if (StripDataSource_dump_sdds_range (sds, out_name, &begin, &end))
+      status = 0;
+    else fprintf (stderr, "%s: Unable to write data\n", argv[0]);
+    goto done;
+  }
+#endif
+  
+  if (out_name && !(out = fopen (out_name, "w")))
+  {
+    fprintf
+      (stderr, "%s: Can't open %s: %s\n",
+       argv[0], out_name, strerror (errno));
+    out = stdout;
+    goto done;
+  }
+  
+  if (StripDataSource_dump_csv_range (sds, out, &begin, &end))
+    status = 0;
+  else fprintf (stderr, "%s: Unable to write data\n", argv[0]);
+
+  done:
+  if (out != stdout) fclose (out);
+  if (sds) StripDataSource_delete (sds);
+  if (history) StripHistory_delete (history);
+  if (config) StripConfig_delete (config);
+  return status;
+}
+
+
+/* parse_time
+ *
+ *      Reads a local time of the form "MM/DD/YYYY HH:MM:SS".
+ */
+static int      parse_time              (char *str, struct timeval *tv)
+{
+  struct tm     tm;
+
+  memset (&tm, 0, sizeof (tm));
+  if (sscanf
+      (str, "%d/%d/%d %d:%d:%d",
+       &tm.tm_mon, &tm.tm_mday, &tm.tm_year,
+       &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+    return 0;
+  tm.tm_mon -= 1;
+  tm.tm_year -= 1900;
+  tm.tm_isdst = -1;
+  if ((tv->tv_sec = (long)mktime (&tm)) == -1)
+    return 0;
+  tv->tv_usec = 0;
+  return 1;
+}
+
+
 static int      request_connect         (StripCurve curve, void *BOGUS(1))
 {
   int ret_val = 0;
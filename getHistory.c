@@ -11,6 +11,7 @@
 
 #include "StripHistory.h"
 #include "StripDataSource.h"
+#include "getHistory.h"
 #ifdef USE_AAPI
 #include "AAPI_client.h"
 #include "get_AAPI_data.h"
@@ -18,7 +19,6 @@
 #ifdef USE_ARCHIVE_RECORD
 #include "getArchiveRecord.h"
 #endif
-#include "getHistory.h"
 #define DEBUG  0
 #define DEBUG1 0
 #define DEBUG2 0
@@ -30,7 +30,8 @@ unsigned long getHistory(StripHistory     the_shi,
 		  struct timeval** times,
 		  short**          status,
 		  double**         data,
-		  unsigned long *  count)
+		  unsigned long *  count,
+		  HistoryFetchInfo *info)
 {
   struct timeval right_endpoint;   /* right end for AAPI request */
   unsigned long commonCount=0;
@@ -86,13 +87,13 @@ if(DEBUG1) printf("history req is here\n");
       if(get_AAPI_data(name,begin ,&right_endpoint,
 		       &returnedTimeAAPI, 
 		       &returnedStatusAAPI, &returnedDataAAPI,
-		       &returnedCountAAPI) != 0)
+		       &returnedCountAAPI, info) != 0)
 #endif
 #ifdef USE_CAR
       if(get_CAR_data(the_shi,name,begin ,&right_endpoint,
 		       &returnedTimeAAPI, 
 		       &returnedStatusAAPI, &returnedDataAAPI,
-		       &returnedCountAAPI) != 0)
+		       &returnedCountAAPI, info) != 0)
 #endif
 	{ 
 	  if(DEBUG) fprintf(stderr,"%s:getArchiveAPI Error\n",name);
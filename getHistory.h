@@ -12,14 +12,76 @@
 #ifndef _getHistory_h
 #define _getHistory_h
 
+struct _HistoryChannel;
+struct _HistoryLease;
+
+#ifdef STRIP_ASYNC_HISTORY
+#include <pthread.h>
+
+/* number of fetch threads */
+#ifndef STRIP_HISTORY_THREADS
+#define STRIP_HISTORY_THREADS   4
+#endif
+
+struct _StripHistoryRequest;
+#endif
+
+/* HistoryFetchInfo
+ *
+ *      What an archiver request is made with, and what it brings back
+ *      for the user.  The settings are copied from the globals when the
+ *      fetch is set up, and a message is shown by the caller once the
+ *      data is handed back, since the archiver clients may be run by a
+ *      fetch thread, which must not touch either the globals or Motif.
+ */
+#define HISTORY_MSG_LEN         256
+
+typedef struct _HistoryFetchInfo
+{
+  unsigned int          history_size;   /* most points to ask for */
+  long                  method;         /* AAPI reduction */
+  double                resolution;     /* wanted, in seconds, or 0 */
+  char                  *msg_title;     /* message for the user, if any */
+  char                  msg[HISTORY_MSG_LEN];
+}
+HistoryFetchInfo;
+
+
 /* StripHistoryInfo
  *
  *      Contains instance data for the archive service.
+ *
+ *      Fetched history is cached per channel (see StripHistoryAR+ArR.c).
+ *      With STRIP_ASYNC_HISTORY, fetches which supply a callback are
+ *      queued for a pool of worker threads, which hand the finished
+ *      requests back to the Xt main loop through a pipe.  Unless
+ *      STRIP_HISTORY_REENTRANT is defined, the archiver is only called
+ *      from one thread at a time, since the AAPI and CAR clients keep
+ *      static request state.
  */
 typedef struct _StripHistoryInfo
 {
   Strip         strip;
   char          *archiverInfo;
+  struct _HistoryChannel        *cache;         /* fetched history */
+  struct _HistoryLease          *leases;        /* results using it */
+  size_t                        cache_bytes;
+  unsigned long                 cache_clock;
+  double                        resolution;     /* wanted, in seconds */
+#ifdef STRIP_ASYNC_HISTORY
+  int                           async;          /* workers running? */
+  int                           shutdown;
+  pthread_t                     threads[STRIP_HISTORY_THREADS];
+  int                           n_threads;
+  pthread_mutex_t               lock;           /* guards the lists */
+  pthread_mutex_t               fetch_lock;     /* one getHistory() at a time */
+  pthread_cond_t                wakeup;         /* queue not empty */
+  pthread_cond_t                idle;           /* request finished */
+  int                           pipe_fd[2];
+  struct _StripHistoryRequest   *queue;         /* waiting, oldest first */
+  struct _StripHistoryRequest   *busy;          /* being fetched */
+  struct _StripHistoryRequest   *done;          /* fetched, not delivered */
+#endif
 }
 StripHistoryInfo;
 
@@ -31,5 +93,6 @@ unsigned long getHistory(StripHistory     the_shi,
 		  struct timeval        **times,
 		  short                 **status,
 		  double                **data,
-		  unsigned long          *count);
+		  unsigned long          *count,
+		  HistoryFetchInfo       *info);
 #endif  /* _getHistory_h */
@@ -11,13 +11,15 @@
 
 #include "AAPI_client.h"
 #include "StripHistory.h"
+#include "getHistory.h"
 #include "get_AAPI_data.h"
 
-extern unsigned int historySize;
-
-extern long radioBoxAlgorithm; 
 #define DEBUG 0
-#define SERVER_ERROR_BUF_SIZE 256
+
+/* points asked for per plot bin, when the resolution is known.  Some
+ * reductions (min/max) return more than one point per interval */
+#define AAPI_POINTS_PER_BIN 4
+#define AAPI_MIN_POINTS 16
 
 static void tryFreeData(answerData *ans_data,char *serverErrorString);
 
@@ -27,7 +29,8 @@ u_long get_AAPI_data(char           *name,
 		     struct timeval **times,
 		     short           **status,
 		     double         **data,
-		     u_long *count)
+		     u_long *count,
+		     HistoryFetchInfo *info)
 {
 
 int i;
@@ -39,15 +42,29 @@ u_long err;
 u_long serverError, serverVersion;
 char *serverErrorString;
 static AAPI_connection_establish=1;
-static char buf[SERVER_ERROR_BUF_SIZE];
+u_long maxNum;
+double span;
 	
+  /* no more points than the plot can show, but never more than the
+   * history points setting */
+  maxNum = info->history_size;
+  if (info->resolution > 0)
+    {
+      span = (end->tv_sec - begin->tv_sec) +
+        1e-6 * (end->tv_usec - begin->tv_usec);
+      if (span / info->resolution * AAPI_POINTS_PER_BIN < (double)maxNum)
+        maxNum = (u_long)(span / info->resolution * AAPI_POINTS_PER_BIN) + 1;
+      if (maxNum < AAPI_MIN_POINTS) maxNum = AAPI_MIN_POINTS;
+      if (maxNum > info->history_size) maxNum = info->history_size;
+    }
+
   cmd=DATA_REQUEST_CMD;
   req.from_sec=begin->tv_sec;
   req.from_usec=(begin->tv_usec)*nSecPerUSec;
   req.to_sec=end->tv_sec;
   req.to_usec=(end->tv_usec)*nSecPerUSec;
-  req.maxNum= historySize;
-  req.convers=1 + radioBoxAlgorithm;
+  req.maxNum= maxNum;
+  req.convers=1 + info->method;
   req.conversPar=0.0;
   req.PV_name_size=1;
   req.name=name;
@@ -60,10 +77,10 @@ static char buf[SERVER_ERROR_BUF_SIZE];
       if (AAPI_connection_establish == 1) 
 	{
 	  AAPI_connection_establish = 0;
-	  History_MessageBox_popup
-	    ( "AAPI_SERVER PROBLEM", 
-	     "OK",
-	     "AAPI-server problem. \ncould be you need restart it.\n");
+	  info->msg_title = "AAPI_SERVER PROBLEM";
+	  strncpy (info->msg,
+	     "AAPI-server problem. \ncould be you need restart it.\n",
+	     HISTORY_MSG_LEN - 1);
 	}
      return (err);
     }
@@ -72,12 +89,12 @@ static char buf[SERVER_ERROR_BUF_SIZE];
   /* FatalError = NoData. sereverString like popUp menu: */
 
   if (serverError) {
-    memset(buf,0,SERVER_ERROR_BUF_SIZE);
-    sprintf(buf,"serverError=%ld\n",serverError);
+    memset(info->msg,0,HISTORY_MSG_LEN);
     if(serverErrorString) 
-      sprintf(buf,"which means %s\n",serverErrorString); 
-    else sprintf(buf,"-undefine error\n"); 
-    History_MessageBox_popup("BIG REQUEST", "OK",buf);
+      sprintf(info->msg,"serverError=%ld\nwhich means %.*s\n",serverError,
+	      HISTORY_MSG_LEN - 64,serverErrorString); 
+    else sprintf(info->msg,"serverError=%ld\n-undefine error\n",serverError); 
+    info->msg_title = "BIG REQUEST";
     tryFreeData(ans_data,serverErrorString);
     return (-1);
   }
@@ -108,12 +125,18 @@ static char buf[SERVER_ERROR_BUF_SIZE];
       return (-1);
     }
 
-   if(*count > historySize)
+   if(*count > maxNum)
     {
-      *count = historySize-1; /* show rest of big buffer */
+      *count = maxNum-1; /* show rest of big buffer */
       fprintf(stderr,"Server count data=%ld is big no goodData\n",*count);
-      History_MessageBox_popup("BIG REQUEST", "OK",
-             "So many Data from Archiver\nPlease, decrease interval or increase # historyPoints.\n");	
+      /* only the history points setting is for the user to change */
+      if (maxNum == info->history_size)
+        {
+          info->msg_title = "BIG REQUEST";
+          strncpy (info->msg,
+             "So many Data from Archiver\nPlease, decrease interval or increase # historyPoints.\n",
+             HISTORY_MSG_LEN - 1);
+        }
       
     }
 
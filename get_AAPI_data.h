@@ -15,5 +15,6 @@ u_long get_AAPI_data(char           *name,
 		     struct timeval **times,
 		     short          **status,
 		     double         **data,
-		     u_long *count);
+		     u_long *count,
+		     HistoryFetchInfo *info);
 
@@ -14,6 +14,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define DEFAULT_WIDTH           75
 #define DEFAULT_HEIGHT          100
@@ -123,6 +124,12 @@ static void     FreePixmap              (LegendWidget);
 static void     Update                  (LegendWidget);
 #endif
 static void     Draw                    (LegendWidget, Drawable);
+static int      DrawTitle               (LegendWidget, Drawable,
+                                         LegendItemInfo *, int, int, int);
+static void     DrawDamage              (LegendWidget, Drawable);
+static void     GetExtents              (LegendWidget, LegendItemInfo *, int);
+static Boolean  SetItemInfo             (LegendWidget, LegendItemInfo *,
+                                         int, char *);
 static void     CalculateDims           (LegendWidget);
 static void     GetDimsForMask          (LegendWidget, int, XPoint *);
 static int      BestMaskForHeight       (LegendWidget, int, int);
@@ -346,7 +353,13 @@ SetValues       (Widget         cur_w,
 
   if (cur->legend.font != new->legend.font)
   {
+    LegendItemInfo      *item;
+    int                 m;
+    
     XSetFont (XtDisplay(new), new->legend.gc, new->legend.font->fid);
+    for (item = new->legend.items; item; item = item->next)
+      for (m = 0; m < NUM_LGITEMS; m++)
+        GetExtents (new, item, m);
     do_recompute = True;
   }
 
@@ -519,16 +532,18 @@ FreePixmap      (LegendWidget cw)
 
 /* Albert */
 
+/* LegendRefresh
+ *
+ *      Brings the legend window up to date.  If the layout has changed
+ *      the whole legend is drawn and copied, otherwise only the item
+ *      fields which have changed since the last draw are.
+ */
 void LegendRefresh(LegendWidget cw)
 {
-  register int                  mask, m;
-  register LegendItemInfo       *item;
-  register int                  x, y;
-  register char                 *s, *p;
-  XPoint                        dims;
-  XRectangle                    rect;
   Drawable                      canvas;
   
+  if (!XtIsRealized ((Widget)cw)) return;
+  
   /* which canvas? */
   if (cw->legend.use_pixmap)
   {
@@ -539,80 +554,17 @@ void LegendRefresh(LegendWidget cw)
   else {
     canvas = XtWindow(cw);
   }
-  
-  XSetForeground (XtDisplay (cw), cw->legend.gc, cw->core.background_pixel);
-  XFillRectangle
-    (XtDisplay (cw), canvas, cw->legend.gc,
-	0, 0, cw->core.width + 1, cw->core.height + 1);
-  
-  /* which elements to draw? */
-  mask = BestMaskForHeight (cw, LGITEM_MASK_ALL, cw->core.height);
-  GetDimsForMask (cw, mask, &dims);
-  
-  /* make the width equal to the widget with */
-  dims.x = cw->core.width;
-  
-  /* for each legend item */
-  x = y = 0;
-  for (item = cw->legend.items; item; item = item->next)
-  {
-    /* remember legend entry top left coords */
-    item->box.x = x; item->box.y = y;
-
-    /* determine the location and dimensions of the text box */
-    rect.width = 2 + item->extents[LGITEM_NAME].width;
-    rect.height = 2 +
-      item->extents[LGITEM_NAME].ascent + item->extents[LGITEM_NAME].descent;
-    rect.x = x + (dims.x - rect.width) / 2;
-    rect.y = y + COLOR_NPIXELS_TOP;
-
-    /* draw the title area */
-    XSetForeground (XtDisplay (cw), cw->legend.gc, item->color);
-    XFillRectangle
-      (XtDisplay (cw), canvas, cw->legend.gc,
-       x, y,
-       dims.x + 1, rect.height + COLOR_NPIXELS_TOP + COLOR_NPIXELS_BOTTOM + 1);
-
-    /* clear inside the title area */
-    XSetForeground (XtDisplay (cw), cw->legend.gc, cw->core.background_pixel);
-    XFillRectangle
-      (XtDisplay (cw), canvas, cw->legend.gc,
-       x + COLOR_NPIXELS_SIDE, rect.y,
-       dims.x + 1 - (2*COLOR_NPIXELS_SIDE), rect.height+1);
-
-    /* draw the text */
-    XSetForeground (XtDisplay (cw), cw->legend.gc, cw->primitive.foreground);
-    for (p = s = item->info[LGITEM_NAME]; *p; p++);
-    XDrawString
-      (XtDisplay (cw), canvas, cw->legend.gc,
-       rect.x+1 , rect.y+1 + item->extents[LGITEM_NAME].ascent, s, p-s);
-
-    /* advance current vertical location, remeber item area */
-    y += rect.height + COLOR_NPIXELS_TOP + COLOR_NPIXELS_BOTTOM;
-    y += ITEM_INFO_PAD;
-
-    /* draw the other portions of this item */
-    for (m = LGITEM_NAME+1; m < NUM_LGITEMS; m++)
-      if ((1 << m) & mask)
-      {
-        for (p = s = item->info[m]; *p; p++);
-        if (p > s)
-        {
-          /* left hand indent: COLOR_NPIXELS_SIDE */
-          XDrawString
-            (XtDisplay (cw), canvas, cw->legend.gc,
-             x + COLOR_NPIXELS_SIDE, y + item->extents[m].ascent, s, p-s);
 
-          /* advance vertical position */
-          y += item->extents[m].ascent + item->extents[m].descent;
-          y += ITEM_INFO_PAD;
-        }
-      }
-    
-    item->box.width = dims.x;
-    item->box.height = y - item->box.y;
+  if (!cw->legend.need_refresh)
+  {
+    DrawDamage (cw, canvas);
+    return;
   }
-
+  
+  CalculateDims (cw);
+  Draw (cw, canvas);
+  cw->legend.need_refresh = False;
+  
   /* copy the pixmap if used */
   if (canvas != XtWindow(cw))
   {
@@ -634,10 +586,9 @@ Draw            (LegendWidget cw, Drawable canvas)
 {
   register int                  mask, m;
   register LegendItemInfo       *item;
-  register int                  x, y;
+  register int                  x, y, h;
   register char                 *s, *p;
   XPoint                        dims;
-  XRectangle                    rect;
 
   /* clear the drawable */
   XSetForeground (XtDisplay (cw), cw->legend.gc, cw->core.background_pixel);
@@ -656,42 +607,23 @@ Draw            (LegendWidget cw, Drawable canvas)
   x = y = 0;
   for (item = cw->legend.items; item; item = item->next)
   {
+    memset (item->area, 0, sizeof (item->area));
+    item->damage = 0;
+    
     /* remember legend entry top left coords */
     item->box.x = x; item->box.y = y;
 
-    /* determine the location and dimensions of the text box */
-    rect.width = 2 + item->extents[LGITEM_NAME].width;
-    rect.height = 2 +
-      item->extents[LGITEM_NAME].ascent + item->extents[LGITEM_NAME].descent;
-    rect.x = x + (dims.x - rect.width) / 2;
-    rect.y = y + COLOR_NPIXELS_TOP;
-
-    /* draw the title area */
-    XSetForeground (XtDisplay (cw), cw->legend.gc, item->color);
-    XFillRectangle
-      (XtDisplay (cw), canvas, cw->legend.gc,
-       x, y,
-       dims.x + 1, rect.height + COLOR_NPIXELS_TOP + COLOR_NPIXELS_BOTTOM + 1);
-
-    /* clear inside the title area */
-    XSetForeground (XtDisplay (cw), cw->legend.gc, cw->core.background_pixel);
-    XFillRectangle
-      (XtDisplay (cw), canvas, cw->legend.gc,
-       x + COLOR_NPIXELS_SIDE, rect.y,
-       dims.x + 1 - (2*COLOR_NPIXELS_SIDE), rect.height+1);
-
-    /* draw the text */
-    XSetForeground (XtDisplay (cw), cw->legend.gc, cw->primitive.foreground);
-    for (p = s = item->info[LGITEM_NAME]; *p; p++);
-    XDrawString
-      (XtDisplay (cw), canvas, cw->legend.gc,
-       rect.x+1 , rect.y+1 + item->extents[LGITEM_NAME].ascent, s, p-s);
-
-    /* advance current vertical location, remeber item area */
-    y += rect.height + COLOR_NPIXELS_TOP + COLOR_NPIXELS_BOTTOM;
+    /* draw the title area, advance current vertical location */
+    h = DrawTitle (cw, canvas, item, x, y, dims.x);
+    item->area[LGITEM_NAME].x = x;
+    item->area[LGITEM_NAME].y = y;
+    item->area[LGITEM_NAME].width = dims.x + 1;
+    item->area[LGITEM_NAME].height = h + 1;
+    y += h;
     y += ITEM_INFO_PAD;
 
     /* draw the other portions of this item */
+    XSetForeground (XtDisplay (cw), cw->legend.gc, cw->primitive.foreground);
     for (m = LGITEM_NAME+1; m < NUM_LGITEMS; m++)
       if ((1 << m) & mask)
       {
@@ -703,8 +635,15 @@ Draw            (LegendWidget cw, Drawable canvas)
             (XtDisplay (cw), canvas, cw->legend.gc,
              x + COLOR_NPIXELS_SIDE, y + item->extents[m].ascent, s, p-s);
 
+          /* remember where the field went, in case it is redrawn alone */
+          h = item->extents[m].ascent + item->extents[m].descent;
+          item->area[m].x = x;
+          item->area[m].y = y;
+          item->area[m].width = dims.x;
+          item->area[m].height = h;
+
           /* advance vertical position */
-          y += item->extents[m].ascent + item->extents[m].descent;
+          y += h;
           y += ITEM_INFO_PAD;
         }
       }
@@ -715,10 +654,109 @@ Draw            (LegendWidget cw, Drawable canvas)
 }
 
 
+/* DrawTitle
+ *
+ *      Draws the colored title area of the item, width pixels wide,
+ *      with top left corner at (x, y).  Returns the height of the area.
+ */
+static int
+DrawTitle       (LegendWidget           cw,
+                 Drawable               canvas,
+                 LegendItemInfo         *item,
+                 int                    x,
+                 int                    y,
+                 int                    width)
+{
+  XRectangle                    rect;
+  register char                 *s, *p;
+
+  /* determine the location and dimensions of the text box */
+  rect.width = 2 + item->extents[LGITEM_NAME].width;
+  rect.height = 2 +
+    item->extents[LGITEM_NAME].ascent + item->extents[LGITEM_NAME].descent;
+  rect.x = x + (width - rect.width) / 2;
+  rect.y = y + COLOR_NPIXELS_TOP;
+
+  /* draw the title area */
+  XSetForeground (XtDisplay (cw), cw->legend.gc, item->color);
+  XFillRectangle
+    (XtDisplay (cw), canvas, cw->legend.gc,
+     x, y,
+     width + 1, rect.height + COLOR_NPIXELS_TOP + COLOR_NPIXELS_BOTTOM + 1);
+
+  /* clear inside the title area */
+  XSetForeground (XtDisplay (cw), cw->legend.gc, cw->core.background_pixel);
+  XFillRectangle
+    (XtDisplay (cw), canvas, cw->legend.gc,
+     x + COLOR_NPIXELS_SIDE, rect.y,
+     width + 1 - (2*COLOR_NPIXELS_SIDE), rect.height+1);
+
+  /* draw the text */
+  XSetForeground (XtDisplay (cw), cw->legend.gc, cw->primitive.foreground);
+  for (p = s = item->info[LGITEM_NAME]; *p; p++);
+  XDrawString
+    (XtDisplay (cw), canvas, cw->legend.gc,
+     rect.x+1 , rect.y+1 + item->extents[LGITEM_NAME].ascent, s, p-s);
+
+  return rect.height + COLOR_NPIXELS_TOP + COLOR_NPIXELS_BOTTOM;
+}
+
+
+/* DrawDamage
+ *
+ *      Redraws only the damaged fields of each item, in the places
+ *      they were put by the last Draw(), and copies just those areas
+ *      to the window when drawing into the pixmap.  Fields which were
+ *      not drawn last time (no room for them) are left alone.
+ */
+static void
+DrawDamage      (LegendWidget cw, Drawable canvas)
+{
+  register LegendItemInfo       *item;
+  register XRectangle           *r;
+  register char                 *s, *p;
+  int                           m;
+
+  for (item = cw->legend.items; item; item = item->next)
+  {
+    if (!item->damage) continue;
+    
+    for (m = 0; m < NUM_LGITEMS; m++)
+    {
+      r = &item->area[m];
+      if (!(item->damage & (1 << m)) || !r->height) continue;
+
+      if (m == LGITEM_NAME)
+        DrawTitle (cw, canvas, item, r->x, r->y, r->width - 1);
+      else
+      {
+        XSetForeground
+          (XtDisplay (cw), cw->legend.gc, cw->core.background_pixel);
+        XFillRectangle
+          (XtDisplay (cw), canvas, cw->legend.gc,
+           r->x, r->y, r->width, r->height);
+        XSetForeground
+          (XtDisplay (cw), cw->legend.gc, cw->primitive.foreground);
+        for (p = s = item->info[m]; *p; p++);
+        XDrawString
+          (XtDisplay (cw), canvas, cw->legend.gc,
+           r->x + COLOR_NPIXELS_SIDE, r->y + item->extents[m].ascent, s, p-s);
+      }
+
+      if (canvas != XtWindow (cw))
+        XCopyArea
+          (XtDisplay (cw), canvas, XtWindow (cw), cw->legend.gc,
+           r->x, r->y, r->width, r->height, r->x, r->y);
+    }
+    item->damage = 0;
+  }
+}
+
+
 /* CalculateDims
  *
  *      Calculates the dimensions needed to display each of the legend
- *      item information components.
+ *      item information components, from the cached text extents.
  */
 static void
 CalculateDims   (LegendWidget cw)
@@ -726,7 +764,6 @@ CalculateDims   (LegendWidget cw)
   register LegendItemInfo       *item;
   XCharStruct                   overall;
   register int                  i;
-  int                                 direction, font_ascent, font_descent;
   register char                 *p, *s;
 
   /* zero out the info dimensions */
@@ -741,15 +778,10 @@ CalculateDims   (LegendWidget cw)
       s = item->info[i];
       for (p = s; *p; p++);
       
-      /* if info item for entry is not empty, then get its text extents */
+      /* if info item for entry is not empty, then use its text extents */
       if (p > s)
       {
-        XTextExtents
-          (cw->legend.font, s, p - s,
-           &direction, &font_ascent, &font_descent, &overall);
-
-        /* remember text extents */
-        item->extents[i] = overall;
+        overall = item->extents[i];
 
         /* if this is the name, we need to also include pixels for
          * the color info.  We do this by first allowing for one
@@ -782,6 +814,61 @@ CalculateDims   (LegendWidget cw)
 }
 
 
+/* GetExtents
+ *
+ *      Caches the text extents of the m'th info field of the item.
+ */
+static void
+GetExtents      (LegendWidget cw, LegendItemInfo *item, int m)
+{
+  int           direction, font_ascent, font_descent;
+  char          *s, *p;
+
+  for (p = s = item->info[m]; *p; p++);
+  if (p > s)
+    XTextExtents
+      (cw->legend.font, s, p - s,
+       &direction, &font_ascent, &font_descent, &item->extents[m]);
+  else memset (&item->extents[m], 0, sizeof (XCharStruct));
+}
+
+
+/* SetItemInfo
+ *
+ *      Copies str into the m'th info field of the item.  If the text
+ *      changes, its extents are cached again and the field is marked
+ *      damaged.  Returns True if the change moves the fields below it,
+ *      so that the whole legend must be drawn again.
+ */
+static Boolean
+SetItemInfo     (LegendWidget           cw,
+                 LegendItemInfo         *item,
+                 int                    m,
+                 char                   *str)
+{
+  char          buf[LEGEND_MAX_STRLEN];
+  char          *p = buf;
+  XCharStruct   old;
+
+  if (str) while (*str && ((p-buf) < LEGEND_MAX_STRLEN-1)) *p++ = *str++;
+  *p = 0;
+
+  if (strcmp (buf, item->info[m]) == 0) return False;
+
+  old = item->extents[m];
+  if (!buf[0] || !item->info[m][0])
+    old.ascent = old.descent = -1;      /* field comes or goes */
+  
+  strcpy (item->info[m], buf);
+  GetExtents (cw, item, m);
+  item->damage |= (1 << m);
+
+  return
+    (old.ascent + old.descent) !=
+    (item->extents[m].ascent + item->extents[m].descent);
+}
+
+
 /* GetDimsForMask
  *
  *      Calculates the minimum number of pixels needed to draw the
@@ -913,7 +1000,7 @@ XjLegendNewItem         (Widget w,
   LegendWidget          cw = (LegendWidget)w;
   LegendItemInfo        *item, *p;
 
-  if ((item = (LegendItemInfo *)malloc (sizeof (LegendItemInfo))))
+  if ((item = (LegendItemInfo *)calloc (1, sizeof (LegendItemInfo))))
   {
     /* append to list */
     if (cw->legend.items)
@@ -932,6 +1019,7 @@ XjLegendNewItem         (Widget w,
       item->prev = item->next = 0;
     }
 
+    cw->legend.need_refresh = True;
     XjLegendUpdateItem
       ((Widget)cw, (LegendItem)item, name, units, range, comment, color);
   }
@@ -968,28 +1056,26 @@ XjLegendUpdateItem      (Widget         w,
 {
   LegendWidget          cw = (LegendWidget)w;
   LegendItemInfo        *item = (LegendItemInfo *)the_item;
-  char                  *p, *s;
-  
-/* copy args */
-  p = s = item->info[LGITEM_NAME];
-  if (name) while (*name && ((p-s) < LEGEND_MAX_STRLEN-1)) *p++ = *name++;
-  *p = 0;
-  
-  p = s = item->info[LGITEM_RANGE];
-  if (range) while (*range && ((p-s) < LEGEND_MAX_STRLEN-1)) *p++ = *range++;
-  *p = 0;
-  
-  p = s = item->info[LGITEM_UNITS];
-  if (units) while (*units && ((p-s) < LEGEND_MAX_STRLEN-1)) *p++ = *units++;
-  *p = 0;
+  Boolean               moved = False;
+  int                   damage = item->damage;
   
-  p = s = item->info[LGITEM_COMMENT];
-  if (comment) while (*comment && ((p-s) < LEGEND_MAX_STRLEN-1))
-    *p++ = *comment++;
-  *p = 0;
+  /* copy args, noting what has changed */
+  moved |= SetItemInfo (cw, item, LGITEM_NAME, name);
+  moved |= SetItemInfo (cw, item, LGITEM_RANGE, range);
+  moved |= SetItemInfo (cw, item, LGITEM_UNITS, units);
+  moved |= SetItemInfo (cw, item, LGITEM_COMMENT, comment);
   
-  item->color = color;
-  cw->legend.need_refresh = True;
+  if (item->color != color)
+  {
+    item->color = color;
+    item->damage |= LGITEM_MASK_NAME;
+  }
+
+  /* nothing new: leave the legend alone */
+  if (!moved && (item->damage == damage) && !cw->legend.need_refresh)
+    return;
+
+  if (moved) cw->legend.need_refresh = True;
   XjLegendResize (w);
 }
 
@@ -1003,8 +1089,9 @@ XjLegendValueUpdateItem    (Widget         w,
                          char           *comment,
                          Pixel          color)
 {
+  LegendWidget          cw = (LegendWidget)w;
   LegendItemInfo        *item = (LegendItemInfo *)the_item;
-  char                  *p, *s;
+  Boolean               moved = False;
 
   static char nameL[128]; /* Albert */
   char * name= nameStart;
@@ -1015,26 +1102,21 @@ XjLegendValueUpdateItem    (Widget         w,
   name = (char *) nameL;
   }
 
-  /* copy args */
-  p = s = item->info[LGITEM_NAME];
-  if (name) while (*name && ((p-s) < LEGEND_MAX_STRLEN-1)) *p++ = *name++;
-  *p = 0;
+  /* copy args, noting what has changed */
+  moved |= SetItemInfo (cw, item, LGITEM_NAME, name);
+  moved |= SetItemInfo (cw, item, LGITEM_RANGE, range);
+  moved |= SetItemInfo (cw, item, LGITEM_UNITS, units);
+  moved |= SetItemInfo (cw, item, LGITEM_COMMENT, comment);
   
-  p = s = item->info[LGITEM_RANGE];
-  if (range) while (*range && ((p-s) < LEGEND_MAX_STRLEN-1)) *p++ = *range++;
-  *p = 0;
-  
-  p = s = item->info[LGITEM_UNITS];
-  if (units) while (*units && ((p-s) < LEGEND_MAX_STRLEN-1)) *p++ = *units++;
-  *p = 0;
-  
-  p = s = item->info[LGITEM_COMMENT];
-  if (comment) while (*comment && ((p-s) < LEGEND_MAX_STRLEN-1))
-    *p++ = *comment++;
-  *p = 0;
-  
-  item->color = color;
-  /*cw->legend.need_refresh = True; perror Albert */
+  if (item->color != color)
+  {
+    item->color = color;
+    item->damage |= LGITEM_MASK_NAME;
+  }
+
+  /* the changed fields are drawn by the next LegendRefresh(), which
+   * redraws everything only if a field has moved */
+  if (moved) cw->legend.need_refresh = True;
 }
 
 
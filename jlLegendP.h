@@ -40,9 +40,11 @@ enum
 typedef struct _LegendItemInfo
 {
   char                          info[NUM_LGITEMS][LEGEND_MAX_STRLEN];
-  XCharStruct                   extents[NUM_LGITEMS];
+  XCharStruct                   extents[NUM_LGITEMS];   /* cached */
   Pixel                         color;
   XRectangle                    box;
+  XRectangle                    area[NUM_LGITEMS];      /* as last drawn */
+  int                           damage;                 /* LGITEM_MASK_* */
   struct _LegendItemInfo        *prev, *next;
 } LegendItemInfo;
 